@@ -0,0 +1,158 @@
+#include "connection_stats.hh"
+
+#include <cstring>
+
+#include "platform.hh"
+
+namespace wifi_connect {
+
+  ////////////////////////////////
+  // Public methods
+
+  ConnectionStats::ConnectionStats() {
+    reset();
+  }
+
+  void ConnectionStats::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    memset(&attempt, 0, sizeof(attempt));
+    in_attempt = false;
+    memset(&association, 0, sizeof(association));
+    memset(&dhcp, 0, sizeof(dhcp));
+    memset(&total, 0, sizeof(total));
+    memset(reasons, 0, sizeof(reasons));
+    reason_count = 0;
+    other_reasons = 0;
+  }
+
+  void ConnectionStats::beginAttempt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    memset(&attempt, 0, sizeof(attempt));
+    attempt.start_us = esp_timer_get_time();
+    in_attempt = true;
+  }
+
+  void ConnectionStats::onAssociated() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (in_attempt && attempt.associated_us == 0) {
+      attempt.associated_us = esp_timer_get_time();
+    }
+  }
+
+  void ConnectionStats::onDisconnected(uint16_t reason) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (in_attempt) {
+      attempt.disconnect_reason = reason;
+    }
+
+    for (size_t i = 0; i < reason_count; ++i) {
+      if (reasons[i].reason == reason) {
+        ++reasons[i].count;
+        return;
+      }
+    }
+    if (reason_count < MAX_REASONS) {
+      reasons[reason_count++] = { reason, 1 };
+    } else {
+      ++other_reasons;
+    }
+  }
+
+  void ConnectionStats::onGotIP() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (in_attempt && attempt.got_ip_us == 0) {
+      attempt.got_ip_us = esp_timer_get_time();
+    }
+  }
+
+  void ConnectionStats::endAttempt(bool success) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!in_attempt) {
+      return;
+    }
+    in_attempt = false;
+    attempt.end_us = esp_timer_get_time();
+    attempt.success = success;
+
+    if (attempt.associated_us > 0) {
+      addSample(association, attempt.associated_us - attempt.start_us);
+      if (attempt.got_ip_us > 0) {
+        addSample(dhcp, attempt.got_ip_us - attempt.associated_us);
+      }
+    }
+    if (success && attempt.got_ip_us > 0) {
+      addSample(total, attempt.got_ip_us - attempt.start_us);
+    }
+  }
+
+  ConnectionStats::Attempt ConnectionStats::getLastAttempt() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return attempt;
+  }
+
+  ConnectionStats::Histogram ConnectionStats::getAssociationHistogram() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return getHistogram(association);
+  }
+
+  ConnectionStats::Histogram ConnectionStats::getDHCPHistogram() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return getHistogram(dhcp);
+  }
+
+  ConnectionStats::Histogram ConnectionStats::getTotalHistogram() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return getHistogram(total);
+  }
+
+  size_t ConnectionStats::getReasons(ReasonCount* reasons, size_t size) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = reason_count < size ? reason_count : size;
+    memcpy(reasons, this->reasons, count * sizeof(ReasonCount));
+    return count;
+  }
+
+  uint32_t ConnectionStats::getOtherReasons() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return other_reasons;
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  void ConnectionStats::addSample(Window& window, int64_t duration_us) {
+    if (duration_us < 0) {
+      duration_us = 0;
+    } else if (duration_us > UINT32_MAX) {
+      duration_us = UINT32_MAX;
+    }
+
+    window.samples_us[window.next] = static_cast<uint32_t>(duration_us);
+    window.next = (window.next + 1) % WINDOW_SIZE;
+    if (window.count < WINDOW_SIZE) {
+      ++window.count;
+    }
+  }
+
+  ConnectionStats::Histogram ConnectionStats::getHistogram(const Window& window) {
+    Histogram histogram = {};
+    for (size_t i = 0; i < window.count; ++i) {
+      int64_t duration_us = window.samples_us[i];
+      size_t bucket = 0;
+      int64_t limit_us = 1000;
+      while (bucket < HISTOGRAM_BUCKETS - 1 && duration_us >= limit_us) {
+        ++bucket;
+        limit_us *= 2;
+      }
+
+      ++histogram.buckets[bucket];
+      ++histogram.count;
+      histogram.total_us += duration_us;
+      if (duration_us > histogram.max_us) {
+        histogram.max_us = duration_us;
+      }
+    }
+    return histogram;
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "credential_store.hh"
+
+#include <cstring>
+#include <ctime>
+
+#include <esp_log.h>
+
+#include <nvs.h>
+
+#define NVS_NAMESPACE       "wifi_connect"
+#define NVS_KEY_PROFILES    "profiles"
+
+// Rewriting a success timestamp is only worth a flash write once in a while.
+#define SUCCESS_REFRESH_S   (24 * 3600)
+
+namespace wifi_connect {
+
+  #define TAG "wifi_connect::CredentialStore"
+
+  ////////////////////////////////
+  // Public methods
+
+  CredentialStore::CredentialStore()
+    : count(0)
+    , dirty(false)
+  {
+    memset(profiles, 0, sizeof(profiles));
+  }
+
+  void CredentialStore::load() {
+    count = 0;
+    dirty = false;
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+      return;
+    }
+    size_t size = sizeof(profiles);
+    esp_err_t err = nvs_get_blob(handle, NVS_KEY_PROFILES, profiles, &size);
+    nvs_close(handle);
+    if (err == ESP_OK && size % sizeof(Profile) == 0) {
+      count = size / sizeof(Profile);
+    }
+  }
+
+  void CredentialStore::save() {
+    if (!dirty) {
+      return;
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to open NVS to save the networks");
+      return;
+    }
+    esp_err_t err = count > 0
+      ? nvs_set_blob(handle, NVS_KEY_PROFILES, profiles, count * sizeof(Profile))
+      : nvs_erase_key(handle, NVS_KEY_PROFILES);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+      nvs_commit(handle);
+      dirty = false;
+    }
+    nvs_close(handle);
+  }
+
+  void CredentialStore::add(const char* ssid, const char* password, uint8_t authmode, int8_t priority) {
+    Profile profile;
+    memset(&profile, 0, sizeof(profile));
+    memcpy(profile.ssid, ssid, strnlen(ssid, sizeof(profile.ssid)));
+    memcpy(profile.password, password, strnlen(password, sizeof(profile.password)));
+    profile.authmode = authmode;
+    profile.priority = priority;
+
+    size_t index = count;
+    for (size_t i = 0; i < count; ++i) {
+      if (memcmp(profiles[i].ssid, profile.ssid, sizeof(profile.ssid)) == 0) {
+        index = i;
+        break;
+      }
+    }
+
+    if (index < count) {
+      // Keep the history of a known network unless its password changed.
+      Profile& known = profiles[index];
+      if (memcmp(known.password, profile.password, sizeof(profile.password)) == 0) {
+        profile.failures = known.failures;
+        profile.last_success = known.last_success;
+      }
+      if (memcmp(&known, &profile, sizeof(profile)) == 0) {
+        return;
+      }
+    } else if (count < MAX_PROFILES) {
+      ++count;
+    } else {
+      // Replace the network least likely to be chosen.
+      index = 0;
+      for (size_t i = 1; i < count; ++i) {
+        if (score(i, -127) < score(index, -127)) {
+          index = i;
+        }
+      }
+    }
+    profiles[index] = profile;
+    dirty = true;
+  }
+
+  bool CredentialStore::remove(const char* ssid) {
+    uint8_t key[32] = {};
+    memcpy(key, ssid, strnlen(ssid, sizeof(key)));
+    for (size_t i = 0; i < count; ++i) {
+      if (memcmp(profiles[i].ssid, key, sizeof(key)) == 0) {
+        memmove(&profiles[i], &profiles[i + 1], (count - i - 1) * sizeof(Profile));
+        --count;
+        dirty = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const CredentialStore::Profile* CredentialStore::find(const uint8_t* ssid) const {
+    for (size_t i = 0; i < count; ++i) {
+      if (memcmp(profiles[i].ssid, ssid, sizeof(profiles[i].ssid)) == 0) {
+        return &profiles[i];
+      }
+    }
+    return nullptr;
+  }
+
+  size_t CredentialStore::getCount() const {
+    return count;
+  }
+
+  const CredentialStore::Profile& CredentialStore::get(size_t index) const {
+    return profiles[index];
+  }
+
+  void CredentialStore::recordSuccess(size_t index) {
+    Profile& profile = profiles[index];
+    int64_t now = time(nullptr);
+    if (profile.failures != 0 || now < profile.last_success || now - profile.last_success >= SUCCESS_REFRESH_S) {
+      profile.failures = 0;
+      profile.last_success = now;
+      dirty = true;
+    }
+  }
+
+  void CredentialStore::recordFailure(size_t index) {
+    Profile& profile = profiles[index];
+    if (profile.failures < UINT8_MAX) {
+      ++profile.failures;
+      dirty = true;
+    }
+  }
+
+  int CredentialStore::score(size_t index, int8_t rssi) const {
+    const Profile& profile = profiles[index];
+    // Signal strength first, nudged by the user priority and the connection history.
+    int score = rssi + profile.priority * 10;
+    if (profile.last_success != 0) {
+      score += 10;
+    }
+    score -= (profile.failures < 6 ? profile.failures : 6) * 5;
+    return score;
+  }
+
+}
\ No newline at end of file
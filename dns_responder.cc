@@ -0,0 +1,248 @@
+#include "dns_responder.hh"
+
+#include <cstring>
+
+namespace wifi_connect {
+
+  #define DNS_HEADER_SIZE    12
+  #define DNS_OPT_SIZE       11
+  #define DNS_MAX_NAME_SIZE  255
+
+  #define DNS_TYPE_A         1
+  #define DNS_TYPE_PTR       12
+  #define DNS_TYPE_AAAA      28
+  #define DNS_TYPE_OPT       41
+  #define DNS_TYPE_SVCB      64
+  #define DNS_TYPE_HTTPS     65
+  #define DNS_TYPE_ANY       255
+  #define DNS_CLASS_IN       1
+  #define DNS_CLASS_ANY      255
+
+  #define DNS_RCODE_NOERROR  0
+  #define DNS_RCODE_FORMERR  1
+  #define DNS_RCODE_NXDOMAIN 3
+  #define DNS_RCODE_NOTIMP   4
+  #define DNS_RCODE_REFUSED  5
+  #define DNS_RCODE_BADVERS  16
+
+  static inline uint16_t readU16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+  }
+
+  static inline void writeU16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value);
+  }
+
+  ////////////////////////////////
+  // Public methods
+
+  DNSResponder::DNSResponder()
+    : has_address6(false)
+  {
+    setAddress(0);
+    setAddress6(nullptr);
+  }
+
+  void DNSResponder::setAddress(uint32_t address) {
+    // Pointer to the question name, type A, class IN, TTL 28s, data length 4.
+    static const uint8_t header[12] = { 0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x1C, 0x00, 0x04 };
+    memcpy(answer_template, header, sizeof(header));
+    memcpy(answer_template + sizeof(header), &address, 4);
+  }
+
+  void DNSResponder::setAddress6(const uint8_t* address) {
+    // Pointer to the question name, type AAAA, class IN, TTL 28s, data length 16.
+    static const uint8_t header[12] = { 0xC0, 0x0C, 0x00, 0x1C, 0x00, 0x01, 0x00, 0x00, 0x00, 0x1C, 0x00, 0x10 };
+    uint8_t* record = answer_template + A_RECORD_SIZE;
+    memcpy(record, header, sizeof(header));
+    if (address != nullptr) {
+      memcpy(record + sizeof(header), address, 16);
+    } else {
+      memset(record + sizeof(header), 0, 16);
+    }
+    has_address6 = address != nullptr;
+  }
+
+  size_t DNSResponder::respond(const uint8_t* query, size_t query_len, uint8_t* response, size_t response_size,
+    QueryType* type) const {
+    if (type != nullptr) {
+      *type = QueryType::Other;
+    }
+
+    // Drop anything that is not a query with a complete header.
+    if (query_len < DNS_HEADER_SIZE || (query[2] & 0x80) != 0) {
+      return 0;
+    }
+
+    uint8_t opcode = (query[2] >> 3) & 0x0F;
+    if (opcode != 0) {
+      return build(query, nullptr, DNS_RCODE_NOTIMP, nullptr, 0, 0, response, response_size);
+    }
+
+    // Exactly one question is supported, as in every real-world resolver.
+    if (readU16(query + 4) != 1) {
+      return build(query, nullptr, DNS_RCODE_FORMERR, nullptr, 0, 0, response, response_size);
+    }
+
+    // Parse the question. Names in the question are never compressed.
+    Query parsed = {};
+    size_t offset = DNS_HEADER_SIZE;
+    if (!skipName(query, query_len, offset, false) || offset + 4 > query_len) {
+      return build(query, nullptr, DNS_RCODE_FORMERR, nullptr, 0, 0, response, response_size);
+    }
+    parsed.qtype = readU16(query + offset);
+    parsed.qclass = readU16(query + offset + 2);
+    parsed.question_end = offset + 4;
+    if (type != nullptr) {
+      *type = classify(parsed.qtype);
+    }
+
+    findOpt(query, query_len, parsed);
+    if (parsed.has_opt && parsed.edns_version != 0) {
+      return build(query, &parsed, DNS_RCODE_BADVERS, nullptr, 0, 0, response, response_size);
+    }
+
+    if (parsed.qclass != DNS_CLASS_IN && parsed.qclass != DNS_CLASS_ANY) {
+      return build(query, &parsed, DNS_RCODE_REFUSED, nullptr, 0, 0, response, response_size);
+    }
+
+    // Point every name to the gateway, and answer anything else with no data rather than a mismatched record.
+    switch (parsed.qtype) {
+      case DNS_TYPE_A:
+        return build(query, &parsed, DNS_RCODE_NOERROR, answer_template, A_RECORD_SIZE, 1, response, response_size);
+      case DNS_TYPE_AAAA:
+        if (has_address6) {
+          return build(query, &parsed, DNS_RCODE_NOERROR, answer_template + A_RECORD_SIZE, AAAA_RECORD_SIZE, 1,
+            response, response_size);
+        }
+        return build(query, &parsed, DNS_RCODE_NOERROR, nullptr, 0, 0, response, response_size);
+      case DNS_TYPE_ANY:
+        return build(query, &parsed, DNS_RCODE_NOERROR, answer_template,
+          has_address6 ? sizeof(answer_template) : A_RECORD_SIZE, has_address6 ? 2 : 1, response, response_size);
+      case DNS_TYPE_PTR:
+        // The portal has no names of its own to give for an address.
+        return build(query, &parsed, DNS_RCODE_NXDOMAIN, nullptr, 0, 0, response, response_size);
+      default:
+        return build(query, &parsed, DNS_RCODE_NOERROR, nullptr, 0, 0, response, response_size);
+    }
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  bool DNSResponder::skipName(const uint8_t* message, size_t len, size_t& offset, bool allow_pointers) {
+    size_t name_len = 0;
+    while (offset < len) {
+      uint8_t label_len = message[offset];
+      if (label_len == 0) {
+        offset += 1;
+        return true;
+      }
+      if ((label_len & 0xC0) == 0xC0) {
+        // A compression pointer always ends the name.
+        if (!allow_pointers || offset + 2 > len) {
+          return false;
+        }
+        offset += 2;
+        return true;
+      }
+      if ((label_len & 0xC0) != 0) {
+        return false;
+      }
+      name_len += label_len + 1;
+      if (name_len > DNS_MAX_NAME_SIZE) {
+        return false;
+      }
+      offset += label_len + 1;
+    }
+    return false;
+  }
+
+  void DNSResponder::findOpt(const uint8_t* message, size_t len, Query& query) {
+    // Skip the answer and authority records; queries normally have none.
+    size_t records = readU16(message + 6) + readU16(message + 8);
+    size_t additional = readU16(message + 10);
+    size_t offset = query.question_end;
+
+    for (size_t i = 0; i < records + additional; ++i) {
+      size_t name_offset = offset;
+      if (!skipName(message, len, offset, true) || offset + 10 > len) {
+        return;
+      }
+      uint16_t type = readU16(message + offset);
+      size_t rdlen = readU16(message + offset + 8);
+      if (i >= records && type == DNS_TYPE_OPT && message[name_offset] == 0) {
+        query.has_opt = true;
+        query.edns_version = message[offset + 5];
+        return;
+      }
+      offset += 10 + rdlen;
+    }
+  }
+
+  DNSResponder::QueryType DNSResponder::classify(uint16_t qtype) {
+    switch (qtype) {
+      case DNS_TYPE_A:
+        return QueryType::A;
+      case DNS_TYPE_AAAA:
+        return QueryType::AAAA;
+      case DNS_TYPE_SVCB:
+      case DNS_TYPE_HTTPS:
+        return QueryType::HTTPS;
+      case DNS_TYPE_PTR:
+        return QueryType::PTR;
+      case DNS_TYPE_ANY:
+        return QueryType::ANY;
+      default:
+        return QueryType::Other;
+    }
+  }
+
+  size_t DNSResponder::build(const uint8_t* query, const Query* parsed, uint8_t rcode,
+    const uint8_t* answer, size_t answer_len, uint16_t answer_count, uint8_t* response, size_t response_size) {
+    size_t question_len = parsed ? parsed->question_end - DNS_HEADER_SIZE : 0;
+    bool has_opt = parsed && parsed->has_opt;
+    size_t len = DNS_HEADER_SIZE + question_len + answer_len + (has_opt ? DNS_OPT_SIZE : 0);
+    if (len > response_size) {
+      return 0;
+    }
+
+    // Header: same ID and opcode, authoritative, recursion desired copied, recursion available.
+    response[0] = query[0];
+    response[1] = query[1];
+    response[2] = 0x80 | (query[2] & 0x79);
+    response[3] = 0x80 | (rcode & 0x0F);
+    writeU16(response + 4, parsed ? 1 : 0);
+    writeU16(response + 6, answer_count);
+    writeU16(response + 8, 0);
+    writeU16(response + 10, has_opt ? 1 : 0);
+    if (parsed) {
+      response[2] |= 0x04;
+    }
+
+    size_t offset = DNS_HEADER_SIZE;
+    memcpy(response + offset, query + DNS_HEADER_SIZE, question_len);
+    offset += question_len;
+    if (answer) {
+      memcpy(response + offset, answer, answer_len);
+      offset += answer_len;
+    }
+
+    if (has_opt) {
+      // Root name, type OPT, our UDP payload size, extended RCODE, version 0, no flags, no options.
+      uint8_t* opt = response + offset;
+      opt[0] = 0;
+      writeU16(opt + 1, DNS_TYPE_OPT);
+      writeU16(opt + 3, DNSResponder::MAX_MESSAGE_SIZE);
+      opt[5] = rcode >> 4;
+      opt[6] = 0;
+      writeU16(opt + 7, 0);
+      writeU16(opt + 9, 0);
+      offset += DNS_OPT_SIZE;
+    }
+
+    return offset;
+  }
+
+}
\ No newline at end of file
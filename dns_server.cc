@@ -1,12 +1,6 @@
 #include "dns_server.hh"
 
-#include <esp_log.h>
-
-#include <lwip/sockets.h>
-#include <lwip/netdb.h>
-
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
+#include <cstring>
 
 namespace wifi_connect {
 
@@ -17,93 +11,241 @@ namespace wifi_connect {
 
   DNSServer::DNSServer()
     : port(53)
-    , server_socket(-1)
-    , task_handle(nullptr)
-  {}
+    , running(false)
+    , stats()
+    , window_start(0)
+    , window_queries(0)
+    , previous_window_queries(0)
+  {
+    memset(cache, 0, sizeof(cache));
+  }
 
   DNSServer::~DNSServer() {
     stop();
   }
 
+  void DNSServer::setPort(uint16_t port) {
+    this->port = port;
+  }
+
+  void DNSServer::setAddress6(const uint8_t* address) {
+    this->responder.setAddress6(address);
+    // Cached AAAA and ANY answers no longer hold.
+    memset(this->cache, 0, sizeof(this->cache));
+  }
+
   void DNSServer::start(const esp_ip4_addr_t& gateway) {
-    this->gateway = gateway;
-    this->server_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (this->server_socket < 0) {
-      ESP_LOGE(TAG, "Failed to create the DNS server socket");
-      return;
+    // A task that did not stop in time still owns the socket and the buffers.
+    if (this->task.isRunning()) {
+      if (!this->task.stop(STOP_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "The previous DNS server task is still running");
+        return;
+      }
+      this->transport.close();
     }
 
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    server_addr.sin_port = htons(port);
-
-    if (bind(this->server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-      ESP_LOGE(TAG, "Failed to bind the DNS server socket to port %d", port);
-      close(this->server_socket);
+    this->responder.setAddress(gateway.addr);
+    memset(this->cache, 0, sizeof(this->cache));
+    {
+      std::lock_guard<std::mutex> lock(this->stats_mutex);
+      this->stats = {};
+      this->window_start = esp_timer_get_time();
+      this->window_queries = 0;
+      this->previous_window_queries = 0;
+    }
+    if (!this->transport.open(this->port)) {
+      ESP_LOGE(TAG, "Failed to open the DNS server socket on port %d", this->port);
       return;
     }
 
     // Start the DNS server task.
-    xTaskCreate(
+    this->running = true;
+    this->task.start(
+      "dns_server",
+      CONFIG_WIFI_CONNECT_DNS_TASK_STACK_SIZE,
+      CONFIG_WIFI_CONNECT_DNS_TASK_PRIORITY,
+      CONFIG_WIFI_CONNECT_DNS_TASK_CORE,
       [](void* arg) {
         auto dns_server = static_cast<DNSServer*>(arg);
         dns_server->run();
       },
-      "dns_server",
-      4096,
       this,
-      5,
-      &this->task_handle
+#if CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+      this->task_stack
+#else
+      nullptr
+#endif
     );
   }
 
   void DNSServer::stop() {
-    // Stop the DNS server task.
-    if (this->task_handle) {
-      vTaskDelete(this->task_handle);
-      this->task_handle = nullptr;
+    // Ask the task to return and wait for it, the socket is only closed once nothing uses it.
+    this->running = false;
+    if (!this->task.stop(STOP_TIMEOUT_MS)) {
+      // Leave the socket to the task rather than close it under a call; start() retries the stop.
+      return;
     }
 
     // Close the DNS server socket.
-    if (this->server_socket >= 0) {
-      close(this->server_socket);
-      this->server_socket = -1;
+    this->transport.close();
+  }
+
+  DNSServer::Stats DNSServer::getStats() const {
+    std::unique_lock<std::mutex> lock(this->stats_mutex);
+    Stats stats = this->stats;
+    // The rate of the last full second, worked out now rather than when the next query comes.
+    int64_t elapsed = esp_timer_get_time() - this->window_start;
+    if (elapsed < 1000000) {
+      stats.qps = this->previous_window_queries;
+    } else if (elapsed < 2000000) {
+      stats.qps = this->window_queries;
+    } else {
+      stats.qps = 0;
     }
+    lock.unlock();
+    stats.cache_hit_rate = stats.queries > 0 ? static_cast<uint32_t>(100ull * stats.cache_hits / stats.queries) : 0;
+    stats.stack_free = this->task.getStackHighWaterMark();
+    return stats;
   }
 
   ////////////////////////////////
   // Private methods
 
   void DNSServer::run() {
-    char buffer[512];
-    while (true) {
-      struct sockaddr_in client_addr;
-      socklen_t client_addr_len = sizeof(client_addr);
-      int len = recvfrom(this->server_socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&client_addr, &client_addr_len);
-      if (len < 0) {
-        ESP_LOGE(TAG, "Failed to receive data from the DNS client.");
+    uint32_t poll_errors = 0;
+    while (this->running) {
+      // Wait a bounded time for a datagram, so a stop request is seen quickly.
+      int ready = this->transport.poll(POLL_INTERVAL_MS);
+      if (ready < 0) {
+        // A broken socket fails every poll, open a new one before giving up.
+        ESP_LOGE(TAG, "Failed to wait for the DNS clients, reopening the socket.");
+        this->transport.close();
+        if (++poll_errors > MAX_POLL_ERRORS || !this->transport.open(this->port)) {
+          ESP_LOGE(TAG, "DNS server socket lost, stopping.");
+          this->running = false;
+          break;
+        }
+        continue;
+      }
+      poll_errors = 0;
+      if (ready == 0) {
         continue;
       }
 
-      // Simple DNS response: point all requests to the gateway.
-      buffer[2] |= 0x80; // Set the response flag.
-      buffer[3] |= 0x80; // Set the recursion available.
-      buffer[7] = 1; // Set the answer count to 1.
-
-      // Add answer section.
-      memcpy(&buffer[len], "\xC0\x0C", 2); // Pointer to the domain name.
-      len += 2;
-      memcpy(&buffer[len], "\x00\x01\x00\x01\x00\x00\x00\x1C\x00\x04", 10); // Type A, Class IN, TTL 28s, Data length 4.
-      len += 10;
-      memcpy(&buffer[len], &this->gateway.addr, 4); // Gateway IP address.
-      len += 4;
-
-      if (sendto(this->server_socket, buffer, len, 0, (struct sockaddr*)&client_addr, client_addr_len) < 0) {
-        ESP_LOGE(TAG, "Failed to send data to the DNS client.");
+      // Drain everything already queued.
+      uint32_t batch = 0;
+      while (this->running) {
+        UDPEndpoint client;
+        int len = this->transport.receive(this->buffer, sizeof(this->buffer), client, false);
+        if (len < 0) {
+          ESP_LOGE(TAG, "Failed to receive data from the DNS client.");
+          break;
+        }
+        if (len == 0) {
+          break;
+        }
+        ++batch;
+        DNSResponder::QueryType type;
+        bool cached;
+        size_t response_len = answer(this->buffer, len, this->response, type, cached);
+        countQuery(type, cached);
+        if (response_len == 0) {
+          continue;
+        }
+
+        if (!this->transport.send(this->response, response_len, client)) {
+          ESP_LOGE(TAG, "Failed to send data to the DNS client.");
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(this->stats_mutex);
+      if (batch > this->stats.max_batch) {
+        this->stats.max_batch = batch;
       }
     }
   }
 
+  size_t DNSServer::answer(const uint8_t* query, size_t query_len, uint8_t* response, DNSResponder::QueryType& type,
+    bool& cached) {
+    cached = false;
+    if (query_len < 2 || query_len - 2 > CACHE_QUERY_SIZE) {
+      return this->responder.respond(query, query_len, response, DNSResponder::MAX_MESSAGE_SIZE, &type);
+    }
+
+    // FNV-1a over everything but the ID, so the entry holds the whole answer.
+    const uint8_t* key = query + 2;
+    size_t key_len = query_len - 2;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < key_len; ++i) {
+      hash = (hash ^ key[i]) * 16777619u;
+    }
+
+    CacheEntry& entry = this->cache[hash % CACHE_SIZE];
+    if (entry.query_len == key_len && entry.hash == hash && memcmp(entry.query, key, key_len) == 0) {
+      cached = true;
+      type = entry.type;
+      memcpy(response, entry.response, entry.response_len);
+      response[0] = query[0];
+      response[1] = query[1];
+      return entry.response_len;
+    }
+
+    size_t response_len = this->responder.respond(query, query_len, response, DNSResponder::MAX_MESSAGE_SIZE, &type);
+    if (response_len > 0 && response_len <= CACHE_RESPONSE_SIZE) {
+      entry.hash = hash;
+      entry.query_len = key_len;
+      entry.response_len = response_len;
+      entry.type = type;
+      memcpy(entry.query, key, key_len);
+      memcpy(entry.response, response, response_len);
+    }
+    return response_len;
+  }
+
+  void DNSServer::countQuery(DNSResponder::QueryType type, bool cached) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(this->stats_mutex);
+    if (this->stats.queries == 0) {
+      this->stats.first_query_time = now;
+    }
+    ++this->stats.queries;
+    advanceWindow(now);
+    ++this->window_queries;
+    if (cached) {
+      ++this->stats.cache_hits;
+    }
+
+    switch (type) {
+      case DNSResponder::QueryType::A:
+        ++this->stats.a_queries;
+        break;
+      case DNSResponder::QueryType::AAAA:
+        ++this->stats.aaaa_queries;
+        break;
+      case DNSResponder::QueryType::HTTPS:
+        ++this->stats.https_queries;
+        break;
+      case DNSResponder::QueryType::PTR:
+        ++this->stats.ptr_queries;
+        break;
+      case DNSResponder::QueryType::ANY:
+        ++this->stats.any_queries;
+        break;
+      case DNSResponder::QueryType::Other:
+        ++this->stats.other_queries;
+        break;
+    }
+  }
+
+  void DNSServer::advanceWindow(int64_t now) {
+    int64_t elapsed = now - this->window_start;
+    if (elapsed < 1000000) {
+      return;
+    }
+    // Windows are whole seconds apart, and a second without queries leaves an empty previous window.
+    this->previous_window_queries = elapsed < 2000000 ? this->window_queries : 0;
+    this->window_start += elapsed / 1000000 * 1000000;
+    this->window_queries = 0;
+  }
+
 }
\ No newline at end of file
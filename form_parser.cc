@@ -0,0 +1,143 @@
+#include "form_parser.hh"
+
+namespace wifi_connect {
+
+  static inline int hexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+      return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+      return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+      return ch - 'A' + 10;
+    }
+    return -1;
+  }
+
+  ////////////////////////////////
+  // Public methods
+
+  FormParser::FormParser(Field* fields, size_t count)
+    : fields(fields)
+    , count(count)
+    , current(nullptr)
+    , in_value(false)
+    , name_overflow(false)
+    , failed(false)
+    , escape_digits(0)
+    , escape_value(0)
+    , name_len(0)
+    , name()
+  {
+    for (size_t i = 0; i < count; ++i) {
+      fields[i].length = 0;
+      fields[i].present = false;
+      if (fields[i].size > 0) {
+        fields[i].value[0] = '\0';
+      }
+    }
+  }
+
+  bool FormParser::feed(const char* data, size_t len) {
+    for (size_t i = 0; i < len && !failed; ++i) {
+      char ch = data[i];
+      if (escape_digits > 0) {
+        // An escape may be split across pieces, keep its state until both digits are seen.
+        int digit = hexValue(ch);
+        if (digit < 0) {
+          failed = true;
+          break;
+        }
+        escape_value = static_cast<uint8_t>((escape_value << 4) | digit);
+        if (--escape_digits == 0) {
+          put(static_cast<char>(escape_value));
+        }
+      } else if (ch == '%') {
+        escape_digits = 2;
+        escape_value = 0;
+      } else if (ch == '&') {
+        endPair();
+      } else if (ch == '=' && !in_value) {
+        endName();
+      } else {
+        put(ch == '+' ? ' ' : ch);
+      }
+    }
+    return !failed;
+  }
+
+  bool FormParser::finish() {
+    if (escape_digits > 0) {
+      failed = true;
+    }
+    if (!failed) {
+      endPair();
+    }
+    return !failed;
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  void FormParser::put(char ch) {
+    // A null byte would silently cut the value short.
+    if (ch == '\0') {
+      failed = true;
+      return;
+    }
+
+    if (!in_value) {
+      if (name_len < sizeof(name)) {
+        name[name_len++] = ch;
+      } else {
+        name_overflow = true;
+      }
+      return;
+    }
+
+    if (current == nullptr) {
+      return;
+    }
+    if (current->length + 1 >= current->size) {
+      failed = true;
+      return;
+    }
+    current->value[current->length++] = ch;
+    current->value[current->length] = '\0';
+  }
+
+  void FormParser::endName() {
+    in_value = true;
+    current = nullptr;
+    if (name_overflow) {
+      return;
+    }
+
+    std::string_view key(name, name_len);
+    for (size_t i = 0; i < count; ++i) {
+      if (fields[i].name == key) {
+        // The last occurrence of a field wins.
+        current = &fields[i];
+        current->present = true;
+        current->length = 0;
+        if (current->size > 0) {
+          current->value[0] = '\0';
+        }
+        break;
+      }
+    }
+  }
+
+  void FormParser::endPair() {
+    // A name without '=' is a field with an empty value.
+    if (!in_value && name_len > 0) {
+      endName();
+    }
+    in_value = false;
+    current = nullptr;
+    name_overflow = false;
+    name_len = 0;
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef __CONNECTION_STATS_HH__
+#define __CONNECTION_STATS_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace wifi_connect {
+
+  /// @brief The per-phase timing of connection attempts.
+  /// The phases follow the WiFi and IP events: association covers the scan,
+  /// authentication and association steps, which the driver reports as one
+  /// WIFI_EVENT_STA_CONNECTED, and DHCP runs from there to IP_EVENT_STA_GOT_IP.
+  /// The statistics are recorded from the event loop and read from any task, so the
+  /// getters return copies taken under a lock.
+  class ConnectionStats {
+  public:
+    /// @brief The number of histogram buckets. Bucket i counts durations below 2^i ms, the last one the rest.
+    static constexpr size_t HISTOGRAM_BUCKETS = 16;
+    /// @brief The number of most recent samples the histograms cover.
+    static constexpr size_t WINDOW_SIZE = 32;
+    /// @brief The number of distinct disconnect reasons tracked.
+    static constexpr size_t MAX_REASONS = 8;
+
+    /// @brief The timing of a single attempt. Times are in microseconds since boot, 0 if not reached.
+    struct Attempt {
+      /// @brief The time the attempt started.
+      int64_t start_us;
+      /// @brief The time the station associated.
+      int64_t associated_us;
+      /// @brief The time the IP address was obtained.
+      int64_t got_ip_us;
+      /// @brief The time the attempt ended.
+      int64_t end_us;
+      /// @brief The last disconnect reason during the attempt, 0 if none.
+      uint16_t disconnect_reason;
+      /// @brief Whether the attempt was successful.
+      bool success;
+    };
+
+    /// @brief The histogram of a phase duration over the last WINDOW_SIZE samples.
+    struct Histogram {
+      /// @brief The number of samples per bucket.
+      uint32_t buckets[HISTOGRAM_BUCKETS];
+      /// @brief The number of samples, at most WINDOW_SIZE.
+      uint32_t count;
+      /// @brief The sum of the samples in microseconds.
+      int64_t total_us;
+      /// @brief The largest sample in microseconds.
+      int64_t max_us;
+    };
+
+    /// @brief The number of disconnects with a reason code.
+    struct ReasonCount {
+      /// @brief The reason code from wifi_event_sta_disconnected_t.
+      uint16_t reason;
+      /// @brief The number of disconnects.
+      uint32_t count;
+    };
+
+    /// @brief The constructor.
+    ConnectionStats();
+
+    /// @brief Clear all the statistics.
+    void reset();
+
+    /// @brief Record the start of an attempt.
+    void beginAttempt();
+    /// @brief Record the station association.
+    void onAssociated();
+    /// @brief Record a disconnect.
+    /// @param reason The reason code.
+    void onDisconnected(uint16_t reason);
+    /// @brief Record the IP address being obtained.
+    void onGotIP();
+    /// @brief Record the end of the attempt and add its phases to the histograms.
+    /// @param success Whether the attempt was successful.
+    void endAttempt(bool success);
+
+    /// @brief Get the last attempt, or the current one while it runs.
+    /// @return The attempt.
+    Attempt getLastAttempt() const;
+    /// @brief Get the histogram of the association phase.
+    /// @return The histogram.
+    Histogram getAssociationHistogram() const;
+    /// @brief Get the histogram of the DHCP phase.
+    /// @return The histogram.
+    Histogram getDHCPHistogram() const;
+    /// @brief Get the histogram of successful attempts from start to IP address.
+    /// @return The histogram.
+    Histogram getTotalHistogram() const;
+    /// @brief Get the disconnect reason counts.
+    /// @param reasons The entries.
+    /// @param size The maximum number of entries, MAX_REASONS for all of them.
+    /// @return The number of entries.
+    size_t getReasons(ReasonCount* reasons, size_t size) const;
+    /// @brief Get the number of disconnects whose reason did not fit in the table.
+    /// @return The number of disconnects.
+    uint32_t getOtherReasons() const;
+
+  private:
+    /// @brief The most recent samples of a phase duration.
+    struct Window {
+      /// @brief The samples in microseconds, oldest overwritten first.
+      uint32_t samples_us[WINDOW_SIZE];
+      /// @brief The index of the next sample.
+      size_t next;
+      /// @brief The number of samples.
+      size_t count;
+    };
+
+    /// @brief The statistics mutex.
+    mutable std::mutex mutex;
+    /// @brief The current or last attempt.
+    Attempt attempt;
+    /// @brief Whether an attempt is running.
+    bool in_attempt;
+    /// @brief The association phase samples.
+    Window association;
+    /// @brief The DHCP phase samples.
+    Window dhcp;
+    /// @brief The total time samples.
+    Window total;
+    /// @brief The disconnect reason counts.
+    ReasonCount reasons[MAX_REASONS];
+    /// @brief The number of disconnect reason entries.
+    size_t reason_count;
+    /// @brief The number of disconnects not in the table.
+    uint32_t other_reasons;
+
+    /// @brief Add a sample to a window, replacing the oldest one when full.
+    /// @param window The window.
+    /// @param duration_us The duration in microseconds.
+    static void addSample(Window& window, int64_t duration_us);
+
+    /// @brief Build the histogram of the samples of a window. The mutex must be held.
+    /// @param window The window.
+    /// @return The histogram.
+    static Histogram getHistogram(const Window& window);
+  };
+
+}
+
+#endif // __CONNECTION_STATS_HH__
\ No newline at end of file
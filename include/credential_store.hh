@@ -0,0 +1,95 @@
+#ifndef __CREDENTIAL_STORE_HH__
+#define __CREDENTIAL_STORE_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wifi_connect {
+
+  /// @brief The on-flash table of known networks.
+  /// The whole table is a single NVS blob, loaded and saved at once.
+  class CredentialStore {
+  public:
+    /// @brief The maximum number of networks.
+    static constexpr size_t MAX_PROFILES = 5;
+
+    /// @brief A known network.
+    struct Profile {
+      /// @brief The SSID, not null-terminated when 32 bytes long.
+      uint8_t ssid[32];
+      /// @brief The password, not null-terminated when 64 bytes long.
+      uint8_t password[64];
+      /// @brief The minimum authentication mode accepted.
+      uint8_t authmode;
+      /// @brief The user priority, higher is preferred.
+      int8_t priority;
+      /// @brief The number of failed attempts since the last success.
+      uint8_t failures;
+      /// @brief Reserved, keeps the layout aligned.
+      uint8_t reserved;
+      /// @brief The system time of the last successful connection in seconds, 0 if never.
+      int64_t last_success;
+    };
+
+    /// @brief The constructor.
+    CredentialStore();
+
+    /// @brief Load the table from NVS.
+    void load();
+
+    /// @brief Save the table to NVS if it changed.
+    void save();
+
+    /// @brief Add a network, or update it if it is already known.
+    /// When the table is full the lowest-ranked network is replaced.
+    /// @param ssid The SSID.
+    /// @param password The password.
+    /// @param authmode The minimum authentication mode accepted.
+    /// @param priority The user priority, higher is preferred.
+    void add(const char* ssid, const char* password, uint8_t authmode, int8_t priority);
+
+    /// @brief Remove a network.
+    /// @param ssid The SSID.
+    /// @return True if the network was known, false otherwise.
+    bool remove(const char* ssid);
+
+    /// @brief Find a network.
+    /// @param ssid The SSID, 32 bytes padded with zeros.
+    /// @return The network, or null if it is unknown.
+    const Profile* find(const uint8_t* ssid) const;
+
+    /// @brief Get the number of networks.
+    /// @return The number of networks.
+    size_t getCount() const;
+
+    /// @brief Get a network.
+    /// @param index The index, below getCount().
+    /// @return The network.
+    const Profile& get(size_t index) const;
+
+    /// @brief Record a successful connection.
+    /// @param index The index of the network.
+    void recordSuccess(size_t index);
+
+    /// @brief Record a failed connection.
+    /// @param index The index of the network.
+    void recordFailure(size_t index);
+
+    /// @brief Score a network for the connection order, higher is tried first.
+    /// @param index The index of the network.
+    /// @param rssi The signal strength of its best access point.
+    /// @return The score.
+    int score(size_t index, int8_t rssi) const;
+
+  private:
+    /// @brief The networks.
+    Profile profiles[MAX_PROFILES];
+    /// @brief The number of networks.
+    size_t count;
+    /// @brief Whether the table differs from NVS.
+    bool dirty;
+  };
+
+}
+
+#endif // __CREDENTIAL_STORE_HH__
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef __DNS_RESPONDER_HH__
+#define __DNS_RESPONDER_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wifi_connect {
+
+  /// @brief The DNS wire-format parser and answer builder.
+  /// Every name resolves to a single IPv4 address, and optionally a single IPv6
+  /// address. Other query types get an empty answer right away, so that clients
+  /// asking for AAAA or HTTPS records in parallel never wait for a timeout.
+  /// The responder never allocates and never reads or writes outside the buffers
+  /// it is given.
+  class DNSResponder {
+  public:
+    /// @brief The maximum size of a DNS message over UDP without EDNS.
+    static constexpr size_t MAX_MESSAGE_SIZE = 512;
+
+    /// @brief The query types counted separately.
+    enum class QueryType : uint8_t {
+      /// @brief An IPv4 address query.
+      A,
+      /// @brief An IPv6 address query.
+      AAAA,
+      /// @brief An HTTPS or SVCB service binding query.
+      HTTPS,
+      /// @brief A reverse lookup.
+      PTR,
+      /// @brief A query for all records.
+      ANY,
+      /// @brief Any other query type, or a message without a valid question.
+      Other,
+    };
+
+    /// @brief The constructor.
+    DNSResponder();
+
+    /// @brief Set the address every name resolves to.
+    /// @param address The IPv4 address in network byte order.
+    void setAddress(uint32_t address);
+
+    /// @brief Set the address every name resolves to for AAAA queries.
+    /// @param address The 16-byte IPv6 address, or null to answer AAAA queries with no data.
+    void setAddress6(const uint8_t* address);
+
+    /// @brief Build the response to a DNS query.
+    /// @param query The query message.
+    /// @param query_len The query message length.
+    /// @param response The response buffer.
+    /// @param response_size The response buffer size, at least MAX_MESSAGE_SIZE.
+    /// @param type The type of the query, updated if not null.
+    /// @return The response length, or 0 if the message must be dropped.
+    size_t respond(const uint8_t* query, size_t query_len, uint8_t* response, size_t response_size,
+      QueryType* type = nullptr) const;
+
+  private:
+    /// @brief The size of the precomputed A record.
+    static constexpr size_t A_RECORD_SIZE = 16;
+    /// @brief The size of the precomputed AAAA record.
+    static constexpr size_t AAAA_RECORD_SIZE = 28;
+
+    /// @brief The precomputed A record followed by the AAAA record, so that both answer an ANY query.
+    /// Each holds a name pointer, the type, class, TTL, length and address.
+    uint8_t answer_template[A_RECORD_SIZE + AAAA_RECORD_SIZE];
+    /// @brief Whether AAAA queries are answered with an address.
+    bool has_address6;
+
+    /// @brief The parsed query.
+    struct Query {
+      /// @brief The offset of the first byte after the first question.
+      size_t question_end;
+      /// @brief The query type.
+      uint16_t qtype;
+      /// @brief The query class.
+      uint16_t qclass;
+      /// @brief Whether the query carries an EDNS OPT record.
+      bool has_opt;
+      /// @brief The EDNS version of the OPT record.
+      uint8_t edns_version;
+    };
+
+    /// @brief Skip an encoded domain name.
+    /// @param message The message.
+    /// @param len The message length.
+    /// @param offset The name offset, updated to the first byte after the name.
+    /// @param allow_pointers Whether compression pointers are accepted.
+    /// @return True if the name is well formed, false otherwise.
+    static bool skipName(const uint8_t* message, size_t len, size_t& offset, bool allow_pointers);
+
+    /// @brief Scan the sections after the first question for an EDNS OPT record.
+    /// @param message The message.
+    /// @param len The message length.
+    /// @param query The parsed query, updated with the OPT record information.
+    static void findOpt(const uint8_t* message, size_t len, Query& query);
+
+    /// @brief Map a query type to its counter.
+    /// @param qtype The query type.
+    /// @return The counted type.
+    static QueryType classify(uint16_t qtype);
+
+    /// @brief Write the response header, the echoed question and the optional OPT record.
+    /// @param query The query message.
+    /// @param parsed The parsed query, or null if the question is not echoed.
+    /// @param rcode The response code.
+    /// @param answer The answer records, or null for no answer.
+    /// @param answer_len The answer records length.
+    /// @param answer_count The number of answer records.
+    /// @param response The response buffer.
+    /// @param response_size The response buffer size.
+    /// @return The response length, or 0 if it does not fit.
+    static size_t build(const uint8_t* query, const Query* parsed, uint8_t rcode,
+      const uint8_t* answer, size_t answer_len, uint16_t answer_count, uint8_t* response, size_t response_size);
+  };
+
+}
+
+#endif // __DNS_RESPONDER_HH__
\ No newline at end of file
@@ -1,39 +1,159 @@
 #ifndef __DNS_SERVER_HH__
 #define __DNS_SERVER_HH__
 
-#include <esp_netif_ip_addr.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 
-typedef struct tskTaskControlBlock * TaskHandle_t;
+#include "dns_responder.hh"
+#include "platform.hh"
+#include "transport.hh"
 
 namespace wifi_connect {
 
   /// @brief The DNS server class.
+  /// A single task waits on the socket with a bounded timeout, so stop() only
+  /// has to ask it to return and never interrupts a receive.
   class DNSServer {
   public:
+    /// @brief The DNS server statistics.
+    struct Stats {
+      /// @brief The total number of queries received.
+      uint32_t queries;
+      /// @brief The number of queries answered from the response cache.
+      uint32_t cache_hits;
+      /// @brief The cache hit rate in percent.
+      uint32_t cache_hit_rate;
+      /// @brief The number of queries received during the last full second, 0 once idle.
+      uint32_t qps;
+      /// @brief The largest number of queries drained in a single wakeup.
+      uint32_t max_batch;
+      /// @brief The minimum free stack of the DNS server task in bytes.
+      uint32_t stack_free;
+      /// @brief The time of the first query in microseconds since boot, 0 if none.
+      int64_t first_query_time;
+      /// @brief The number of A queries.
+      uint32_t a_queries;
+      /// @brief The number of AAAA queries.
+      uint32_t aaaa_queries;
+      /// @brief The number of HTTPS and SVCB queries.
+      uint32_t https_queries;
+      /// @brief The number of PTR queries.
+      uint32_t ptr_queries;
+      /// @brief The number of ANY queries.
+      uint32_t any_queries;
+      /// @brief The number of other queries, including malformed ones.
+      uint32_t other_queries;
+    };
+
     /// @brief The constructor.
     DNSServer();
     /// @brief The destructor.
     ~DNSServer();
 
+    /// @brief Set the DNS port.
+    /// @param port The UDP port, 53 by default.
+    void setPort(uint16_t port);
+
+    /// @brief Set the IPv6 address AAAA queries resolve to.
+    /// Without one, AAAA queries are answered with no data. Call before start().
+    /// @param address The 16-byte IPv6 address, or null for none.
+    void setAddress6(const uint8_t* address);
+
     /// @brief Start the DNS server.
     /// @param gateway The gateway IP address.
     void start(const esp_ip4_addr_t& gateway);
 
     /// @brief Stop the DNS server.
+    /// If the task does not return in time, it keeps its socket, and the next start() waits for it again.
     void stop();
 
+    /// @brief Get the DNS server statistics, from any task.
+    /// @return The statistics.
+    Stats getStats() const;
+
   private:
+    /// @brief The longest time the task waits before checking for a stop request.
+    static constexpr uint32_t POLL_INTERVAL_MS = 100;
+    /// @brief The longest time stop() waits for the task to return.
+    static constexpr uint32_t STOP_TIMEOUT_MS = 1000;
+    /// @brief The consecutive poll failures after which the server stops.
+    static constexpr uint32_t MAX_POLL_ERRORS = 3;
+    /// @brief The number of response cache entries.
+    static constexpr size_t CACHE_SIZE = 8;
+    /// @brief The largest query that can be cached, without its ID.
+    static constexpr size_t CACHE_QUERY_SIZE = 94;
+    /// @brief The largest response that can be cached.
+    static constexpr size_t CACHE_RESPONSE_SIZE = 128;
+
+    /// @brief A ready-to-send response keyed by the query it answers.
+    struct CacheEntry {
+      /// @brief The hash of the query without its ID.
+      uint32_t hash;
+      /// @brief The query length without its ID, 0 if the entry is empty.
+      uint16_t query_len;
+      /// @brief The response length.
+      uint16_t response_len;
+      /// @brief The type of the query.
+      DNSResponder::QueryType type;
+      /// @brief The query without its ID.
+      uint8_t query[CACHE_QUERY_SIZE];
+      /// @brief The response.
+      uint8_t response[CACHE_RESPONSE_SIZE];
+    };
+
     /// @brief The DNS port.
-    int port;
-    /// @brief The DNS server socket.
-    int server_socket;
-    /// @brief The gateway IP address.
-    esp_ip4_addr_t gateway;
-    /// @brief The DNS server task handle.
-    TaskHandle_t task_handle;
+    uint16_t port;
+    /// @brief The DNS server transport.
+    UDPTransport transport;
+    /// @brief The DNS responder.
+    DNSResponder responder;
+    /// @brief The DNS server task.
+    Task task;
+#if CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+    /// @brief The DNS server task stack.
+    uint8_t task_stack[CONFIG_WIFI_CONNECT_DNS_TASK_STACK_SIZE];
+#endif
+    /// @brief Whether the DNS server task should keep running.
+    std::atomic<bool> running;
+    /// @brief The query buffer.
+    uint8_t buffer[DNSResponder::MAX_MESSAGE_SIZE];
+    /// @brief The response buffer.
+    uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+    /// @brief The response cache.
+    CacheEntry cache[CACHE_SIZE];
+    /// @brief The statistics mutex, the task counts under it and getStats() copies under it.
+    mutable std::mutex stats_mutex;
+    /// @brief The statistics, the rate aside.
+    Stats stats;
+    /// @brief The start of the current one-second statistics window in microseconds.
+    int64_t window_start;
+    /// @brief The number of queries received in the current statistics window.
+    uint32_t window_queries;
+    /// @brief The number of queries received in the window before the current one.
+    uint32_t previous_window_queries;
 
     /// @brief The DNS server task.
     void run();
+
+    /// @brief Answer a single query.
+    /// @param query The query message.
+    /// @param query_len The query message length.
+    /// @param response The response buffer of DNSResponder::MAX_MESSAGE_SIZE bytes.
+    /// @param type The type of the query.
+    /// @param cached Whether the response came from the cache.
+    /// @return The response length, or 0 if the query must be dropped.
+    size_t answer(const uint8_t* query, size_t query_len, uint8_t* response, DNSResponder::QueryType& type, bool& cached);
+
+    /// @brief Count a received query in the statistics.
+    /// @param type The type of the query.
+    /// @param cached Whether the response came from the cache.
+    void countQuery(DNSResponder::QueryType type, bool cached);
+
+    /// @brief Move the rate window to the second holding a time. The statistics mutex must be held.
+    /// @param now The time in microseconds.
+    void advanceWindow(int64_t now);
   };
 
 }
@@ -0,0 +1,81 @@
+#ifndef __FORM_PARSER_HH__
+#define __FORM_PARSER_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace wifi_connect {
+
+  /// @brief The streaming application/x-www-form-urlencoded parser.
+  /// The body may be fed in any number of pieces. Values of the known fields are
+  /// decoded straight into caller-provided buffers, other fields are skipped, and
+  /// nothing is ever allocated or written outside the given buffers.
+  class FormParser {
+  public:
+    /// @brief A field to extract.
+    struct Field {
+      /// @brief The field name.
+      std::string_view name;
+      /// @brief The value buffer, always null-terminated.
+      char* value;
+      /// @brief The value buffer size, including the null terminator.
+      size_t size;
+      /// @brief The decoded value length.
+      size_t length;
+      /// @brief Whether the field was found.
+      bool present;
+    };
+
+    /// @brief The longest field name that can be matched.
+    static constexpr size_t MAX_NAME_SIZE = 16;
+
+    /// @brief The constructor.
+    /// @param fields The fields to extract.
+    /// @param count The number of fields.
+    FormParser(Field* fields, size_t count);
+
+    /// @brief Parse the next piece of the body.
+    /// @param data The data.
+    /// @param len The data length.
+    /// @return False once the body is malformed or a value does not fit, true otherwise.
+    bool feed(const char* data, size_t len);
+
+    /// @brief Finish parsing after the last piece.
+    /// @return True if the whole body was well formed, false otherwise.
+    bool finish();
+
+  private:
+    /// @brief The fields to extract.
+    Field* fields;
+    /// @brief The number of fields.
+    size_t count;
+    /// @brief The field whose value is being decoded, or null if it is skipped.
+    Field* current;
+    /// @brief Whether a value is being parsed, false while parsing a name.
+    bool in_value;
+    /// @brief Whether the name being parsed is longer than any field name.
+    bool name_overflow;
+    /// @brief Whether the body is malformed.
+    bool failed;
+    /// @brief The number of hex digits of a percent escape still expected.
+    uint8_t escape_digits;
+    /// @brief The decoded bits of the pending percent escape.
+    uint8_t escape_value;
+    /// @brief The length of the name being parsed.
+    size_t name_len;
+    /// @brief The decoded name being parsed.
+    char name[MAX_NAME_SIZE];
+
+    /// @brief Handle a decoded character.
+    /// @param ch The character.
+    void put(char ch);
+    /// @brief Handle the end of a name.
+    void endName();
+    /// @brief Handle the end of a name or value.
+    void endPair();
+  };
+
+}
+
+#endif // __FORM_PARSER_HH__
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef __JSON_WRITER_HH__
+#define __JSON_WRITER_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wifi_connect {
+
+  /// @brief The streaming JSON writer.
+  /// Output is collected in a caller-provided buffer and handed to the flush
+  /// callback only when the buffer is full or the document is finished.
+  class JsonWriter {
+  public:
+    /// @brief The flush callback.
+    /// @param ctx The user context.
+    /// @param data The data to send.
+    /// @param len The data length.
+    /// @return True if the data was sent, false otherwise.
+    typedef bool (*FlushCallback)(void* ctx, const char* data, size_t len);
+
+    /// @brief The constructor.
+    /// @param buffer The output buffer.
+    /// @param size The output buffer size.
+    /// @param flush The flush callback.
+    /// @param ctx The user context passed to the flush callback.
+    JsonWriter(char* buffer, size_t size, FlushCallback flush, void* ctx);
+
+    /// @brief Begin an array.
+    void beginArray();
+    /// @brief End the current array.
+    void endArray();
+    /// @brief Begin an object.
+    void beginObject();
+    /// @brief End the current object.
+    void endObject();
+
+    /// @brief Write an object key.
+    /// @param name The key.
+    void key(const char* name);
+
+    /// @brief Write a string value.
+    /// @param value The null-terminated string.
+    void string(const char* value);
+    /// @brief Write a string value.
+    /// @param value The string.
+    /// @param len The string length.
+    void string(const char* value, size_t len);
+    /// @brief Write a number value.
+    /// @param value The number.
+    void number(int64_t value);
+    /// @brief Write a boolean value.
+    /// @param value The boolean.
+    void boolean(bool value);
+
+    /// @brief Flush the remaining output.
+    /// @return True if all the output was sent, false otherwise.
+    bool finish();
+
+  private:
+    /// @brief The maximum nesting depth.
+    static constexpr uint8_t MAX_DEPTH = 16;
+
+    /// @brief The output buffer.
+    char* buffer;
+    /// @brief The output buffer size.
+    size_t size;
+    /// @brief The number of buffered bytes.
+    size_t len;
+    /// @brief The flush callback.
+    FlushCallback flush;
+    /// @brief The flush callback user context.
+    void* ctx;
+    /// @brief Whether a flush has failed.
+    bool failed;
+    /// @brief Whether a key was just written.
+    bool after_key;
+    /// @brief The current nesting depth.
+    uint8_t depth;
+    /// @brief One bit per nesting level, set once the level holds a value.
+    uint32_t has_values;
+
+    /// @brief Write the separator needed before a value.
+    void separator();
+    /// @brief Write a character.
+    /// @param ch The character.
+    void put(char ch);
+    /// @brief Write raw characters.
+    /// @param data The characters.
+    /// @param len The number of characters.
+    void raw(const char* data, size_t len);
+    /// @brief Write an escaped string with its quotes.
+    /// @param value The string.
+    /// @param len The string length.
+    void quoted(const char* value, size_t len);
+    /// @brief Send the buffered output.
+    void drain();
+  };
+
+}
+
+#endif // __JSON_WRITER_HH__
\ No newline at end of file
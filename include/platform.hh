@@ -0,0 +1,53 @@
+#ifndef __PLATFORM_HH__
+#define __PLATFORM_HH__
+
+#include <cstdint>
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_netif_ip_addr.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+
+#else
+
+#include <chrono>
+#include <cstdio>
+
+/// @brief The IPv4 address, in network byte order.
+typedef struct {
+  uint32_t addr;
+} esp_ip4_addr_t;
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fprintf(stderr, "I %s: " format "\n", tag, ##__VA_ARGS__)
+
+/// @brief Get the monotonic time since start-up.
+/// @return The time in microseconds.
+static inline int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+#endif // ESP_PLATFORM
+
+// Defaults of the component configuration, for the host and for builds without it.
+#ifndef CONFIG_WIFI_CONNECT_DNS_TASK_STACK_SIZE
+#define CONFIG_WIFI_CONNECT_DNS_TASK_STACK_SIZE     3072
+#define CONFIG_WIFI_CONNECT_DNS_TASK_PRIORITY       5
+#define CONFIG_WIFI_CONNECT_DNS_TASK_CORE           -1
+#define CONFIG_WIFI_CONNECT_WORKER_TASK_STACK_SIZE  4096
+#define CONFIG_WIFI_CONNECT_WORKER_TASK_PRIORITY    5
+#define CONFIG_WIFI_CONNECT_WORKER_TASK_CORE        -1
+#define CONFIG_WIFI_CONNECT_HTTPD_STACK_SIZE        4096
+#define CONFIG_WIFI_CONNECT_HTTPD_PRIORITY          5
+#define CONFIG_WIFI_CONNECT_HTTPD_CORE              -1
+#define CONFIG_WIFI_CONNECT_HTTPD_MAX_SOCKETS       7
+#define CONFIG_WIFI_CONNECT_AP_MAX_CONNECTIONS      4
+#define CONFIG_WIFI_CONNECT_SCAN_MAX_RECORDS        32
+#endif
+
+#endif // __PLATFORM_HH__
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef __RATE_LIMITER_HH__
+#define __RATE_LIMITER_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wifi_connect {
+
+  /// @brief The per-client token bucket limiter.
+  /// Each bucket is kept as the time it will be full again, which is all a token
+  /// bucket needs. Buckets live in a small fixed table; when it is full the
+  /// bucket that has been full the longest is reused.
+  class RateLimiter {
+  public:
+    /// @brief The number of clients tracked at once.
+    static constexpr size_t MAX_CLIENTS = 8;
+
+    /// @brief The constructor.
+    /// @param burst The number of requests allowed at once.
+    /// @param interval_ms The time to earn back one request, in milliseconds.
+    RateLimiter(uint32_t burst, uint32_t interval_ms);
+
+    /// @brief Take a token for a client.
+    /// @param client The client identifier, its IPv4 address, never 0.
+    /// @param now The current time in microseconds.
+    /// @return 0 if the request is allowed, otherwise the time until it would be, in microseconds.
+    int64_t acquire(uint32_t client, int64_t now);
+
+    /// @brief Forget every client.
+    void reset();
+
+  private:
+    /// @brief A client bucket.
+    struct Bucket {
+      /// @brief The client identifier, 0 if the slot is free.
+      uint32_t client;
+      /// @brief The time the bucket is full again, in microseconds.
+      int64_t full_at;
+    };
+
+    /// @brief The time to earn back one request, in microseconds.
+    int64_t interval;
+    /// @brief The time span the bucket holds, in microseconds.
+    int64_t capacity;
+    /// @brief The client buckets.
+    Bucket buckets[MAX_CLIENTS];
+
+    /// @brief Find the bucket of a client, or the one to reuse for it.
+    /// @param client The client identifier.
+    /// @return The bucket.
+    Bucket& find(uint32_t client);
+  };
+
+}
+
+#endif // __RATE_LIMITER_HH__
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef __SCAN_FEED_HH__
+#define __SCAN_FEED_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_wifi.h>
+
+#include "json_writer.hh"
+#include "platform.hh"
+
+namespace wifi_connect {
+
+  /// @brief The list of networks pushed to the provisioning pages, and its changes.
+  /// Networks are keyed by SSID, keeping the strongest access point of each, and
+  /// hidden networks are left out. A signal change smaller than RSSI_STEP is not
+  /// reported, so that the noise of every scan does not turn into updates.
+  class ScanFeed {
+  public:
+    /// @brief The maximum number of networks in the list.
+    static constexpr size_t MAX_ENTRIES = CONFIG_WIFI_CONNECT_SCAN_MAX_RECORDS;
+    /// @brief The smallest signal change reported, in dBm.
+    static constexpr int RSSI_STEP = 3;
+
+    /// @brief The constructor.
+    ScanFeed();
+
+    /// @brief Empty the list.
+    void clear();
+
+    /// @brief Replace the list with the records of a scan and work out the changes.
+    /// @param records The scan records.
+    /// @param count The number of scan records.
+    /// @return True if a network was added, removed or changed, false otherwise.
+    bool update(const wifi_ap_record_t* records, size_t count);
+
+    /// @brief Write the changes of the last update as a JSON object.
+    /// @param writer The writer.
+    void writeDelta(JsonWriter& writer) const;
+
+    /// @brief Write the whole list as a JSON object, in the same form as the changes.
+    /// @param writer The writer.
+    void writeFull(JsonWriter& writer) const;
+
+  private:
+    /// @brief The change of a network in the last update.
+    enum class Change : uint8_t {
+      None,
+      Added,
+      Changed,
+    };
+
+    /// @brief A network of the list.
+    struct Entry {
+      /// @brief The SSID.
+      char ssid[33];
+      /// @brief The signal strength last reported, in dBm.
+      int8_t rssi;
+      /// @brief The authentication mode.
+      uint8_t authmode;
+      /// @brief The change in the last update.
+      Change change;
+    };
+
+    /// @brief The current and the previous lists.
+    Entry lists[2][MAX_ENTRIES];
+    /// @brief The number of networks in each list.
+    size_t counts[2];
+    /// @brief The index of the current list.
+    uint8_t current;
+    /// @brief Whether each network of the previous list was removed in the last update.
+    bool removed[MAX_ENTRIES];
+
+    /// @brief Find a network in a list.
+    /// @param list The list.
+    /// @param count The number of networks in the list.
+    /// @param ssid The SSID.
+    /// @return The index of the network, or count if not found.
+    static size_t find(const Entry* list, size_t count, const char* ssid);
+
+    /// @brief Write a network as a JSON object.
+    /// @param writer The writer.
+    /// @param entry The network.
+    static void writeEntry(JsonWriter& writer, const Entry& entry);
+  };
+
+}
+
+#endif // __SCAN_FEED_HH__
\ No newline at end of file
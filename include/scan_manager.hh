@@ -0,0 +1,156 @@
+#ifndef __SCAN_MANAGER_HH__
+#define __SCAN_MANAGER_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_event.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "platform.hh"
+
+namespace wifi_connect {
+
+  /// @brief The background WiFi scan manager.
+  /// Scans run asynchronously and concurrent requests share a single scan;
+  /// readers are always served the last snapshot at once.
+  /// In progressive mode a scan sweeps one channel at a time, starting with the
+  /// access point channel, and the radio goes back to the access point channel
+  /// between steps. Every step replaces the records of its channel in the
+  /// snapshot, so partial results are published as they arrive.
+  class ScanManager {
+  public:
+    /// @brief The maximum number of access points kept in a snapshot.
+    static constexpr size_t MAX_RECORDS = CONFIG_WIFI_CONNECT_SCAN_MAX_RECORDS;
+    /// @brief The maximum number of channels in a sweep.
+    static constexpr size_t MAX_CHANNELS = 14;
+
+    /// @brief The callback notified of a new snapshot, from the event loop task.
+    /// It is called with the snapshot locked and must not call back into the manager.
+    typedef void (*SnapshotCallback)(void* ctx);
+
+    /// @brief The constructor.
+    ScanManager();
+    /// @brief The destructor.
+    ~ScanManager();
+
+    /// @brief Set how long a snapshot is considered fresh.
+    /// A request for an older snapshot starts a new scan in the background.
+    /// @param ttl_ms The time to live in milliseconds.
+    void setTTL(uint32_t ttl_ms);
+
+    /// @brief Set the period of unconditional background scans.
+    /// @param period_ms The period in milliseconds, 0 to scan only on request.
+    void setPeriod(uint32_t period_ms);
+
+    /// @brief Set whether scans sweep one channel at a time.
+    /// @param progressive Whether to scan progressively, true by default.
+    void setProgressive(bool progressive);
+
+    /// @brief Set the callback notified of every new snapshot.
+    /// Once this returns, the previous callback is no longer running.
+    /// @param callback The callback, or null for none.
+    /// @param ctx The user argument passed to the callback.
+    void setSnapshotCallback(SnapshotCallback callback, void* ctx);
+
+    /// @brief Start the scan manager and the first scan.
+    void start();
+
+    /// @brief Stop the scan manager.
+    void stop();
+
+    /// @brief Abort the running scan and hold back new ones, e.g. while connecting.
+    void pause();
+
+    /// @brief Allow scans again after pause().
+    void resume();
+
+    /// @brief Request a fresh snapshot.
+    /// Starts a scan unless the snapshot is still fresh or a scan is already running.
+    void request();
+
+    /// @brief Read the last snapshot.
+    /// The snapshot is locked while the reader runs, so the reader must not block.
+    /// @param reader The reader, called with the records, their count and the snapshot age in milliseconds.
+    template <typename Reader>
+    void read(Reader&& reader) {
+      xSemaphoreTake(mutex, portMAX_DELAY);
+      int64_t age_ms = snapshot_time > 0 ? (esp_timer_get_time() - snapshot_time) / 1000 : -1;
+      reader(static_cast<const wifi_ap_record_t*>(records), record_count, age_ms);
+      xSemaphoreGive(mutex);
+    }
+
+    /// @brief Copy the last snapshot, for readers that block, e.g. on a socket.
+    /// @param records The records to fill.
+    /// @param size The maximum number of records.
+    /// @param age_ms The snapshot age in milliseconds, -1 if none.
+    /// @return The number of records copied.
+    size_t copy(wifi_ap_record_t* records, size_t size, int64_t& age_ms);
+
+  private:
+    /// @brief The snapshot mutex.
+    SemaphoreHandle_t mutex;
+    /// @brief The periodic scan timer.
+    esp_timer_handle_t timer;
+    /// @brief The timer starting the next step of a sweep.
+    esp_timer_handle_t step_timer;
+    /// @brief The scan done event handler.
+    esp_event_handler_instance_t scan_done_handler;
+    /// @brief The snapshot records.
+    wifi_ap_record_t records[MAX_RECORDS];
+    /// @brief The number of snapshot records.
+    size_t record_count;
+    /// @brief The time the snapshot was taken in microseconds, 0 if none.
+    int64_t snapshot_time;
+    /// @brief Whether a scan started by the manager is running.
+    bool scanning;
+    /// @brief Whether scans are held back.
+    bool paused;
+    /// @brief The snapshot time to live in milliseconds.
+    uint32_t ttl_ms;
+    /// @brief The background scan period in milliseconds.
+    uint32_t period_ms;
+    /// @brief Whether scans sweep one channel at a time.
+    bool progressive;
+    /// @brief The channels of the sweep, in scan order.
+    uint8_t channels[MAX_CHANNELS];
+    /// @brief The number of channels of the sweep.
+    size_t channel_count;
+    /// @brief The index of the channel being scanned.
+    size_t channel_index;
+    /// @brief The time the sweep started in microseconds.
+    int64_t sweep_start;
+    /// @brief The new snapshot callback.
+    SnapshotCallback snapshot_callback;
+    /// @brief The user argument of the new snapshot callback.
+    void* snapshot_ctx;
+
+    /// @brief Start a scan unless one is already running.
+    void startScan();
+
+    /// @brief Plan the channels of a sweep. The mutex must be held.
+    void planSweep();
+
+    /// @brief Start scanning the current channel of the sweep. The mutex must be held.
+    /// @return The result of starting the scan.
+    esp_err_t startStep();
+
+    /// @brief Replace the snapshot records of a channel with the results of its step. The mutex must be held.
+    /// @param channel The channel.
+    void mergeStep(uint8_t channel);
+
+    /// @brief The scan done event handler.
+    /// @param arg The user argument.
+    /// @param event_base The event object.
+    /// @param event_id The event id.
+    /// @param event_data The event data.
+    static void scanDoneEventHandler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
+  };
+
+}
+
+#endif // __SCAN_MANAGER_HH__
\ No newline at end of file
@@ -0,0 +1,163 @@
+#ifndef __TRANSPORT_HH__
+#define __TRANSPORT_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "platform.hh"
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace wifi_connect {
+
+  /// @brief The address of a datagram peer.
+  struct UDPEndpoint {
+    /// @brief The IPv4 address in network byte order.
+    uint32_t address;
+    /// @brief The port in network byte order.
+    uint16_t port;
+  };
+
+  /// @brief The UDP socket transport.
+  /// Backed by lwIP sockets on the device and by POSIX sockets on the host.
+  class UDPTransport {
+  public:
+    /// @brief The constructor.
+    UDPTransport();
+    /// @brief The destructor.
+    ~UDPTransport();
+
+    /// @brief Open the socket and bind it to all interfaces.
+    /// @param port The local port, or 0 for an ephemeral port.
+    /// @return True if the socket was opened, false otherwise.
+    bool open(uint16_t port);
+
+    /// @brief Close the socket.
+    void close();
+
+    /// @brief Check whether the socket is open.
+    /// @return True if the socket is open, false otherwise.
+    bool isOpen() const;
+
+    /// @brief Get the local port the socket is bound to.
+    /// @return The local port in host byte order, or 0 if the socket is not open.
+    uint16_t getLocalPort() const;
+
+    /// @brief Wait until a datagram can be received.
+    /// @param timeout_ms The maximum time to wait in milliseconds.
+    /// @return 1 if a datagram is pending, 0 on timeout, or -1 on error.
+    int poll(uint32_t timeout_ms);
+
+    /// @brief Receive a datagram.
+    /// @param buffer The receive buffer.
+    /// @param size The receive buffer size.
+    /// @param from The sender address.
+    /// @param wait Whether to block until a datagram arrives.
+    /// @return The datagram length, 0 if nothing is pending and wait is false, or -1 on error.
+    int receive(uint8_t* buffer, size_t size, UDPEndpoint& from, bool wait);
+
+    /// @brief Send a datagram.
+    /// @param data The datagram.
+    /// @param len The datagram length.
+    /// @param to The destination address.
+    /// @return True if the datagram was sent, false otherwise.
+    bool send(const uint8_t* data, size_t len, const UDPEndpoint& to);
+
+  private:
+    /// @brief The socket.
+    int fd;
+  };
+
+  /// @brief The background task.
+  /// Backed by a FreeRTOS task on the device and by std::thread on the host.
+  /// With CONFIG_WIFI_CONNECT_STATIC_ALLOCATION the task runs on a stack given by the owner.
+  /// The entry function must return once asked to by its owner; the task is only
+  /// deleted after that, never in the middle of a call. A task that does not return
+  /// in time is left running, and keeps its stack, until a later stop() sees it return.
+  /// Both backends behave the same, the host one only joins a thread that returned.
+  class Task {
+  public:
+    /// @brief The task entry function.
+    typedef void (*Entry)(void* arg);
+
+    /// @brief The longest time the destructor waits for the entry function to return.
+    static constexpr uint32_t DESTROY_TIMEOUT_MS = 2000;
+
+    /// @brief The constructor.
+    Task();
+    /// @brief The destructor.
+    /// Waits up to DESTROY_TIMEOUT_MS for the entry function, and aborts if it is still
+    /// running, as it would go on with its owner freed.
+    ~Task();
+
+    /// @brief Start the task, unless it is still running.
+    /// @param name The task name.
+    /// @param stack_size The stack size in bytes, ignored on the host.
+    /// @param priority The priority, ignored on the host.
+    /// @param core The core the task is pinned to, -1 for no affinity, ignored on the host.
+    /// @param entry The entry function.
+    /// @param arg The entry function argument.
+    /// @param stack The stack of stack_size bytes for a statically allocated task, or null.
+    /// @return True if the task was started, false otherwise.
+    bool start(const char* name, uint32_t stack_size, unsigned priority, int core, Entry entry, void* arg, uint8_t* stack = nullptr);
+
+    /// @brief Wait for the entry function to return and release the task.
+    /// @param timeout_ms The maximum time to wait.
+    /// @return True if the entry function returned in time, false if the task is still running.
+    bool stop(uint32_t timeout_ms);
+
+    /// @brief Check whether the task is running.
+    /// @return True if the task is running, false otherwise.
+    bool isRunning() const;
+
+    /// @brief Get the minimum free stack space since the task started.
+    /// @return The stack high-water mark in bytes, 0 if not running or on the host.
+    size_t getStackHighWaterMark() const;
+
+  private:
+#ifdef ESP_PLATFORM
+    /// @brief The task handle.
+    TaskHandle_t handle;
+    /// @brief The task control block of a statically allocated task.
+    StaticTask_t tcb;
+    /// @brief The semaphore given once the entry function returned.
+    SemaphoreHandle_t done;
+    /// @brief The storage of the done semaphore.
+    StaticSemaphore_t done_buffer;
+    /// @brief The entry function.
+    Entry entry;
+    /// @brief The entry function argument.
+    void* arg;
+
+    /// @brief Run the entry function, signal its end and wait to be deleted.
+    /// @param task The task.
+    static void trampoline(void* task);
+#else
+    /// @brief The thread.
+    std::thread thread;
+    /// @brief The mutex of the done flag.
+    std::mutex mutex;
+    /// @brief The condition notified once the entry function returned.
+    std::condition_variable done_condition;
+    /// @brief Whether the entry function returned.
+    bool done;
+
+    /// @brief Run the entry function and signal its end.
+    /// @param task The task.
+    /// @param entry The entry function.
+    /// @param arg The entry function argument.
+    static void trampoline(Task* task, Entry entry, void* arg);
+#endif
+  };
+
+}
+
+#endif // __TRANSPORT_HH__
\ No newline at end of file
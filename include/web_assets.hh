@@ -0,0 +1,34 @@
+#ifndef __WEB_ASSETS_HH__
+#define __WEB_ASSETS_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wifi_connect {
+
+  /// @brief The static web asset, generated at build time by tools/gen_web_assets.py.
+  struct WebAsset {
+    /// @brief The asset content.
+    const uint8_t* data;
+    /// @brief The asset content length.
+    size_t size;
+    /// @brief The gzip-compressed asset content.
+    const uint8_t* gzip_data;
+    /// @brief The gzip-compressed asset content length.
+    size_t gzip_size;
+    /// @brief The quoted entity tag of the content.
+    const char* etag;
+    /// @brief The quoted entity tag of the gzip-compressed content, a different representation.
+    const char* gzip_etag;
+    /// @brief The content type.
+    const char* content_type;
+  };
+
+  /// @brief The provisioning page.
+  extern const WebAsset index_html_asset;
+  /// @brief The page shown after a successful provisioning.
+  extern const WebAsset done_html_asset;
+
+}
+
+#endif // __WEB_ASSETS_HH__
\ No newline at end of file
@@ -1,12 +1,22 @@
 #ifndef __CONFIGURATOR_HH__
 #define __CONFIGURATOR_HH__
 
+#include <atomic>
 #include <string>
 
 #include <esp_event.h>
 #include <esp_http_server.h>
+#include <esp_timer.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "connection_stats.hh"
 #include "dns_server.hh"
+#include "rate_limiter.hh"
+#include "scan_feed.hh"
+#include "scan_manager.hh"
+#include "web_assets.hh"
 
 namespace wifi_connect {
 
@@ -33,49 +43,423 @@ namespace wifi_connect {
     /// @return The web server URL.
     std::string getWebServerUrl() const;
 
+    /// @brief Set the IPv6 address the captive-portal DNS server gives for AAAA queries.
+    /// By default AAAA queries get an empty answer, as the access point only serves IPv4.
+    /// @param address The 16-byte IPv6 address, or null for none.
+    void setDNSAddress6(const uint8_t* address);
+
+    /// @brief Set how long scan results are served before a new scan is started.
+    /// @param ttl_ms The time to live in milliseconds.
+    void setScanTTL(uint32_t ttl_ms);
+
+    /// @brief Set the period of background scans while the configuration process runs.
+    /// @param period_ms The period in milliseconds, 0 to scan only when results are requested.
+    void setScanPeriod(uint32_t period_ms);
+
+    /// @brief Set whether scans sweep one channel at a time, publishing the results of each.
+    /// The radio returns to the access point channel between channels, so connected phones keep their link.
+    /// @param progressive Whether to scan progressively, true by default.
+    void setScanProgressive(bool progressive);
+
+    /// @brief The memory used by the configuration process.
+    struct MemoryStats {
+      /// @brief The free heap when the configuration process started, in bytes.
+      size_t heap_free_at_start;
+      /// @brief The peak heap use since the configuration process started, in bytes.
+      size_t heap_peak_used;
+      /// @brief The minimum free stack of the DNS server task, in bytes.
+      size_t dns_stack_free;
+      /// @brief The minimum free stack of the web server task, in bytes.
+      size_t httpd_stack_free;
+    };
+
+    /// @brief The milestones of the provisioning, from a phone joining the access point to the device getting an IP address.
+    /// The times are in microseconds since start(), 0 if not reached yet.
+    struct ProvisioningTimeline {
+      /// @brief The first station joined the access point.
+      int64_t station_joined_us;
+      /// @brief The first DNS query was answered.
+      int64_t dns_query_us;
+      /// @brief The first captive portal detection request was redirected.
+      int64_t probe_redirected_us;
+      /// @brief The captive portal API was first queried.
+      int64_t portal_api_us;
+      /// @brief The provisioning page was first served.
+      int64_t page_served_us;
+      /// @brief The scan results were first served.
+      int64_t scan_served_us;
+      /// @brief The last credentials were submitted.
+      int64_t submitted_us;
+      /// @brief The device got an IP address.
+      int64_t connected_us;
+      /// @brief The number of DNS queries.
+      uint32_t dns_queries;
+      /// @brief The number of HTTP requests.
+      uint32_t http_requests;
+      /// @brief The number of scan updates pushed to the pages.
+      uint32_t scan_events;
+      /// @brief The number of captive portal detection requests redirected.
+      uint32_t probe_redirects;
+      /// @brief The number of captive portal API requests.
+      uint32_t portal_api_requests;
+      /// @brief The number of credentials submitted.
+      uint32_t submits;
+    };
+
+    /// @brief The web server admission counters.
+    struct AdmissionStats {
+      /// @brief The number of sessions opened.
+      uint32_t sessions_opened;
+      /// @brief The number of requests refused by the per-client rate limits.
+      uint32_t throttled;
+      /// @brief The number of idle sessions closed.
+      uint32_t evicted;
+    };
+
+    /// @brief The callback called once the connection was handed off to the Connector.
+    typedef void (*HandOffCallback)(void* ctx);
+
+    /// @brief Hand the connection off to the Connector instead of restarting after a successful configuration.
+    /// The web server, the DNS server and the access point are stopped, and the station
+    /// connection and its IP address are kept.
+    /// @param enable Whether to hand the connection off.
+    /// @param callback The callback called once the Connector manages the connection, from a dedicated task.
+    /// @param ctx The user argument passed to the callback.
+    void setHandOff(bool enable, HandOffCallback callback = nullptr, void* ctx = nullptr);
+
     /// @brief Start the configuration process.
     void start();
 
     /// @brief Stop the configuration process.
+    /// The WiFi driver and the station interface are torn down too, unless the
+    /// connection was handed off to the Connector, which then owns them.
     void stop();
 
+    /// @brief Get the captive-portal DNS server statistics.
+    /// @return The DNS server statistics.
+    DNSServer::Stats getDNSStats() const;
+
+    /// @brief Get the per-phase timing of the connections tried from the provisioning page.
+    /// @return The connection statistics.
+    const ConnectionStats& getConnectionStats() const;
+
+    /// @brief Get the provisioning milestones and request counts.
+    /// The same figures are logged as one JSON line once the device gets an IP address.
+    /// @return The provisioning timeline.
+    ProvisioningTimeline getProvisioningTimeline() const;
+
+    /// @brief Get the web server admission counters.
+    /// @return The admission counters.
+    AdmissionStats getAdmissionStats() const;
+
+    /// @brief Get the peak heap use and the stack high-water marks of the configuration process.
+    /// @return The memory statistics.
+    MemoryStats getMemoryStats() const;
+
   private:
+    /// @brief The state of the connection started from the provisioning page.
+    enum class ConnectState {
+      Idle,
+      Connecting,
+      ObtainingIP,
+      Connected,
+      Failed,
+    };
+
+    /// @brief The maximum number of status requests waiting for a change.
+    /// Further long polls are refused with 503 Service Unavailable and Retry-After.
+    static constexpr size_t MAX_STATUS_WAITERS = 4;
+
+    /// @brief The connection states a transition may start from, one bit per state.
+    static constexpr uint32_t ANY_CONNECT_STATE = UINT32_MAX;
+    /// @brief The connection states of a job still in progress.
+    static constexpr uint32_t PENDING_CONNECT_STATES =
+      (1u << static_cast<int>(ConnectState::Connecting)) | (1u << static_cast<int>(ConnectState::ObtainingIP));
+
+    /// @brief The maximum number of pages subscribed to the scan updates.
+    static constexpr size_t MAX_SCAN_SUBSCRIBERS = 4;
+
+    /// @brief The maximum number of web server sessions.
+    static constexpr size_t MAX_SESSIONS = CONFIG_WIFI_CONNECT_HTTPD_MAX_SOCKETS;
+
+    /// @brief The rate limit key shared by the clients whose address is unknown, the broadcast address no peer has.
+    static constexpr uint32_t UNKNOWN_CLIENT = UINT32_MAX;
+
+    /// @brief A web server session.
+    struct Session {
+      /// @brief The socket, -1 if the slot is free.
+      int fd;
+      /// @brief The client IPv4 address.
+      uint32_t client;
+      /// @brief The time of the last request, in microseconds.
+      int64_t last_active;
+    };
+
+    /// @brief The provisioning timeline as recorded from the web server task and the event loop, read from any task.
+    /// The times are in microseconds since start(), 0 if not reached yet.
+    struct TimelineRecord {
+      /// @brief The first station joined the access point.
+      std::atomic<int64_t> station_joined_us;
+      /// @brief The first captive portal detection request was redirected.
+      std::atomic<int64_t> probe_redirected_us;
+      /// @brief The captive portal API was first queried.
+      std::atomic<int64_t> portal_api_us;
+      /// @brief The provisioning page was first served.
+      std::atomic<int64_t> page_served_us;
+      /// @brief The scan results were first served.
+      std::atomic<int64_t> scan_served_us;
+      /// @brief The last credentials were submitted.
+      std::atomic<int64_t> submitted_us;
+      /// @brief The device got an IP address.
+      std::atomic<int64_t> connected_us;
+      /// @brief The number of HTTP requests.
+      std::atomic<uint32_t> http_requests;
+      /// @brief The number of scan updates pushed to the pages.
+      std::atomic<uint32_t> scan_events;
+      /// @brief The number of captive portal detection requests redirected.
+      std::atomic<uint32_t> probe_redirects;
+      /// @brief The number of captive portal API requests.
+      std::atomic<uint32_t> portal_api_requests;
+      /// @brief The number of credentials submitted.
+      std::atomic<uint32_t> submits;
+    };
+
+    /// @brief The web server admission counters, updated from the web server task and read from any.
+    struct AdmissionCounters {
+      /// @brief The number of sessions opened.
+      std::atomic<uint32_t> sessions_opened;
+      /// @brief The number of requests refused by the per-client rate limits.
+      std::atomic<uint32_t> throttled;
+      /// @brief The number of idle sessions closed.
+      std::atomic<uint32_t> evicted;
+    };
+
+    /// @brief The connection state sent to the status requests, copied under the job mutex.
+    struct ConnectStatus {
+      /// @brief The sequence number of the state.
+      uint32_t seq;
+      /// @brief The state.
+      ConnectState state;
+      /// @brief The disconnect reason of a failure.
+      uint16_t reason;
+      /// @brief The IP address once connected.
+      char ip[16];
+    };
+
+    /// @brief A status request waiting for the connection state to change.
+    struct StatusWaiter {
+      /// @brief The detached request, null if the slot is free.
+      httpd_req_t *req;
+      /// @brief The time the request is answered anyway, in microseconds.
+      int64_t deadline;
+    };
+
     /// @brief The constructor.
     Configurator();
     /// @brief The destructor.
     ~Configurator();
 
+    /// @brief Stop the timers, the servers, the scans and the event handlers, leaving the WiFi driver running.
+    void stopServices();
+
+    /// @brief Stop everything but the station and pass its connection to the Connector.
+    void handOff();
+
+    /// @brief Start the task restarting the device or handing the connection off.
+    /// The task deletes itself when done.
+    /// @param entry The entry function, called with this.
+    /// @param name The task name.
+    void startWorker(void (*entry)(void*), const char* name);
+
     /// @brief Start the access point.
     void startAP();
 
     /// @brief Start the web server.
     void startWebServer();
 
-    /// @brief Connect to the WiFi.
+    /// @brief Start connecting to the WiFi in the background.
+    /// An attempt still in progress or connected is ended first, and its disconnect
+    /// event waited for, so that it does not fail the new one.
     /// @param ssid The SSID.
     /// @param password The password.
-    /// @return True if the connection was successful, false otherwise.
-    bool connectToWifi(const char* ssid, const char* password);
+    /// @return The sequence number of the new connection state.
+    uint32_t startConnectJob(const char* ssid, const char* password);
+
+    /// @brief Update the connection state and answer the waiting status requests.
+    /// The state is checked and changed at once, so that only one of the events
+    /// racing to end a job, e.g. the timeout and Got-IP, completes it.
+    /// @param state The new state.
+    /// @param reason The disconnect reason for a failure, 0 for a timeout.
+    /// @param from The states the transition may start from, one bit per state.
+    /// @param ip The IP address obtained, for the Connected state.
+    /// @return True if the state changed, false if the current state is not in from.
+    bool setConnectState(ConnectState state, uint16_t reason, uint32_t from = ANY_CONNECT_STATE, const char* ip = nullptr);
+
+    /// @brief Answer the status requests that waited too long, or all of them.
+    /// @param all Whether to answer all of them, e.g. before the web server stops.
+    void releaseStatusWaiters(bool all);
+
+    /// @brief Get the connection state. The job mutex must be held.
+    /// @return The connection state.
+    ConnectStatus getConnectStatus() const;
+
+    /// @brief Send the connection state as JSON, without holding the job mutex.
+    /// @param req The request.
+    /// @param status The connection state.
+    static void sendConnectStatus(httpd_req_t *req, const ConnectStatus& status);
+
+    /// @brief Send the connection state to the detached status requests and release them.
+    /// @param reqs The requests, null entries are skipped.
+    /// @param count The number of requests.
+    /// @param status The connection state.
+    static void completeStatusWaiters(httpd_req_t** reqs, size_t count, const ConnectStatus& status);
+
+    /// @brief Count a request, refresh its session and apply a rate limit.
+    /// A refused request is answered with 429 Too Many Requests. A request without a
+    /// session, e.g. when the open callback found the table full, is limited by its peer address.
+    /// @param req The request.
+    /// @param limiter The rate limit of the endpoint, or null for none.
+    /// @return True if the request may be served, false if it was refused.
+    bool admit(httpd_req_t *req, RateLimiter* limiter);
+
+    /// @brief Close the sessions idle for too long, from the web server task.
+    void evictIdleSessions();
+
+    /// @brief Update the network list from the last snapshot and push the changes, from the web server task.
+    void publishScan();
+
+    /// @brief Keep the scan subscribers alive and the snapshot fresh while there are any, from the web server task.
+    void serviceScanSubscribers();
+
+    /// @brief Send the network list or its last changes as a server-sent event. The scan mutex must be held.
+    /// @param req The detached subscriber request.
+    /// @param full Whether to send the whole list.
+    /// @return True if the event was sent, false if the subscriber is gone.
+    bool sendScanEvent(httpd_req_t *req, bool full);
+
+    /// @brief The new scan snapshot callback, queueing publishScan() on the web server task.
+    /// @param ctx The configurator.
+    static void onScanSnapshot(void* ctx);
+
+    /// @brief The web server session open callback.
+    /// @param handle The web server.
+    /// @param fd The socket.
+    /// @return ESP_OK to accept the session.
+    static esp_err_t onSessionOpen(httpd_handle_t handle, int fd);
+
+    /// @brief Get the rate limit key of a client, its IPv4 address, even on an IPv6 socket.
+    /// @param fd The socket.
+    /// @return The key, UNKNOWN_CLIENT if the peer address cannot be read.
+    static uint32_t getClient(int fd);
+
+    /// @brief The web server session close callback, closing the socket.
+    /// @param handle The web server.
+    /// @param fd The socket.
+    static void onSessionClose(httpd_handle_t handle, int fd);
+
+    /// @brief Record the time of a milestone unless already reached.
+    /// @param step The milestone.
+    void markStep(std::atomic<int64_t>& step);
+
+    /// @brief Log the provisioning timeline as one JSON line.
+    void logProvisioningReport();
+
+    /// @brief Get the name of a connection state.
+    /// @param state The state.
+    /// @return The name.
+    static const char* getConnectStateName(ConnectState state);
 
     /// @brief The access point SSID.
     std::string ap_ssid_prefix;
     /// @brief The access point IP.
     std::string ap_ip;
-    /// @brief The WiFi event group.
-    EventGroupHandle_t event_group;
+    /// @brief The location the captive portal detection requests are redirected to.
+    char redirect_location[32];
+    /// @brief The captive portal API URI advertised by DHCP, which keeps a pointer to it.
+    char portal_api_uri[48];
     /// @brief The any id event handler.
     esp_event_handler_instance_t any_id_handler;
     /// @brief The got ip event handler.
     esp_event_handler_instance_t got_ip_handler;
     /// @brief The DNS server.
     DNSServer dns_server;
+    /// @brief The scan manager.
+    ScanManager scan_manager;
     /// @brief The web server.
     httpd_handle_t web_server;
+    /// @brief The connection job mutex.
+    SemaphoreHandle_t job_mutex;
+    /// @brief The connection job state.
+    ConnectState job_state;
+    /// @brief The disconnect reason of a failed connection job.
+    uint16_t job_reason;
+    /// @brief The sequence number of the connection job state, bumped on every change.
+    uint32_t job_seq;
+    /// @brief The IP address obtained by the connection job.
+    char job_ip[16];
+    /// @brief The connection job timeout timer.
+    esp_timer_handle_t job_timer;
+    /// @brief Whether the attempt of the previous job is being ended, its disconnect event is then not a failure.
+    bool job_aborting;
+    /// @brief The semaphore given by the disconnect event of an attempt being ended.
+    SemaphoreHandle_t job_disconnected;
+    /// @brief The timer answering expired status requests.
+    esp_timer_handle_t status_timer;
+    /// @brief The status requests waiting for a change.
+    StatusWaiter status_waiters[MAX_STATUS_WAITERS];
+    /// @brief The scan subscribers mutex.
+    SemaphoreHandle_t scan_mutex;
+    /// @brief The detached scan update requests, null if the slot is free.
+    httpd_req_t *scan_subscribers[MAX_SCAN_SUBSCRIBERS];
+    /// @brief The time of the last keep-alive sent to the scan subscribers, in microseconds.
+    int64_t scan_keepalive;
+    /// @brief The network list pushed to the scan subscribers.
+    ScanFeed scan_feed;
+    /// @brief The copy of the scan snapshot sent by /scan, owned by the web server task.
+    wifi_ap_record_t scan_records[ScanManager::MAX_RECORDS];
+    /// @brief The connection statistics.
+    ConnectionStats stats;
+    /// @brief The web server sessions.
+    Session sessions[MAX_SESSIONS];
+    /// @brief The rate limit of the scan results.
+    RateLimiter scan_limiter;
+    /// @brief The rate limit of the form submissions.
+    RateLimiter submit_limiter;
+    /// @brief The web server admission counters.
+    AdmissionCounters admission_counters;
+    /// @brief The time the configuration process started, in microseconds.
+    int64_t start_time;
+    /// @brief The provisioning timeline.
+    TimelineRecord timeline;
+    /// @brief Whether the connection is handed off to the Connector instead of restarting.
+    bool hand_off;
+    /// @brief The callback called after the hand-off.
+    HandOffCallback hand_off_callback;
+    /// @brief The user argument of the hand-off callback.
+    void* hand_off_ctx;
+    /// @brief Whether the connection was handed off, so the driver belongs to the Connector.
+    bool handed_off;
+    /// @brief The free heap when the configuration process started.
+    size_t heap_free_at_start;
+    /// @brief Whether the restart or hand-off task was started.
+    bool worker_started;
+#if CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+    /// @brief The control block of the restart and hand-off task.
+    StaticTask_t worker_tcb;
+    /// @brief The stack of the restart and hand-off task.
+    StackType_t worker_stack[CONFIG_WIFI_CONNECT_WORKER_TASK_STACK_SIZE / sizeof(StackType_t)];
+#endif
+
+    /// @brief Send a static web asset, compressed and revalidated when the client allows it.
+    /// @param req The request.
+    /// @param asset The asset.
+    /// @return The result of sending the response.
+    static esp_err_t sendAsset(httpd_req_t *req, const WebAsset& asset);
 
-    /// @brief Decode the URL.
-    /// @param url The URL to decode.
-    /// @return The decoded URL.
-    static std::string urlDecode(const std::string &url);
+    /// @brief Check whether an Accept-Encoding header allows gzip, honouring the quality values.
+    /// @param accept_encoding The header value.
+    /// @return True if gzip is accepted, false if it is not listed or has a quality of 0.
+    static bool isGzipAccepted(const char* accept_encoding);
 
     /// @brief The WiFi event handler.
     /// @param arg The user argument.
@@ -4,30 +4,173 @@
 #include <string>
 
 #include <esp_event.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "connection_stats.hh"
+#include "credential_store.hh"
+#include "platform.hh"
+
 namespace wifi_connect {
 
   /// @brief The WiFi connector.
   class Connector {
   public:
+    /// @brief The way a connection was established.
+    enum class ConnectPath {
+      /// @brief No connection was established.
+      None,
+      /// @brief Direct association with the cached BSSID on its channel.
+      Fast,
+      /// @brief Association with the best known network found by a single scan.
+      Ranked,
+      /// @brief Association after a full all-channel scan.
+      Full,
+    };
+
+    /// @brief The outcome of the last connection attempt.
+    struct ConnectResult {
+      /// @brief Whether the connection was successful.
+      bool success;
+      /// @brief The way the connection was established.
+      ConnectPath path;
+      /// @brief The time from the start of connect() to the IP address, in microseconds.
+      int64_t duration_us;
+    };
+
+    /// @brief The state of the station link.
+    enum class LinkState {
+      /// @brief Not connected, and no reconnection is pending.
+      Down,
+      /// @brief Connected with an IP address.
+      Up,
+      /// @brief The link was lost and a reconnection is pending.
+      Reconnecting,
+    };
+
+    /// @brief The automatic reconnection policy.
+    struct ReconnectPolicy {
+      /// @brief Whether the link is restored automatically once connect() succeeded.
+      bool enabled;
+      /// @brief The delay before the first reconnection after a transient loss, in milliseconds.
+      uint32_t fast_delay_ms;
+      /// @brief The number of reconnections using the fast delay after a transient loss.
+      uint8_t fast_attempts;
+      /// @brief The base delay of the exponential backoff, in milliseconds.
+      uint32_t initial_delay_ms;
+      /// @brief The cap of the exponential backoff, in milliseconds.
+      uint32_t max_delay_ms;
+      /// @brief The number of reconnections before giving up, 0 to never give up.
+      uint32_t max_attempts;
+    };
+
+    /// @brief The cost of bringing up the WiFi driver at boot, to compare firmware versions.
+    struct StartupTiming {
+      /// @brief The duration of the last isStored() call, in microseconds.
+      int64_t is_stored_us;
+      /// @brief The duration of the last driver initialisation, in microseconds.
+      int64_t driver_init_us;
+      /// @brief The number of driver initialisations since boot, 1 when isStored() and connect() share one.
+      uint32_t driver_inits;
+    };
+
+    /// @brief The callback notified of link state changes, from the event loop task.
+    typedef void (*LinkStateCallback)(void* ctx, LinkState state);
+
+    /// @brief The maximum number of link state subscribers.
+    static constexpr size_t MAX_SUBSCRIBERS = 4;
+
     /// @brief Get the instance of the connector.
     /// @return The instance of the connector.
     static Connector& getInstance();
 
     /// @brief Check if the WiFi connection information is stored.
+    /// The driver configuration is the source of truth, so that esp_wifi_restore()
+    /// unprovisions the device: the networks added with addNetwork() do not count on
+    /// their own, although connect() still tries them. A driver that never stored
+    /// anything is found out from NVS alone. Otherwise the driver is brought up to read
+    /// its configuration, and left initialised for connect() if a network is found.
     /// @return True if the information is stored, false otherwise.
     bool isStored();
 
     /// @brief Connect to the WiFi.
     /// Any the SSID and password can be null.
-    /// In this case, the connector will try to connect to the last known network.
+    /// In this case, the connector will try to connect to the last known network,
+    /// then to the best of the networks added with addNetwork().
+    /// A given SSID and password are added to the known networks, and only that network
+    /// is tried. The same holds for the network stored in the driver configuration when
+    /// it was changed since the last connection, e.g. by the Configurator.
     /// @param auth_mode The authentication mode.
     /// @param ssid The SSID.
     /// @param password The password.
     /// @return True if the connection was successful, false otherwise.
     bool connect(wifi_auth_mode_t auth_mode, const char* ssid = nullptr, const char* password = nullptr);
 
+    /// @brief Take over a station connection established by someone else, the Configurator.
+    /// The connection is kept as is and managed from then on as if connect() made it.
+    /// @return True if there was a connection with an IP address to adopt, false otherwise.
+    bool adopt();
+
+    /// @brief Add a network to the known networks, or update it.
+    /// The cached access point is dropped, so that the next connect() without an SSID
+    /// sticks to the network stored in the driver configuration.
+    /// @param ssid The SSID.
+    /// @param password The password.
+    /// @param auth_mode The minimum authentication mode accepted.
+    /// @param priority The priority, higher is preferred at equal signal strength.
+    void addNetwork(const char* ssid, const char* password, wifi_auth_mode_t auth_mode = WIFI_AUTH_OPEN, int8_t priority = 0);
+
+    /// @brief Get the minimum authentication mode to accept for a network joined with the given one.
+    /// Mixed modes map to their weaker part, so that the network can still be joined in either mode.
+    /// @param joined The authentication mode of the access point joined.
+    /// @return The authentication mode threshold.
+    static wifi_auth_mode_t getThresholdAuthMode(wifi_auth_mode_t joined);
+
+    /// @brief Remove a network from the known networks.
+    /// @param ssid The SSID.
+    /// @return True if the network was known, false otherwise.
+    bool removeNetwork(const char* ssid);
+
+    /// @brief Enable reuse of the last DHCP lease.
+    /// When enabled, a lease that is still valid is applied as soon as the link
+    /// is up instead of waiting for a DHCP exchange, and renewed in the background
+    /// once half of the lease time granted by the server has passed. Validity relies
+    /// on the system time, so a lease is only cached and reused once the clock is set,
+    /// e.g. by SNTP; the clock survives deep sleep. The lease applies to whichever
+    /// network connect() settles on. The address is probed with ARP once the link is
+    /// up, and DHCP takes over if another host answers for it. The probe follows
+    /// RFC 5227 when lwIP address conflict detection is enabled (CONFIG_LWIP_DHCP_DOES_ACD_CHECK);
+    /// otherwise it is best-effort, asking for the address from the address itself.
+    /// @param enable Whether to reuse the lease.
+    /// @param lease_time_s The lifetime assumed when the server did not grant one, in seconds.
+    void setLeaseReuse(bool enable, uint32_t lease_time_s = 3600);
+
+    /// @brief Set the automatic reconnection policy.
+    /// Reconnections are driven by the WiFi events and a one-shot timer. The delay
+    /// doubles on every failed attempt up to the cap and is randomised over its upper
+    /// half, so that devices losing the same access point do not retry in step.
+    /// A reconnection that associates but gets no IP address in time counts as failed.
+    /// @param policy The policy.
+    void setReconnectPolicy(const ReconnectPolicy& policy);
+
+    /// @brief Subscribe to link state changes.
+    /// @param callback The callback.
+    /// @param ctx The user argument passed to the callback.
+    /// @return True if subscribed, false if there are too many subscribers.
+    bool subscribe(LinkStateCallback callback, void* ctx);
+
+    /// @brief Unsubscribe from link state changes.
+    /// @param callback The callback.
+    /// @param ctx The user argument given to subscribe().
+    void unsubscribe(LinkStateCallback callback, void* ctx);
+
+    /// @brief Get the state of the station link.
+    /// @return The link state.
+    LinkState getLinkState() const;
+
     /// @brief Disconnect from the WiFi.
     void disconnect();
 
@@ -35,7 +178,58 @@ namespace wifi_connect {
     /// @return The IP address.
     const std::string& getIP() const;
 
+    /// @brief Get the outcome of the last connection attempt.
+    /// @return The outcome.
+    const ConnectResult& getLastResult() const;
+
+    /// @brief Get the per-phase timing of the connection attempts.
+    /// @return The connection statistics.
+    const ConnectionStats& getConnectionStats() const;
+
+    /// @brief Get the cost of bringing up the WiFi driver since boot.
+    /// @return The startup timing.
+    const StartupTiming& getStartupTiming() const;
+
   private:
+    /// @brief The DHCP lease cached for reuse.
+    struct LeaseInfo {
+      /// @brief The SSID the lease belongs to.
+      uint8_t ssid[32];
+      /// @brief The IP address.
+      uint32_t ip;
+      /// @brief The netmask.
+      uint32_t netmask;
+      /// @brief The gateway.
+      uint32_t gw;
+      /// @brief The main DNS server.
+      uint32_t dns;
+      /// @brief The system time the lease was obtained, in seconds.
+      int64_t obtained_at;
+      /// @brief The lease time granted by the server, in seconds.
+      uint32_t lease_time;
+    };
+
+    /// @brief The access point cached for a fast reconnect.
+    struct FastConnectInfo {
+      /// @brief The SSID the entry belongs to.
+      uint8_t ssid[32];
+      /// @brief The SSID of the stored driver configuration when the entry was saved.
+      uint8_t stored_ssid[32];
+      /// @brief The BSSID of the access point.
+      uint8_t bssid[6];
+      /// @brief The primary channel of the access point.
+      uint8_t channel;
+      /// @brief The authentication mode of the access point, the minimum accepted on a fast reconnect.
+      uint8_t authmode;
+    };
+
+    /// @brief A link state subscriber.
+    struct Subscriber {
+      /// @brief The callback, null if the slot is free.
+      LinkStateCallback callback;
+      /// @brief The user argument.
+      void* ctx;
+    };
 
     /// @brief The constructor.
     Connector();
@@ -50,6 +244,151 @@ namespace wifi_connect {
     esp_event_handler_instance_t got_ip_handler;
     /// @brief The IP address.
     std::string ip;
+    /// @brief The outcome of the last connection attempt.
+    ConnectResult last_result;
+    /// @brief The connection statistics.
+    ConnectionStats stats;
+    /// @brief The cost of bringing up the WiFi driver.
+    StartupTiming startup_timing;
+    /// @brief The known networks.
+    CredentialStore profiles;
+    /// @brief Whether the last DHCP lease is reused.
+    bool lease_reuse;
+    /// @brief The lifetime assumed for a lease the server did not give a time for, in seconds.
+    uint32_t lease_time_s;
+    /// @brief Whether the current address comes from the cached lease.
+    bool lease_applied;
+    /// @brief The SSID of the network being connected to.
+    uint8_t lease_ssid[32];
+    /// @brief The cached lease renewal timer.
+    esp_timer_handle_t renew_timer;
+    /// @brief The timer checking the answers to the ARP probe of the cached lease.
+    esp_timer_handle_t probe_timer;
+    /// @brief The automatic reconnection policy.
+    ReconnectPolicy reconnect_policy;
+    /// @brief The reconnection timer.
+    esp_timer_handle_t reconnect_timer;
+    /// @brief The timer bounding the wait for an IP address after a reconnection associated.
+    esp_timer_handle_t got_ip_timer;
+    /// @brief The number of reconnections since the link was lost.
+    uint32_t reconnect_attempts;
+    /// @brief Whether connect() is running its own attempts.
+    bool connecting;
+    /// @brief Whether the link is restored when lost, set once connect() succeeded.
+    bool auto_reconnect;
+    /// @brief The state of the station link.
+    LinkState link_state;
+    /// @brief Whether the pending disconnect was forced by the IP address timeout.
+    bool got_ip_timed_out;
+    /// @brief Whether the WiFi driver is initialised.
+    bool driver_initialised;
+    /// @brief The SSID of the stored driver configuration.
+    uint8_t stored_ssid[32];
+#if CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+    /// @brief The records of the scan for the known networks.
+    wifi_ap_record_t scan_records[CONFIG_WIFI_CONNECT_SCAN_MAX_RECORDS];
+#endif
+    /// @brief The mutex of the reconnection state, shared by the event loop, the timers and the application.
+    /// It guards connecting, auto_reconnect, reconnect_attempts, link_state and the reconnection timers.
+    SemaphoreHandle_t reconnect_mutex;
+    /// @brief The link state subscribers mutex.
+    SemaphoreHandle_t subscribers_mutex;
+    /// @brief The link state subscribers.
+    Subscriber subscribers[MAX_SUBSCRIBERS];
+
+    /// @brief Apply the cached lease if it belongs to the network and is still valid.
+    /// @param ssid The SSID of the network.
+    void applyLease(const uint8_t* ssid);
+
+    /// @brief Probe the address of the cached lease with ARP, and go back to DHCP on a conflict.
+    /// Uses the address conflict detection of lwIP when enabled, a best-effort ARP request otherwise.
+    /// @param ip The address of the cached lease.
+    void probeLease(uint32_t ip);
+
+    /// @brief Stop the conflict detection of the cached lease address, if running.
+    void stopLeaseProbe();
+
+    /// @brief Cache the lease just obtained from DHCP.
+    /// @param ip_info The address information.
+    void saveLease(const esp_netif_ip_info_t& ip_info);
+
+    /// @brief Scan once and try the known networks found, best first.
+    /// @param only_ssid The only network to try, or null for all of them.
+    /// @return True if the connection was successful, false otherwise.
+    bool connectRanked(const uint8_t* only_ssid);
+
+    /// @brief Get the configuration of a network, from the stored configuration or the known networks.
+    /// @param ssid The SSID.
+    /// @param stored_config The configuration stored by the driver.
+    /// @param wifi_config The configuration.
+    /// @return True if the network is known, false otherwise.
+    bool getNetworkConfig(const uint8_t* ssid, const wifi_config_t& stored_config, wifi_config_t& wifi_config);
+
+    /// @brief Build the station configuration of a known network.
+    /// @param profile The network.
+    /// @param wifi_config The configuration.
+    static void getProfileConfig(const CredentialStore::Profile& profile, wifi_config_t& wifi_config);
+
+    /// @brief Update the caches after a successful connection.
+    /// @param ssid The SSID of the network.
+    void onConnected(const uint8_t* ssid);
+
+    /// @brief Go back to DHCP if the cached lease was applied.
+    void revertLease();
+
+    /// @brief Initialise the WiFi driver unless already initialised, and time it.
+    void initDriver();
+
+    /// @brief Register the WiFi and IP event handlers unless already registered.
+    void registerEventHandlers();
+
+    /// @brief End connect() and arm the automatic reconnection on success.
+    /// @param success Whether the connection was successful.
+    /// @return The success.
+    bool finishConnect(bool success);
+
+    /// @brief Schedule the next reconnection after the link was lost, or mark it down when not reconnecting.
+    /// @param reason The disconnect reason, 0 to back off whatever the cause.
+    void scheduleReconnect(uint16_t reason);
+
+    /// @brief Bound the wait for an IP address once a reconnection associated.
+    void armGotIPTimeout();
+
+    /// @brief Update the link state and notify the subscribers on a change.
+    /// @param state The new state.
+    void setLinkState(LinkState state);
+
+    /// @brief Notify the subscribers of a link state change, without holding the reconnection mutex.
+    /// @param state The new state.
+    void notifyLinkState(LinkState state);
+
+    /// @brief Check whether a disconnect reason usually clears up by itself.
+    /// @param reason The disconnect reason.
+    /// @return True if the reason is transient, false otherwise.
+    static bool isTransientReason(uint16_t reason);
+
+    /// @brief Start a connection and wait for the IP address.
+    /// @param wifi_config The station configuration.
+    /// @param timeout_ms The timeout in milliseconds.
+    /// @return True if the connection was successful, false otherwise.
+    bool tryConnect(wifi_config_t& wifi_config, uint32_t timeout_ms);
+
+    /// @brief Abort a failed attempt and wait for its disconnect event.
+    /// The event is posted asynchronously, and must not fail the next attempt.
+    void abortAttempt();
+
+    /// @brief Load the access point cached for a fast reconnect.
+    /// @param info The cached access point.
+    /// @return True if an entry was found, false otherwise.
+    static bool loadFastConnectInfo(FastConnectInfo& info);
+
+    /// @brief Cache the access point currently connected to for a fast reconnect.
+    /// @param ssid The SSID of the network.
+    /// @param stored_ssid The SSID of the stored driver configuration.
+    static void saveFastConnectInfo(const uint8_t* ssid, const uint8_t* stored_ssid);
+
+    /// @brief Drop the access point cached for a fast reconnect.
+    static void clearFastConnectInfo();
 
     /// @brief The WiFi event handler.
     /// @param arg The user argument.
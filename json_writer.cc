@@ -0,0 +1,157 @@
+#include "json_writer.hh"
+
+#include <cstdio>
+#include <cstring>
+
+namespace wifi_connect {
+
+  ////////////////////////////////
+  // Public methods
+
+  JsonWriter::JsonWriter(char* buffer, size_t size, FlushCallback flush, void* ctx)
+    : buffer(buffer)
+    , size(size)
+    , len(0)
+    , flush(flush)
+    , ctx(ctx)
+    , failed(false)
+    , after_key(false)
+    , depth(0)
+    , has_values(0)
+  {}
+
+  void JsonWriter::beginArray() {
+    separator();
+    put('[');
+    if (depth < MAX_DEPTH) {
+      ++depth;
+    }
+    has_values &= ~(1u << depth);
+  }
+
+  void JsonWriter::endArray() {
+    put(']');
+    if (depth > 0) {
+      --depth;
+    }
+  }
+
+  void JsonWriter::beginObject() {
+    separator();
+    put('{');
+    if (depth < MAX_DEPTH) {
+      ++depth;
+    }
+    has_values &= ~(1u << depth);
+  }
+
+  void JsonWriter::endObject() {
+    put('}');
+    if (depth > 0) {
+      --depth;
+    }
+  }
+
+  void JsonWriter::key(const char* name) {
+    separator();
+    quoted(name, strlen(name));
+    put(':');
+    after_key = true;
+  }
+
+  void JsonWriter::string(const char* value) {
+    string(value, strlen(value));
+  }
+
+  void JsonWriter::string(const char* value, size_t len) {
+    separator();
+    quoted(value, len);
+  }
+
+  void JsonWriter::number(int64_t value) {
+    separator();
+    char digits[24];
+    int n = snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value));
+    raw(digits, n);
+  }
+
+  void JsonWriter::boolean(bool value) {
+    separator();
+    if (value) {
+      raw("true", 4);
+    } else {
+      raw("false", 5);
+    }
+  }
+
+  bool JsonWriter::finish() {
+    drain();
+    return !failed;
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  void JsonWriter::separator() {
+    if (after_key) {
+      after_key = false;
+      return;
+    }
+    if (has_values & (1u << depth)) {
+      put(',');
+    }
+    has_values |= 1u << depth;
+  }
+
+  void JsonWriter::put(char ch) {
+    if (len == size) {
+      drain();
+    }
+    buffer[len++] = ch;
+  }
+
+  void JsonWriter::raw(const char* data, size_t len) {
+    while (len > 0) {
+      if (this->len == size) {
+        drain();
+      }
+      size_t n = size - this->len < len ? size - this->len : len;
+      memcpy(buffer + this->len, data, n);
+      this->len += n;
+      data += n;
+      len -= n;
+    }
+  }
+
+  void JsonWriter::quoted(const char* value, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    put('"');
+    for (size_t i = 0; i < len; ++i) {
+      unsigned char ch = static_cast<unsigned char>(value[i]);
+      if (ch == '"' || ch == '\\') {
+        put('\\');
+        put(ch);
+      } else if (ch == '\n') {
+        raw("\\n", 2);
+      } else if (ch == '\r') {
+        raw("\\r", 2);
+      } else if (ch == '\t') {
+        raw("\\t", 2);
+      } else if (ch < 0x20 || ch == 0x7F) {
+        char escaped[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0x0F] };
+        raw(escaped, sizeof(escaped));
+      } else {
+        put(ch);
+      }
+    }
+    put('"');
+  }
+
+  void JsonWriter::drain() {
+    if (len > 0 && !failed && !flush(ctx, buffer, len)) {
+      failed = true;
+    }
+    len = 0;
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "rate_limiter.hh"
+
+#include <cstring>
+
+namespace wifi_connect {
+
+  ////////////////////////////////
+  // Public methods
+
+  RateLimiter::RateLimiter(uint32_t burst, uint32_t interval_ms)
+    : interval(interval_ms * 1000ll)
+    , capacity(static_cast<int64_t>(burst) * interval_ms * 1000)
+  {
+    reset();
+  }
+
+  int64_t RateLimiter::acquire(uint32_t client, int64_t now) {
+    Bucket& bucket = find(client);
+    if (bucket.client != client) {
+      bucket.client = client;
+      bucket.full_at = now;
+    }
+
+    // Each request pushes the refill time one interval further; more than the burst ahead means empty.
+    int64_t full_at = bucket.full_at > now ? bucket.full_at : now;
+    int64_t next = full_at + interval;
+    if (next - now > capacity) {
+      return next - now - capacity;
+    }
+    bucket.full_at = next;
+    return 0;
+  }
+
+  void RateLimiter::reset() {
+    memset(buckets, 0, sizeof(buckets));
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  RateLimiter::Bucket& RateLimiter::find(uint32_t client) {
+    Bucket* oldest = &buckets[0];
+    for (auto& bucket : buckets) {
+      if (bucket.client == client) {
+        return bucket;
+      }
+      if (bucket.client == 0 || (oldest->client != 0 && bucket.full_at < oldest->full_at)) {
+        oldest = &bucket;
+      }
+    }
+    return *oldest;
+  }
+
+}
\ No newline at end of file
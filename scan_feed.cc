@@ -0,0 +1,151 @@
+#include "scan_feed.hh"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace wifi_connect {
+
+  ////////////////////////////////
+  // Public methods
+
+  ScanFeed::ScanFeed() {
+    clear();
+  }
+
+  void ScanFeed::clear() {
+    counts[0] = 0;
+    counts[1] = 0;
+    current = 0;
+    memset(removed, 0, sizeof(removed));
+  }
+
+  bool ScanFeed::update(const wifi_ap_record_t* records, size_t count) {
+    const Entry* previous = lists[current];
+    size_t previous_count = counts[current];
+    Entry* next = lists[current ^ 1];
+    size_t next_count = 0;
+
+    // One entry per SSID, with the strongest signal among its access points.
+    for (size_t i = 0; i < count; ++i) {
+      const char* ssid = reinterpret_cast<const char*>(records[i].ssid);
+      if (ssid[0] == '\0') {
+        continue;
+      }
+      size_t index = find(next, next_count, ssid);
+      if (index < next_count) {
+        if (records[i].rssi > next[index].rssi) {
+          next[index].rssi = records[i].rssi;
+          next[index].authmode = records[i].authmode;
+        }
+        continue;
+      }
+      if (next_count == MAX_ENTRIES) {
+        continue;
+      }
+      Entry& entry = next[next_count++];
+      strncpy(entry.ssid, ssid, sizeof(entry.ssid) - 1);
+      entry.ssid[sizeof(entry.ssid) - 1] = '\0';
+      entry.rssi = records[i].rssi;
+      entry.authmode = records[i].authmode;
+    }
+
+    // Compare with the previous list, keeping the reported signal of the networks that barely moved.
+    bool changed = false;
+    bool kept[MAX_ENTRIES] = {};
+    for (size_t i = 0; i < next_count; ++i) {
+      Entry& entry = next[i];
+      size_t index = find(previous, previous_count, entry.ssid);
+      if (index == previous_count) {
+        entry.change = Change::Added;
+        changed = true;
+        continue;
+      }
+      kept[index] = true;
+      if (abs(entry.rssi - previous[index].rssi) >= RSSI_STEP || entry.authmode != previous[index].authmode) {
+        entry.change = Change::Changed;
+        changed = true;
+      } else {
+        entry.change = Change::None;
+        entry.rssi = previous[index].rssi;
+      }
+    }
+    for (size_t i = 0; i < previous_count; ++i) {
+      removed[i] = !kept[i];
+      changed = changed || removed[i];
+    }
+
+    counts[current ^ 1] = next_count;
+    current ^= 1;
+    return changed;
+  }
+
+  void ScanFeed::writeDelta(JsonWriter& writer) const {
+    const Entry* list = lists[current];
+    size_t count = counts[current];
+    const Entry* previous = lists[current ^ 1];
+    size_t previous_count = counts[current ^ 1];
+
+    writer.beginObject();
+    const Change changes[] = { Change::Added, Change::Changed };
+    const char* names[] = { "added", "changed" };
+    for (size_t c = 0; c < 2; ++c) {
+      writer.key(names[c]);
+      writer.beginArray();
+      for (size_t i = 0; i < count; ++i) {
+        if (list[i].change == changes[c]) {
+          writeEntry(writer, list[i]);
+        }
+      }
+      writer.endArray();
+    }
+    writer.key("removed");
+    writer.beginArray();
+    for (size_t i = 0; i < previous_count; ++i) {
+      if (removed[i]) {
+        writer.string(previous[i].ssid);
+      }
+    }
+    writer.endArray();
+    writer.endObject();
+  }
+
+  void ScanFeed::writeFull(JsonWriter& writer) const {
+    const Entry* list = lists[current];
+    size_t count = counts[current];
+
+    writer.beginObject();
+    writer.key("reset");
+    writer.boolean(true);
+    writer.key("added");
+    writer.beginArray();
+    for (size_t i = 0; i < count; ++i) {
+      writeEntry(writer, list[i]);
+    }
+    writer.endArray();
+    writer.endObject();
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  size_t ScanFeed::find(const Entry* list, size_t count, const char* ssid) {
+    for (size_t i = 0; i < count; ++i) {
+      if (strcmp(list[i].ssid, ssid) == 0) {
+        return i;
+      }
+    }
+    return count;
+  }
+
+  void ScanFeed::writeEntry(JsonWriter& writer, const Entry& entry) {
+    writer.beginObject();
+    writer.key("ssid");
+    writer.string(entry.ssid);
+    writer.key("rssi");
+    writer.number(entry.rssi);
+    writer.key("authmode");
+    writer.number(entry.authmode);
+    writer.endObject();
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "scan_manager.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include <esp_log.h>
+
+#define SCAN_STEP_TIME_MS  60
+#define SCAN_STEP_GAP_MS   40
+
+namespace wifi_connect {
+
+  #define TAG "wifi_connect::ScanManager"
+
+  ////////////////////////////////
+  // Public methods
+
+  ScanManager::ScanManager()
+    : timer(nullptr)
+    , step_timer(nullptr)
+    , scan_done_handler(nullptr)
+    , record_count(0)
+    , snapshot_time(0)
+    , scanning(false)
+    , paused(false)
+    , ttl_ms(10000)
+    , period_ms(0)
+    , progressive(true)
+    , channels()
+    , channel_count(0)
+    , channel_index(0)
+    , sweep_start(0)
+    , snapshot_callback(nullptr)
+    , snapshot_ctx(nullptr)
+  {
+    mutex = xSemaphoreCreateMutex();
+  }
+
+  ScanManager::~ScanManager() {
+    stop();
+    vSemaphoreDelete(mutex);
+  }
+
+  void ScanManager::setTTL(uint32_t ttl_ms) {
+    this->ttl_ms = ttl_ms;
+  }
+
+  void ScanManager::setPeriod(uint32_t period_ms) {
+    this->period_ms = period_ms;
+  }
+
+  void ScanManager::setProgressive(bool progressive) {
+    this->progressive = progressive;
+  }
+
+  void ScanManager::setSnapshotCallback(SnapshotCallback callback, void* ctx) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    snapshot_callback = callback;
+    snapshot_ctx = ctx;
+    xSemaphoreGive(mutex);
+  }
+
+  void ScanManager::start() {
+    ESP_ERROR_CHECK(
+      esp_event_handler_instance_register(
+        WIFI_EVENT,
+        WIFI_EVENT_SCAN_DONE,
+        &ScanManager::scanDoneEventHandler,
+        this,
+        &scan_done_handler
+      )
+    );
+
+    esp_timer_create_args_t step_timer_args = {
+      .callback = [](void* arg) {
+        auto self = static_cast<ScanManager*>(arg);
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+        if (self->scanning && self->startStep() != ESP_OK) {
+          ESP_LOGW(TAG, "Failed to scan channel %d", self->channels[self->channel_index]);
+          self->scanning = false;
+        }
+        xSemaphoreGive(self->mutex);
+      },
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "scan_step",
+      .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&step_timer_args, &step_timer));
+
+    if (period_ms > 0) {
+      esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+          static_cast<ScanManager*>(arg)->startScan();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "scan_timer",
+        .skip_unhandled_events = true,
+      };
+      ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+      ESP_ERROR_CHECK(esp_timer_start_periodic(timer, static_cast<uint64_t>(period_ms) * 1000));
+    }
+
+    startScan();
+  }
+
+  void ScanManager::stop() {
+    if (timer) {
+      esp_timer_stop(timer);
+      esp_timer_delete(timer);
+      timer = nullptr;
+    }
+
+    if (step_timer) {
+      esp_timer_stop(step_timer);
+      esp_timer_delete(step_timer);
+      step_timer = nullptr;
+    }
+
+    if (scan_done_handler) {
+      esp_event_handler_instance_unregister(
+        WIFI_EVENT,
+        WIFI_EVENT_SCAN_DONE,
+        scan_done_handler
+      );
+      scan_done_handler = nullptr;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (scanning) {
+      esp_wifi_scan_stop();
+      scanning = false;
+    }
+    paused = false;
+    record_count = 0;
+    snapshot_time = 0;
+    xSemaphoreGive(mutex);
+  }
+
+  void ScanManager::pause() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    paused = true;
+    if (step_timer) {
+      esp_timer_stop(step_timer);
+    }
+    if (scanning) {
+      esp_wifi_scan_stop();
+      scanning = false;
+    }
+    xSemaphoreGive(mutex);
+  }
+
+  void ScanManager::resume() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    paused = false;
+    xSemaphoreGive(mutex);
+  }
+
+  void ScanManager::request() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool fresh = snapshot_time > 0 && esp_timer_get_time() - snapshot_time < static_cast<int64_t>(ttl_ms) * 1000;
+    xSemaphoreGive(mutex);
+
+    if (!fresh) {
+      startScan();
+    }
+  }
+
+  size_t ScanManager::copy(wifi_ap_record_t* out, size_t size, int64_t& age_ms) {
+    size_t count = 0;
+    read([out, size, &count, &age_ms](const wifi_ap_record_t* snapshot, size_t snapshot_count, int64_t snapshot_age_ms) {
+      count = snapshot_count < size ? snapshot_count : size;
+      memcpy(out, snapshot, count * sizeof(wifi_ap_record_t));
+      age_ms = snapshot_age_ms;
+    });
+    return count;
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  void ScanManager::startScan() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (scanning || paused) {
+      // Coalesce with the scan already running.
+      xSemaphoreGive(mutex);
+      return;
+    }
+
+    esp_err_t err;
+    if (progressive) {
+      planSweep();
+      sweep_start = esp_timer_get_time();
+      err = startStep();
+    } else {
+      err = esp_wifi_scan_start(nullptr, false);
+    }
+    if (err == ESP_OK) {
+      scanning = true;
+    } else {
+      ESP_LOGW(TAG, "Failed to start the scan, error: %d", err);
+    }
+    xSemaphoreGive(mutex);
+  }
+
+  void ScanManager::planSweep() {
+    uint8_t home = 0;
+    wifi_second_chan_t second;
+    esp_wifi_get_channel(&home, &second);
+
+    uint8_t first = 1, last = 13;
+    wifi_country_t country;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+      first = country.schan;
+      last = std::min<int>(country.schan + country.nchan - 1, MAX_CHANNELS);
+    }
+
+    // The access point channel needs no channel switch, then the usual non-overlapping channels come first.
+    channel_count = 0;
+    channel_index = 0;
+    auto add = [this, first, last](uint8_t channel) {
+      if (channel >= first && channel <= last
+        && std::find(channels, channels + channel_count, channel) == channels + channel_count) {
+        channels[channel_count++] = channel;
+      }
+    };
+    add(home);
+    add(1);
+    add(6);
+    add(11);
+    for (int channel = first; channel <= last; ++channel) {
+      add(channel);
+    }
+  }
+
+  esp_err_t ScanManager::startStep() {
+    wifi_scan_config_t config = {};
+    config.channel = channels[channel_index];
+    config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    config.scan_time.active.min = 0;
+    config.scan_time.active.max = SCAN_STEP_TIME_MS;
+    return esp_wifi_scan_start(&config, false);
+  }
+
+  void ScanManager::mergeStep(uint8_t channel) {
+    // Keep the records of the other channels, and read the new ones into the free space after them.
+    size_t kept = 0;
+    for (size_t i = 0; i < record_count; ++i) {
+      if (records[i].primary != channel) {
+        records[kept++] = records[i];
+      }
+    }
+    uint16_t ap_num = MAX_RECORDS - kept;
+    if (ap_num == 0) {
+      esp_wifi_clear_ap_list();
+    } else if (esp_wifi_scan_get_ap_records(&ap_num, records + kept) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to get the scan results of channel %d", channel);
+      ap_num = 0;
+    }
+
+    // An access point that moved to this channel drops its old record.
+    size_t count = kept + ap_num;
+    record_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+      bool moved = false;
+      if (i < kept) {
+        for (size_t j = kept; j < count && !moved; ++j) {
+          moved = memcmp(records[i].bssid, records[j].bssid, sizeof(records[i].bssid)) == 0;
+        }
+      }
+      if (!moved) {
+        records[record_count++] = records[i];
+      }
+    }
+
+    std::sort(records, records + record_count, [](const wifi_ap_record_t& a, const wifi_ap_record_t& b) {
+      return a.rssi > b.rssi;
+    });
+  }
+
+  void ScanManager::scanDoneEventHandler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    auto self = static_cast<ScanManager*>(arg);
+
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    if (!self->scanning) {
+      // The scan was started by someone else.
+      xSemaphoreGive(self->mutex);
+      return;
+    }
+
+    if (self->progressive) {
+      // Publish the step at once, then give the access point channel some time before the next one.
+      uint8_t channel = self->channels[self->channel_index];
+      self->mergeStep(channel);
+      int64_t now = esp_timer_get_time();
+      if (self->snapshot_time < self->sweep_start) {
+        ESP_LOGI(TAG, "First results after %lld ms", static_cast<long long>((now - self->sweep_start) / 1000));
+      }
+      self->snapshot_time = now;
+      if (self->snapshot_callback) {
+        self->snapshot_callback(self->snapshot_ctx);
+      }
+      if (++self->channel_index < self->channel_count) {
+        esp_timer_start_once(self->step_timer, SCAN_STEP_GAP_MS * 1000);
+      } else {
+        self->scanning = false;
+        ESP_LOGI(TAG, "Scan done in %lld ms, %d access points",
+          static_cast<long long>((now - self->sweep_start) / 1000), static_cast<int>(self->record_count));
+      }
+      xSemaphoreGive(self->mutex);
+      return;
+    }
+    self->scanning = false;
+
+    uint16_t ap_num = MAX_RECORDS;
+    if (esp_wifi_scan_get_ap_records(&ap_num, self->records) == ESP_OK) {
+      self->record_count = ap_num;
+      self->snapshot_time = esp_timer_get_time();
+      ESP_LOGI(TAG, "Scan done, %d access points", ap_num);
+      if (self->snapshot_callback) {
+        self->snapshot_callback(self->snapshot_ctx);
+      }
+    } else {
+      ESP_LOGW(TAG, "Failed to get the scan results");
+    }
+    xSemaphoreGive(self->mutex);
+  }
+
+}
\ No newline at end of file
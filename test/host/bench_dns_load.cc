@@ -0,0 +1,112 @@
+// Load the DNS server over loopback with N concurrent clients, each sending a
+// query and waiting for its answer before the next one. Reports the throughput
+// and the response latency percentiles, and fails if queries go unanswered.
+//
+// Usage: bench_dns_load [clients] [seconds] [port]
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "dns_messages.hh"
+#include "dns_server.hh"
+#include "transport.hh"
+
+using namespace wifi_connect;
+
+/// @brief The time a client waits for an answer before counting the query as lost.
+static constexpr uint32_t ANSWER_TIMEOUT_MS = 1000;
+
+struct Client {
+  std::vector<uint32_t> latencies_us;
+  uint32_t lost = 0;
+};
+
+static void runClient(Client& client, size_t index, uint16_t port, const std::atomic<bool>& stop) {
+  static const char* names[] = { "connectivitycheck.gstatic.com", "captive.apple.com", "www.msftconnecttest.com" };
+  static const uint16_t types[] = { 1, 28, 65 };
+  UDPTransport transport;
+  if (!transport.open(0)) {
+    return;
+  }
+  UDPEndpoint server = { inet_addr("127.0.0.1"), htons(port) };
+  uint8_t query[300];
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  for (uint16_t id = 0; !stop; ++id) {
+    size_t len = buildQuery(query, id, names[(index + id) % 3], types[id % 3]);
+    auto start = std::chrono::steady_clock::now();
+    if (!transport.send(query, len, server)) {
+      ++client.lost;
+      continue;
+    }
+    // Skip late answers to earlier queries.
+    bool answered = false;
+    while (!answered && transport.poll(ANSWER_TIMEOUT_MS) == 1) {
+      UDPEndpoint from;
+      int received = transport.receive(response, sizeof(response), from, false);
+      answered = received >= 2 && response[0] == query[0] && response[1] == query[1];
+    }
+    if (!answered) {
+      ++client.lost;
+      continue;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    client.latencies_us.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+  }
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+int main(int argc, char** argv) {
+  size_t client_count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16;
+  double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+  uint16_t port = argc > 3 ? static_cast<uint16_t>(strtoul(argv[3], nullptr, 10)) : 25354;
+
+  DNSServer server;
+  server.setPort(port);
+  esp_ip4_addr_t gateway = { inet_addr("192.168.4.1") };
+  server.start(gateway);
+
+  std::atomic<bool> stop(false);
+  std::vector<Client> clients(client_count);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < client_count; ++i) {
+    threads.emplace_back(runClient, std::ref(clients[i]), i, port, std::cref(stop));
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto stats = server.getStats();
+  server.stop();
+
+  std::vector<uint32_t> latencies;
+  uint32_t lost = 0;
+  for (auto& client : clients) {
+    latencies.insert(latencies.end(), client.latencies_us.begin(), client.latencies_us.end());
+    lost += client.lost;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  printf("dns_load: %zu clients, %zu answers in %.2f s, %.0f queries/s, %u lost\n",
+    client_count, latencies.size(), elapsed, latencies.size() / elapsed, lost);
+  printf("dns_load: latency p50 %u us, p99 %u us, p999 %u us, max %u us\n",
+    percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999),
+    latencies.empty() ? 0 : latencies.back());
+  printf("dns_load: server cache hit rate %u%%, max batch %u\n", stats.cache_hit_rate, stats.max_batch);
+  return lost == 0 && !latencies.empty() ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// The time until a client detects the portal, for the DNS probe sequences of
+// common operating systems: every query of a step is sent at once, as clients
+// do, and the client moves on once all of them are answered. An answer of the
+// wrong type, or none, costs the client's resolver timeout instead.
+//
+// Usage: bench_dns_probes [rounds] [port]
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "dns_messages.hh"
+#include "dns_server.hh"
+#include "transport.hh"
+
+using namespace wifi_connect;
+
+/// @brief The resolver timeout a client waits out on a missing or mismatched answer.
+static constexpr uint32_t RESOLVER_TIMEOUT_MS = 5000;
+/// @brief The time the benchmark waits for an answer before counting the timeout.
+static constexpr uint32_t ANSWER_WAIT_MS = 500;
+
+struct Probe {
+  const char* name;
+  uint16_t types[3];
+};
+
+struct Profile {
+  const char* os;
+  Probe steps[2];
+};
+
+static const Profile profiles[] = {
+  { "iOS", { { "captive.apple.com", { 1, 28, 65 } }, { "www.apple.com", { 1, 28, 65 } } } },
+  { "Android", { { "connectivitycheck.gstatic.com", { 1, 28, 0 } }, { "www.google.com", { 1, 28, 0 } } } },
+  { "Windows", { { "www.msftconnecttest.com", { 1, 28, 0 } }, { "dns.msftncsi.com", { 1, 28, 0 } } } },
+};
+
+static uint16_t readU16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+/// @brief Check that a response answers the query with records of its type, or with none.
+static bool matches(const uint8_t* response, int len, size_t query_len, uint16_t qtype) {
+  if (len < static_cast<int>(query_len) || (response[3] & 0x0F) != 0) {
+    return false;
+  }
+  uint16_t answers = readU16(response + 6);
+  return answers == 0 || (static_cast<size_t>(len) >= query_len + 4 && readU16(response + query_len + 2) == qtype);
+}
+
+/// @brief Run a step and return its duration in microseconds, counting the timeouts.
+static uint64_t runStep(UDPTransport& transport, const UDPEndpoint& server, const Probe& probe, uint16_t& id) {
+  uint8_t queries[3][300];
+  size_t lengths[3];
+  bool answered[3] = { true, true, true };
+  auto start = std::chrono::steady_clock::now();
+  uint16_t first_id = id;
+  for (size_t i = 0; i < 3 && probe.types[i] != 0; ++i) {
+    lengths[i] = buildQuery(queries[i], id++, probe.name, probe.types[i]);
+    answered[i] = false;
+    transport.send(queries[i], lengths[i], server);
+  }
+
+  uint64_t penalty_us = 0;
+  while (!(answered[0] && answered[1] && answered[2])) {
+    if (transport.poll(ANSWER_WAIT_MS) != 1) {
+      break;
+    }
+    uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+    UDPEndpoint from;
+    int len = transport.receive(response, sizeof(response), from, false);
+    if (len < 12) {
+      continue;
+    }
+    size_t i = static_cast<uint16_t>(readU16(response) - first_id);
+    if (i >= 3 || answered[i]) {
+      continue;
+    }
+    answered[i] = true;
+    if (!matches(response, len, lengths[i], probe.types[i])) {
+      penalty_us += RESOLVER_TIMEOUT_MS * 1000ull;
+    }
+  }
+  for (bool done : answered) {
+    if (!done) {
+      penalty_us += RESOLVER_TIMEOUT_MS * 1000ull;
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + penalty_us;
+}
+
+int main(int argc, char** argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+  uint16_t port = argc > 2 ? static_cast<uint16_t>(strtoul(argv[2], nullptr, 10)) : 25356;
+
+  DNSServer server;
+  server.setPort(port);
+  esp_ip4_addr_t gateway = { inet_addr("192.168.4.1") };
+  server.start(gateway);
+  UDPTransport transport;
+  transport.open(0);
+  UDPEndpoint endpoint = { inet_addr("127.0.0.1"), htons(port) };
+
+  bool timeouts = false;
+  uint16_t id = 0;
+  for (const auto& profile : profiles) {
+    std::vector<uint64_t> durations;
+    for (int round = 0; round < rounds; ++round) {
+      uint64_t duration = 0;
+      for (const auto& step : profile.steps) {
+        duration += runStep(transport, endpoint, step, id);
+      }
+      durations.push_back(duration);
+    }
+    std::sort(durations.begin(), durations.end());
+    printf("dns_probes: %-8s detection p50 %llu us, p99 %llu us, max %llu us\n", profile.os,
+      static_cast<unsigned long long>(durations[durations.size() / 2]),
+      static_cast<unsigned long long>(durations[durations.size() * 99 / 100]),
+      static_cast<unsigned long long>(durations.back()));
+    timeouts |= durations.back() >= RESOLVER_TIMEOUT_MS * 1000ull;
+  }
+
+  auto stats = server.getStats();
+  server.stop();
+  printf("dns_probes: A %u, AAAA %u, HTTPS %u, PTR %u, ANY %u, other %u\n", stats.a_queries, stats.aaaa_queries,
+    stats.https_queries, stats.ptr_queries, stats.any_queries, stats.other_queries);
+  return timeouts ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+// Packets per second of the DNS responder on the probe names of common clients.
+//
+// Usage: bench_dns_responder [seconds]
+
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "dns_messages.hh"
+#include "dns_responder.hh"
+
+using namespace wifi_connect;
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  DNSResponder responder;
+  responder.setAddress(inet_addr("192.168.4.1"));
+
+  static const char* names[] = {
+    "connectivitycheck.gstatic.com",
+    "captive.apple.com",
+    "www.msftconnecttest.com",
+    "detectportal.firefox.com",
+  };
+  static const uint16_t types[] = { 1, 28, 65 };
+  struct Query {
+    uint8_t message[300];
+    size_t len;
+  };
+  Query queries[sizeof(names) / sizeof(names[0]) * sizeof(types) / sizeof(types[0])];
+  size_t query_count = 0;
+  for (auto name : names) {
+    for (auto type : types) {
+      queries[query_count].len = buildQuery(queries[query_count].message, static_cast<uint16_t>(query_count), name, type, type == 65);
+      ++query_count;
+    }
+  }
+
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  size_t bytes = 0;
+  uint64_t packets = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < deadline) {
+    for (int i = 0; i < 1000; ++i) {
+      const auto& query = queries[packets % query_count];
+      bytes += responder.respond(query.message, query.len, response, sizeof(response));
+      ++packets;
+    }
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("dns_responder: %llu packets in %.2f s, %.0f packets/s, %.1f ns/packet (%zu bytes)\n",
+    static_cast<unsigned long long>(packets), elapsed, packets / elapsed, elapsed * 1e9 / packets, bytes);
+  return 0;
+}
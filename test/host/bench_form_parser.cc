@@ -0,0 +1,42 @@
+// Throughput of the form parser on a typical /submit body, fed at once as by
+// a single receive, and one byte at a time as the worst case of a slow link.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "form_parser.hh"
+
+using namespace wifi_connect;
+
+static double run(const char* body, size_t len, size_t piece, int iterations) {
+  char ssid[33];
+  char password[65];
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    FormParser::Field fields[] = {
+      { "ssid", ssid, sizeof(ssid), 0, false },
+      { "password", password, sizeof(password), 0, false },
+    };
+    FormParser parser(fields, 2);
+    for (size_t offset = 0; offset < len; offset += piece) {
+      parser.feed(body + offset, piece < len - offset ? piece : len - offset);
+    }
+    if (!parser.finish()) {
+      return 0;
+    }
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+  static const char body[] = "ssid=Caf%C3%A9+Guest+Network+5G&password=c0rrect%20h0rse%2Bbattery%21staple%40%23";
+  const size_t len = strlen(body);
+  const int iterations = 1000000;
+  for (size_t piece : { len, static_cast<size_t>(1) }) {
+    double elapsed = run(body, len, piece, iterations);
+    printf("form_parser: %zu-byte body in %zu-byte pieces: %.1f ns/body, %.0f MB/s\n",
+      len, piece, elapsed * 1e9 / iterations, len * iterations / elapsed / 1e6);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Bytes on the wire and send calls of the /scan response for 10, 50 and 100
+// access points, with the JsonWriter as in the handler and with the former
+// one-chunk-per-fragment encoding, plus the time to encode a response.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "json_writer.hh"
+
+using namespace wifi_connect;
+
+struct Record {
+  char ssid[33];
+  int rssi;
+  int authmode;
+};
+
+struct Wire {
+  size_t sends = 0;
+  size_t bytes = 0;
+};
+
+/// @brief Count a chunk of the chunked transfer encoding: hex length, CRLF, data, CRLF.
+static void countChunk(Wire& wire, size_t len) {
+  char size[16];
+  wire.sends += 1;
+  wire.bytes += snprintf(size, sizeof(size), "%zx", len) + 2 + len + 2;
+}
+
+static bool flush(void* ctx, const char* data, size_t len) {
+  countChunk(*static_cast<Wire*>(ctx), len);
+  return true;
+}
+
+static void writeJson(const Record* records, size_t count, Wire& wire) {
+  // The buffer size of the /scan handler.
+  char buffer[512];
+  JsonWriter writer(buffer, sizeof(buffer), flush, &wire);
+  writer.beginArray();
+  for (size_t i = 0; i < count; ++i) {
+    writer.beginObject();
+    writer.key("ssid");
+    writer.string(records[i].ssid);
+    writer.key("rssi");
+    writer.number(records[i].rssi);
+    writer.key("authmode");
+    writer.number(records[i].authmode);
+    writer.endObject();
+  }
+  writer.endArray();
+  writer.finish();
+  countChunk(wire, 0);
+}
+
+static void writeLegacy(const Record* records, size_t count, Wire& wire) {
+  char buffer[128];
+  countChunk(wire, 1);
+  for (size_t i = 0; i < count; ++i) {
+    int len = snprintf(buffer, sizeof(buffer), "{\"ssid\":\"%s\",\"rssi\":%d,\"authmode\":%d}",
+      records[i].ssid, records[i].rssi, records[i].authmode);
+    countChunk(wire, len);
+    if (i < count - 1) {
+      countChunk(wire, 1);
+    }
+  }
+  countChunk(wire, 1);
+  countChunk(wire, 0);
+}
+
+int main() {
+  static Record records[100];
+  std::mt19937 rng(1);
+  for (auto& record : records) {
+    size_t len = 6 + rng() % 27;
+    for (size_t i = 0; i < len; ++i) {
+      record.ssid[i] = "abcdefghijklmnopqrstuvwxyz0123456789-_ \"\\"[rng() % 41];
+    }
+    record.ssid[len] = '\0';
+    record.rssi = -30 - static_cast<int>(rng() % 60);
+    record.authmode = rng() % 8;
+  }
+
+  for (size_t count : { 10, 50, 100 }) {
+    Wire json;
+    Wire legacy;
+    writeJson(records, count, json);
+    writeLegacy(records, count, legacy);
+
+    const int iterations = 20000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      Wire wire;
+      writeJson(records, count, wire);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("json_writer: %3zu APs: %4zu bytes in %2zu sends (per-fragment chunks: %4zu bytes in %3zu sends), %.2f us to encode\n",
+      count, json.bytes, json.sends, legacy.bytes, legacy.sends, elapsed * 1e6 / iterations);
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+// The latency of the provisioning portal on the simulated drivers, for phones
+// going through it at the same time: the DNS probe, the captive portal
+// redirect, the page, the scan and the submission, each timed in virtual time
+// from the request to the answer. The submitted network is joined and handed
+// off, so the run also times the connection.
+//
+// Prints a JSON document: the per-step and total latency of every phone, their
+// mean and maximum, and the DNS and HTTP requests the device counted.
+//
+// Usage: bench_sim_portal [phones] [latency_us]
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "dns_messages.hh"
+#include "json_writer.hh"
+#include "sim.hh"
+#include "wifi_configurator.hh"
+#include "wifi_connector.hh"
+
+using namespace wifi_connect;
+
+static const uint32_t ap_ip = ESP_IP4TOADDR(192, 168, 4, 1);
+
+enum Step {
+  STEP_DNS,
+  STEP_REDIRECT,
+  STEP_PAGE,
+  STEP_SCAN,
+  STEP_SUBMIT,
+  STEP_COUNT,
+};
+
+static const char* const step_names[STEP_COUNT] = { "dns", "redirect", "page", "scan", "submit" };
+
+struct Phone {
+  uint8_t mac[6];
+  uint32_t ip;
+  int64_t step_us[STEP_COUNT];
+  int64_t total_us;
+  /// @brief Whether every step got the expected answer.
+  bool ok;
+  SemaphoreHandle_t done;
+};
+
+/// @brief Go through the portal like a phone that just joined the access point.
+static void runPhone(void* arg) {
+  auto phone = static_cast<Phone*>(arg);
+  phone->ok = true;
+  int64_t start = esp_timer_get_time();
+  int64_t step_start = start;
+  auto endStep = [phone, &step_start](Step step, bool ok) {
+    int64_t now = esp_timer_get_time();
+    phone->step_us[step] = now - step_start;
+    phone->ok &= ok;
+    step_start = now;
+  };
+
+  uint8_t query[300], reply[512];
+  size_t query_len = buildQuery(query, static_cast<uint16_t>(phone->ip), "connectivitycheck.gstatic.com", 1);
+  int reply_len = sim::exchangeDatagram(phone->ip, ap_ip, 53, query, query_len, reply, sizeof(reply), 5000);
+  endStep(STEP_DNS, reply_len > static_cast<int>(query_len) && memcmp(reply + reply_len - 4, &ap_ip, 4) == 0);
+
+  {
+    sim::HttpClient client(phone->ip, ap_ip);
+    auto response = client.get("/generate_204");
+    endStep(STEP_REDIRECT, response.status == 302);
+    response = client.get("/", { { "Accept-Encoding", "gzip, deflate" } });
+    endStep(STEP_PAGE, response.status == 200 && !response.body.empty());
+    response = client.get("/scan");
+    endStep(STEP_SCAN, response.status == 200);
+    response = client.post("/submit", "ssid=HomeNet&password=correct+horse");
+    endStep(STEP_SUBMIT, response.status == 202);
+  }
+
+  phone->total_us = esp_timer_get_time() - start;
+  xSemaphoreGive(phone->done);
+  vTaskDelete(NULL);
+}
+
+/// @brief Follow /status until the device is connected.
+/// @return True if it connected.
+static bool waitForConnection(uint32_t phone_ip) {
+  sim::HttpClient client(phone_ip, ap_ip);
+  for (int i = 0; i < 20; ++i) {
+    auto response = client.get("/status", {}, 30000);
+    if (response.body.find("\"connected\"") != std::string::npos) {
+      return true;
+    }
+    if (response.body.find("\"failed\"") != std::string::npos) {
+      return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(250));
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  int phone_count = argc > 1 ? atoi(argv[1]) : 4;
+  uint32_t latency_us = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000;
+  // The access point takes CONFIG_WIFI_CONNECT_AP_MAX_CONNECTIONS stations.
+  if (phone_count < 1 || phone_count > CONFIG_WIFI_CONNECT_AP_MAX_CONNECTIONS) {
+    fprintf(stderr, "bench_sim_portal: 1 to %d phones\n", CONFIG_WIFI_CONNECT_AP_MAX_CONNECTIONS);
+    return 2;
+  }
+
+  ESP_ERROR_CHECK(esp_netif_init());
+  ESP_ERROR_CHECK(esp_event_loop_create_default());
+  esp_log_level_set("*", ESP_LOG_WARN);
+
+  sim::Radio radio;
+  radio.latency_us = latency_us;
+  sim::setRadio(radio);
+  sim::AccessPoint home;
+  home.ssid = "HomeNet";
+  home.password = "correct horse";
+  home.bssid[5] = 1;
+  home.channel = 6;
+  sim::addAccessPoint(home);
+  sim::AccessPoint cafe;
+  cafe.ssid = "Cafe";
+  cafe.bssid[5] = 2;
+  cafe.authmode = WIFI_AUTH_OPEN;
+  sim::addAccessPoint(cafe);
+
+  static std::atomic<bool> handed_off(false);
+  auto& configurator = Configurator::getInstance();
+  configurator.setAPIP("192.168.4.1");
+  configurator.setHandOff(true, [](void* ctx) {
+    static_cast<std::atomic<bool>*>(ctx)->store(true);
+  }, &handed_off);
+  configurator.start();
+
+  Phone phones[CONFIG_WIFI_CONNECT_AP_MAX_CONNECTIONS] = {};
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < phone_count; ++i) {
+    auto& phone = phones[i];
+    const uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, static_cast<uint8_t>(i + 1) };
+    memcpy(phone.mac, mac, sizeof(mac));
+    phone.ip = sim::joinStation(phone.mac);
+    phone.done = xSemaphoreCreateBinary();
+    if (phone.ip == 0) {
+      fprintf(stderr, "bench_sim_portal: phone %d could not join\n", i);
+      return 1;
+    }
+  }
+  for (int i = 0; i < phone_count; ++i) {
+    xTaskCreate(runPhone, "phone", 4096, &phones[i], 5, NULL);
+  }
+  bool ok = true;
+  for (int i = 0; i < phone_count; ++i) {
+    xSemaphoreTake(phones[i].done, portMAX_DELAY);
+    vSemaphoreDelete(phones[i].done);
+    ok &= phones[i].ok;
+  }
+  int64_t portal_us = esp_timer_get_time() - start;
+
+  // The last submission wins, and the device hands the connection off once it is done.
+  int64_t connect_start = esp_timer_get_time();
+  bool connected = waitForConnection(phones[0].ip);
+  int64_t connect_us = esp_timer_get_time() - connect_start;
+  auto timeline = configurator.getProvisioningTimeline();
+  for (int i = 0; i < 100 && connected && !handed_off; ++i) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+  ok &= connected && handed_off;
+
+  char buffer[256];
+  JsonWriter writer(buffer, sizeof(buffer), [](void* ctx, const char* data, size_t len) {
+    return fwrite(data, 1, len, stdout) == len;
+  }, nullptr);
+  writer.beginObject();
+  writer.key("phones");
+  writer.number(phone_count);
+  writer.key("latency_us");
+  writer.number(latency_us);
+  writer.key("steps_us");
+  writer.beginObject();
+  for (int step = 0; step < STEP_COUNT; ++step) {
+    int64_t sum = 0, max = 0;
+    for (int i = 0; i < phone_count; ++i) {
+      sum += phones[i].step_us[step];
+      max = phones[i].step_us[step] > max ? phones[i].step_us[step] : max;
+    }
+    writer.key(step_names[step]);
+    writer.beginObject();
+    writer.key("mean");
+    writer.number(sum / phone_count);
+    writer.key("max");
+    writer.number(max);
+    writer.endObject();
+  }
+  writer.endObject();
+  writer.key("per_phone_us");
+  writer.beginArray();
+  for (int i = 0; i < phone_count; ++i) {
+    writer.beginObject();
+    for (int step = 0; step < STEP_COUNT; ++step) {
+      writer.key(step_names[step]);
+      writer.number(phones[i].step_us[step]);
+    }
+    writer.key("total");
+    writer.number(phones[i].total_us);
+    writer.endObject();
+  }
+  writer.endArray();
+  writer.key("total_us");
+  writer.number(portal_us);
+  writer.key("connect_us");
+  writer.number(connected ? connect_us : -1);
+  writer.key("dns_requests");
+  writer.number(timeline.dns_queries);
+  writer.key("http_requests");
+  writer.number(timeline.http_requests);
+  writer.key("ok");
+  writer.boolean(ok);
+  writer.endObject();
+  writer.finish();
+  printf("\n");
+
+  configurator.stop();
+  Connector::getInstance().disconnect();
+  return ok ? 0 : 1;
+}
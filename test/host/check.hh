@@ -0,0 +1,15 @@
+#ifndef __CHECK_HH__
+#define __CHECK_HH__
+
+#include <cstdio>
+#include <cstdlib>
+
+/// @brief Fail the test with the location and the condition if the condition is false.
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      exit(1); \
+    } \
+  } while (0)
+
+#endif // __CHECK_HH__
@@ -0,0 +1,43 @@
+#ifndef __DNS_MESSAGES_HH__
+#define __DNS_MESSAGES_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// @brief Build a DNS query with a single question.
+/// @param buffer The message buffer, at least 300 bytes.
+/// @param id The message ID.
+/// @param name The dotted name.
+/// @param qtype The query type.
+/// @param edns Whether to add an EDNS OPT record.
+/// @return The message length.
+static inline size_t buildQuery(uint8_t* buffer, uint16_t id, const char* name, uint16_t qtype, bool edns = false) {
+  const uint8_t header[12] = {
+    static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id), 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    static_cast<uint8_t>(edns ? 1 : 0),
+  };
+  memcpy(buffer, header, sizeof(header));
+  size_t len = sizeof(header);
+  while (*name) {
+    const char* dot = strchr(name, '.');
+    size_t label_len = dot ? static_cast<size_t>(dot - name) : strlen(name);
+    buffer[len++] = static_cast<uint8_t>(label_len);
+    memcpy(buffer + len, name, label_len);
+    len += label_len;
+    name += label_len + (dot ? 1 : 0);
+  }
+  buffer[len++] = 0;
+  const uint8_t question[4] = { static_cast<uint8_t>(qtype >> 8), static_cast<uint8_t>(qtype), 0x00, 0x01 };
+  memcpy(buffer + len, question, sizeof(question));
+  len += sizeof(question);
+  if (edns) {
+    // Root name, type OPT, 1232-byte payload, version 0, DO bit clear, no options.
+    const uint8_t opt[11] = { 0x00, 0x00, 0x29, 0x04, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    memcpy(buffer + len, opt, sizeof(opt));
+    len += sizeof(opt);
+  }
+  return len;
+}
+
+#endif // __DNS_MESSAGES_HH__
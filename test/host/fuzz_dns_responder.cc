@@ -0,0 +1,50 @@
+// Fuzz the DNS responder with raw messages, and with valid headers followed by
+// arbitrary questions and records. Responses must stay within their buffer.
+
+#include <cstring>
+
+#include "check.hh"
+#include "dns_responder.hh"
+
+using namespace wifi_connect;
+
+static void respond(const DNSResponder& responder, const uint8_t* query, size_t len) {
+  // Guard bytes after the response buffer catch writes past its end even without a sanitizer.
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE + 16];
+  memset(response, 0xA5, sizeof(response));
+  size_t response_len = responder.respond(query, len, response, DNSResponder::MAX_MESSAGE_SIZE);
+  CHECK(response_len <= DNSResponder::MAX_MESSAGE_SIZE);
+  for (size_t i = DNSResponder::MAX_MESSAGE_SIZE; i < sizeof(response); ++i) {
+    CHECK(response[i] == 0xA5);
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  static DNSResponder responder;
+  static DNSResponder responder6;
+  static bool initialised = false;
+  if (!initialised) {
+    static const uint8_t address6[16] = { 0xFD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+    responder.setAddress(0x0104A8C0);
+    responder6.setAddress(0x0104A8C0);
+    responder6.setAddress6(address6);
+    initialised = true;
+  }
+
+  if (size > DNSResponder::MAX_MESSAGE_SIZE) {
+    size = DNSResponder::MAX_MESSAGE_SIZE;
+  }
+  respond(responder, data, size);
+
+  // A standard query with a single question, so the parser goes past the header.
+  uint8_t query[DNSResponder::MAX_MESSAGE_SIZE];
+  static const uint8_t header[12] = { 0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  size_t len = size < sizeof(query) - sizeof(header) ? size : sizeof(query) - sizeof(header);
+  memcpy(query, header, sizeof(header));
+  if (len > 0) {
+    memcpy(query + sizeof(header), data, len);
+  }
+  respond(responder, query, sizeof(header) + len);
+  respond(responder6, query, sizeof(header) + len);
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Fuzz the form parser with arbitrary bodies fed in two pieces. Values must
+// stay null-terminated within their buffers, and the split must not matter.
+
+#include <cstring>
+
+#include "check.hh"
+#include "form_parser.hh"
+
+using namespace wifi_connect;
+
+struct Result {
+  bool ok;
+  char ssid[33 + 8];
+  char password[65 + 8];
+  FormParser::Field fields[2];
+};
+
+static void parse(Result& result, const char* data, size_t size, size_t split) {
+  // Guard bytes after each buffer catch writes past the given sizes.
+  memset(result.ssid, 0xA5, sizeof(result.ssid));
+  memset(result.password, 0xA5, sizeof(result.password));
+  result.fields[0] = { "ssid", result.ssid, 33, 0, false };
+  result.fields[1] = { "password", result.password, 65, 0, false };
+  FormParser parser(result.fields, 2);
+  result.ok = parser.feed(data, split) && parser.feed(data + split, size - split) && parser.finish();
+  for (size_t i = 33; i < sizeof(result.ssid); ++i) {
+    CHECK(static_cast<uint8_t>(result.ssid[i]) == 0xA5);
+  }
+  for (size_t i = 65; i < sizeof(result.password); ++i) {
+    CHECK(static_cast<uint8_t>(result.password[i]) == 0xA5);
+  }
+  for (auto& field : result.fields) {
+    CHECK(field.length < field.size);
+    CHECK(field.value[field.length] == '\0');
+    CHECK(strlen(field.value) == field.length);
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  // The first byte picks where the body is split.
+  size_t split = data[0] % size;
+  auto body = reinterpret_cast<const char*>(data + 1);
+  size -= 1;
+  split = split < size ? split : size;
+
+  Result whole;
+  Result pieces;
+  parse(whole, body, size, size);
+  parse(pieces, body, size, split);
+  CHECK(whole.ok == pieces.ok);
+  if (whole.ok) {
+    for (size_t i = 0; i < 2; ++i) {
+      CHECK(whole.fields[i].present == pieces.fields[i].present);
+      CHECK(whole.fields[i].length == pieces.fields[i].length);
+      CHECK(memcmp(whole.fields[i].value, pieces.fields[i].value, whole.fields[i].length) == 0);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+// A standalone driver for the fuzz targets, for compilers without libFuzzer.
+// Inputs are random, or mutations of the inputs given on the command line
+// and of earlier inputs. With libFuzzer the targets link without this file.
+//
+// Usage: fuzz_target [-runs=N] [-seed=S] [file...]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static constexpr size_t MAX_INPUT_SIZE = 1024;
+
+static std::vector<uint8_t> mutate(const std::vector<uint8_t>& input, std::mt19937& rng) {
+  std::vector<uint8_t> output = input;
+  int mutations = 1 + rng() % 8;
+  for (int i = 0; i < mutations; ++i) {
+    switch (rng() % 5) {
+      case 0:
+        // Flip a bit.
+        if (!output.empty()) {
+          output[rng() % output.size()] ^= 1 << (rng() % 8);
+        }
+        break;
+      case 1:
+        // Replace a byte, preferring the edge values.
+        if (!output.empty()) {
+          static const uint8_t interesting[] = { 0x00, 0x01, 0x3F, 0x40, 0x7F, 0x80, 0xC0, 0xFF, '%', '&', '=', '+' };
+          output[rng() % output.size()] = rng() % 2 ? interesting[rng() % sizeof(interesting)] : rng();
+        }
+        break;
+      case 2:
+        // Insert a byte.
+        if (output.size() < MAX_INPUT_SIZE) {
+          output.insert(output.begin() + rng() % (output.size() + 1), static_cast<uint8_t>(rng()));
+        }
+        break;
+      case 3:
+        // Erase a range.
+        if (!output.empty()) {
+          size_t start = rng() % output.size();
+          size_t len = 1 + rng() % (output.size() - start);
+          output.erase(output.begin() + start, output.begin() + start + len);
+        }
+        break;
+      default:
+        // Truncate.
+        output.resize(output.empty() ? 0 : rng() % output.size());
+        break;
+    }
+  }
+  return output;
+}
+
+int main(int argc, char** argv) {
+  unsigned long runs = 100000;
+  unsigned long seed = 1;
+  std::vector<std::vector<uint8_t>> corpus;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "-runs=", 6) == 0) {
+      runs = strtoul(argv[i] + 6, nullptr, 10);
+    } else if (strncmp(argv[i], "-seed=", 6) == 0) {
+      seed = strtoul(argv[i] + 6, nullptr, 10);
+    } else if (FILE* file = fopen(argv[i], "rb")) {
+      std::vector<uint8_t> input(MAX_INPUT_SIZE);
+      input.resize(fread(input.data(), 1, input.size(), file));
+      fclose(file);
+      corpus.push_back(input);
+    }
+  }
+
+  std::mt19937 rng(seed);
+  for (auto& input : corpus) {
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  for (unsigned long run = 0; run < runs; ++run) {
+    std::vector<uint8_t> input;
+    if (corpus.empty() || rng() % 4 == 0) {
+      input.resize(rng() % MAX_INPUT_SIZE);
+      for (auto& byte : input) {
+        byte = rng();
+      }
+    } else {
+      input = mutate(corpus[rng() % corpus.size()], rng);
+    }
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+    // Keep a few inputs to mutate further.
+    if (corpus.size() < 256 && rng() % 64 == 0) {
+      corpus.push_back(input);
+    }
+  }
+  printf("%lu runs, seed %lu\n", runs, seed);
+  return 0;
+}
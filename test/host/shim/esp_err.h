@@ -0,0 +1,12 @@
+#ifndef __ESP_ERR_H__
+#define __ESP_ERR_H__
+
+/// @brief The error code of the IDF calls.
+typedef int esp_err_t;
+
+#define ESP_OK                 0
+#define ESP_FAIL               -1
+#define ESP_ERR_NVS_NOT_FOUND  0x1102
+#define ESP_ERR_NVS_INVALID_LENGTH 0x110c
+
+#endif // __ESP_ERR_H__
@@ -0,0 +1,7 @@
+#ifndef __ESP_LOG_H__
+#define __ESP_LOG_H__
+
+// The host logging macros print to stderr.
+#include "platform.hh"
+
+#endif // __ESP_LOG_H__
@@ -0,0 +1,27 @@
+#ifndef __ESP_WIFI_H__
+#define __ESP_WIFI_H__
+
+#include <cstdint>
+
+/// @brief The authentication modes, numbered as in the WiFi driver.
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+  WIFI_AUTH_WPA_WPA2_PSK,
+  WIFI_AUTH_ENTERPRISE,
+  WIFI_AUTH_WPA3_PSK,
+  WIFI_AUTH_WPA2_WPA3_PSK,
+} wifi_auth_mode_t;
+
+/// @brief The scan record of an access point, with the fields the component uses.
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t ssid[33];
+  uint8_t primary;
+  int8_t rssi;
+  wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+#endif // __ESP_WIFI_H__
@@ -0,0 +1,77 @@
+#include "nvs.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+  /// @brief The blobs by namespace and key.
+  std::map<std::string, std::map<std::string, std::vector<uint8_t>>> store;
+  /// @brief The namespaces of the open handles.
+  std::map<nvs_handle_t, std::string> handles;
+  /// @brief The next handle.
+  nvs_handle_t next_handle = 1;
+  /// @brief The store mutex.
+  std::mutex mutex;
+
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // Like on the device, a namespace never written cannot be opened read-only.
+  if (open_mode == NVS_READONLY && store.find(name) == store.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  store[name];
+  *out_handle = next_handle++;
+  handles[*out_handle] = name;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> lock(mutex);
+  handles.erase(handle);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& blobs = store[handles.at(handle)];
+  auto blob = blobs.find(key);
+  if (blob == blobs.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out_value == nullptr) {
+    *length = blob->second.size();
+    return ESP_OK;
+  }
+  if (*length < blob->second.size()) {
+    return ESP_ERR_NVS_INVALID_LENGTH;
+  }
+  memcpy(out_value, blob->second.data(), blob->second.size());
+  *length = blob->second.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto data = static_cast<const uint8_t*>(value);
+  store[handles.at(handle)][key].assign(data, data + length);
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return store[handles.at(handle)].erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  return ESP_OK;
+}
+
+void nvs_host_erase_all() {
+  std::lock_guard<std::mutex> lock(mutex);
+  store.clear();
+}
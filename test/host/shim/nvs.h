@@ -0,0 +1,29 @@
+#ifndef __NVS_H__
+#define __NVS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_err.h>
+
+/// @brief The handle of an open namespace.
+typedef uint32_t nvs_handle_t;
+
+/// @brief The access mode of a namespace.
+typedef enum {
+  NVS_READONLY,
+  NVS_READWRITE,
+} nvs_open_mode_t;
+
+// An in-memory store with the semantics of the NVS calls the component uses.
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+/// @brief Erase every namespace, like a blank flash.
+void nvs_host_erase_all();
+
+#endif // __NVS_H__
@@ -0,0 +1,146 @@
+#include <esp_event.h>
+#include <esp_netif.h>
+#include <esp_wifi.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "kernel.hh"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+namespace {
+
+  struct Handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t function;
+    void* arg;
+    /// @brief Whether the handler was unregistered while a dispatch held on to it.
+    bool removed;
+  };
+
+  struct Event {
+    esp_event_base_t base;
+    int32_t id;
+    std::vector<uint8_t> data;
+  };
+
+  /// @brief The default event loop, dispatched by the sys_evt task.
+  struct Loop {
+    bool created = false;
+    std::vector<std::shared_ptr<Handler>> handlers;
+    std::deque<Event> events;
+  };
+
+  Loop& loop() {
+    static Loop* instance = new Loop();
+    return *instance;
+  }
+
+  bool matches(const Handler& handler, esp_event_base_t base, int32_t id) {
+    return (handler.base == ESP_EVENT_ANY_BASE || handler.base == base)
+      && (handler.id == ESP_EVENT_ANY_ID || handler.id == id);
+  }
+
+  void runEventTask() {
+    auto& l = loop();
+    sim::Lock lock(sim::mutex());
+    for (;;) {
+      sim::block(lock, [&l]() { return !l.events.empty(); }, sim::FOREVER, "events");
+      Event event = std::move(l.events.front());
+      l.events.pop_front();
+      std::vector<std::shared_ptr<Handler>> handlers;
+      for (auto& handler : l.handlers) {
+        if (matches(*handler, event.base, event.id)) {
+          handlers.push_back(handler);
+        }
+      }
+      for (auto& handler : handlers) {
+        if (handler->removed) {
+          continue;
+        }
+        lock.unlock();
+        handler->function(handler->arg, event.base, event.id, event.data.empty() ? nullptr : event.data.data());
+        lock.lock();
+      }
+    }
+  }
+
+}
+
+namespace sim {
+
+  void postEvent(esp_event_base_t base, int32_t id, const void* data, size_t size) {
+    auto& l = loop();
+    if (!l.created) {
+      return;
+    }
+    auto bytes = static_cast<const uint8_t*>(data);
+    l.events.push_back({ base, id, std::vector<uint8_t>(bytes, bytes + (data != nullptr ? size : 0)) });
+  }
+
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+  auto& l = loop();
+  {
+    sim::Lock lock(sim::mutex());
+    if (l.created) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    l.created = true;
+  }
+  sim::spawn("sys_evt", 2304, runEventTask);
+  return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+  esp_event_handler_t event_handler, void* event_handler_arg, esp_event_handler_instance_t* instance) {
+  if (event_handler == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto& l = loop();
+  sim::Lock lock(sim::mutex());
+  if (!l.created) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  auto handler = std::make_shared<Handler>(Handler { event_base, event_id, event_handler, event_handler_arg, false });
+  l.handlers.push_back(handler);
+  if (instance != nullptr) {
+    *instance = handler.get();
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t event_base, int32_t event_id,
+  esp_event_handler_instance_t instance) {
+  if (instance == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto& l = loop();
+  sim::Lock lock(sim::mutex());
+  auto it = std::find_if(l.handlers.begin(), l.handlers.end(), [instance](const std::shared_ptr<Handler>& handler) {
+    return handler.get() == instance;
+  });
+  if (it == l.handlers.end()) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  (*it)->removed = true;
+  l.handlers.erase(it);
+  return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void* event_data, size_t event_data_size,
+  TickType_t ticks_to_wait) {
+  sim::Lock lock(sim::mutex());
+  if (!loop().created) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim::postEvent(event_base, event_id, event_data, event_data_size);
+  sim::wake(lock);
+  return ESP_OK;
+}
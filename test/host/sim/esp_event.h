@@ -0,0 +1,37 @@
+#ifndef __ESP_EVENT_H__
+#define __ESP_EVENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/// @brief The base of a family of events, compared by address.
+typedef const char* esp_event_base_t;
+
+/// @brief The handle of a registered handler.
+typedef void* esp_event_handler_instance_t;
+
+/// @brief The event handler.
+typedef void (*esp_event_handler_t)(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t const id = #id
+
+#define ESP_EVENT_ANY_BASE  NULL
+#define ESP_EVENT_ANY_ID    -1
+
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+  esp_event_handler_t event_handler, void* event_handler_arg, esp_event_handler_instance_t* instance);
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t event_base, int32_t event_id,
+  esp_event_handler_instance_t instance);
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void* event_data, size_t event_data_size,
+  TickType_t ticks_to_wait);
+
+#endif // __ESP_EVENT_H__
@@ -0,0 +1,34 @@
+#ifndef __ESP_LOG_H__
+#define __ESP_LOG_H__
+
+#include <stdint.h>
+
+/// @brief The log verbosity.
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+/// @brief Set the verbosity of a tag, or of every tag with "*".
+void esp_log_level_set(const char* tag, esp_log_level_t level);
+
+/// @brief Get the virtual time in milliseconds, the timestamp of the log lines.
+uint32_t esp_log_timestamp(void);
+
+/// @brief Write a log line to stderr if the verbosity of the tag allows it.
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOG_LEVEL(level, letter, tag, format, ...) \
+  esp_log_write(level, tag, letter " (%lu) %s: " format "\n", (unsigned long) esp_log_timestamp(), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+#endif // __ESP_LOG_H__
@@ -0,0 +1,22 @@
+#ifndef __ESP_MAC_H__
+#define __ESP_MAC_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/// @brief The interface of a MAC address.
+typedef enum {
+  ESP_MAC_WIFI_STA,
+  ESP_MAC_WIFI_SOFTAP,
+  ESP_MAC_BT,
+  ESP_MAC_ETH,
+} esp_mac_type_t;
+
+/// @brief Read the MAC address of an interface, derived from a fixed base address.
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type);
+
+#define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
+#define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+
+#endif // __ESP_MAC_H__
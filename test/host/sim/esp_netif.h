@@ -0,0 +1,100 @@
+#ifndef __ESP_NETIF_H__
+#define __ESP_NETIF_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif_ip_addr.h"
+
+#define ESP_ERR_ESP_NETIF_BASE                  0x5000
+#define ESP_ERR_ESP_NETIF_INVALID_PARAMS        (ESP_ERR_ESP_NETIF_BASE + 0x01)
+#define ESP_ERR_ESP_NETIF_IF_NOT_READY          (ESP_ERR_ESP_NETIF_BASE + 0x02)
+#define ESP_ERR_ESP_NETIF_DHCPC_START_FAILED    (ESP_ERR_ESP_NETIF_BASE + 0x03)
+#define ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED  (ESP_ERR_ESP_NETIF_BASE + 0x04)
+#define ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED  (ESP_ERR_ESP_NETIF_BASE + 0x05)
+#define ESP_ERR_ESP_NETIF_NO_MEM                (ESP_ERR_ESP_NETIF_BASE + 0x06)
+#define ESP_ERR_ESP_NETIF_DHCP_NOT_STOPPED      (ESP_ERR_ESP_NETIF_BASE + 0x07)
+
+/// @brief The handle of a network interface.
+typedef struct esp_netif_obj esp_netif_t;
+
+/// @brief The IPv4 settings of an interface.
+typedef struct {
+  esp_ip4_addr_t ip;
+  esp_ip4_addr_t netmask;
+  esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+/// @brief A DNS server of an interface.
+typedef struct {
+  esp_ip_addr_t ip;
+} esp_netif_dns_info_t;
+
+typedef enum {
+  ESP_NETIF_DNS_MAIN = 0,
+  ESP_NETIF_DNS_BACKUP,
+  ESP_NETIF_DNS_FALLBACK,
+  ESP_NETIF_DNS_MAX,
+} esp_netif_dns_type_t;
+
+typedef enum {
+  ESP_NETIF_OP_START = 0,
+  ESP_NETIF_OP_SET,
+  ESP_NETIF_OP_GET,
+  ESP_NETIF_OP_MAX,
+} esp_netif_dhcp_option_mode_t;
+
+typedef enum {
+  ESP_NETIF_SUBNET_MASK = 1,
+  ESP_NETIF_DOMAIN_NAME_SERVER = 6,
+  ESP_NETIF_ROUTER_SOLICITATION_ADDRESS = 32,
+  ESP_NETIF_REQUESTED_IP_ADDRESS = 50,
+  ESP_NETIF_IP_ADDRESS_LEASE_TIME = 51,
+  ESP_NETIF_IP_REQUEST_RETRY_TIME = 52,
+  ESP_NETIF_VENDOR_CLASS_IDENTIFIER = 60,
+  ESP_NETIF_VENDOR_SPECIFIC_INFO = 43,
+  ESP_NETIF_CAPTIVEPORTAL_URI = 114,
+} esp_netif_dhcp_option_id_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum {
+  IP_EVENT_STA_GOT_IP,
+  IP_EVENT_STA_LOST_IP,
+  IP_EVENT_AP_STAIPASSIGNED,
+} ip_event_t;
+
+/// @brief The data of IP_EVENT_STA_GOT_IP.
+typedef struct {
+  esp_netif_t* esp_netif;
+  esp_netif_ip_info_t ip_info;
+  bool ip_changed;
+} ip_event_got_ip_t;
+
+/// @brief The data of IP_EVENT_AP_STAIPASSIGNED.
+typedef struct {
+  esp_netif_t* esp_netif;
+  esp_ip4_addr_t ip;
+  uint8_t mac[6];
+} ip_event_ap_staipassigned_t;
+
+esp_err_t esp_netif_init(void);
+esp_netif_t* esp_netif_create_default_wifi_ap(void);
+esp_netif_t* esp_netif_create_default_wifi_sta(void);
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key);
+void esp_netif_destroy(esp_netif_t* esp_netif);
+
+esp_err_t esp_netif_dhcps_start(esp_netif_t* esp_netif);
+esp_err_t esp_netif_dhcps_stop(esp_netif_t* esp_netif);
+esp_err_t esp_netif_dhcps_option(esp_netif_t* esp_netif, esp_netif_dhcp_option_mode_t opt_op,
+  esp_netif_dhcp_option_id_t opt_id, void* opt_val, uint32_t opt_len);
+esp_err_t esp_netif_dhcpc_start(esp_netif_t* esp_netif);
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t* esp_netif);
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t* esp_netif, const esp_netif_ip_info_t* ip_info);
+esp_err_t esp_netif_get_ip_info(esp_netif_t* esp_netif, esp_netif_ip_info_t* ip_info);
+esp_err_t esp_netif_set_dns_info(esp_netif_t* esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t* dns);
+esp_err_t esp_netif_get_dns_info(esp_netif_t* esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t* dns);
+
+#endif // __ESP_NETIF_H__
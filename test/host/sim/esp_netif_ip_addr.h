@@ -0,0 +1,57 @@
+#ifndef __ESP_NETIF_IP_ADDR_H__
+#define __ESP_NETIF_IP_ADDR_H__
+
+#include <stdint.h>
+
+/// @brief The IPv4 address, in network byte order.
+typedef struct esp_ip4_addr {
+  uint32_t addr;
+} esp_ip4_addr_t;
+
+/// @brief The IPv6 address, in network byte order.
+typedef struct esp_ip6_addr {
+  uint32_t addr[4];
+  uint8_t zone;
+} esp_ip6_addr_t;
+
+/// @brief An IPv4 or IPv6 address.
+typedef struct _ip_addr {
+  union {
+    esp_ip6_addr_t ip6;
+    esp_ip4_addr_t ip4;
+  } u_addr;
+  uint8_t type;
+} esp_ip_addr_t;
+
+#define ESP_IPADDR_TYPE_V4   0U
+#define ESP_IPADDR_TYPE_V6   6U
+#define ESP_IPADDR_TYPE_ANY  46U
+
+#define esp_netif_htonl(x) __builtin_bswap32((uint32_t) (x))
+
+#define esp_netif_ip4_makeu32(a, b, c, d) (((uint32_t) ((a) & 0xff) << 24) | \
+                                           ((uint32_t) ((b) & 0xff) << 16) | \
+                                           ((uint32_t) ((c) & 0xff) << 8) | \
+                                            (uint32_t) ((d) & 0xff))
+
+#define ESP_IP4TOADDR(a, b, c, d) esp_netif_htonl(esp_netif_ip4_makeu32(a, b, c, d))
+#define IP4_ADDR(ipaddr, a, b, c, d) (ipaddr)->addr = ESP_IP4TOADDR(a, b, c, d)
+
+#define esp_ip4_addr_get_byte(ipaddr, idx) (((const uint8_t*) (&(ipaddr)->addr))[idx])
+#define esp_ip4_addr1_16(ipaddr) ((uint16_t) esp_ip4_addr_get_byte(ipaddr, 0))
+#define esp_ip4_addr2_16(ipaddr) ((uint16_t) esp_ip4_addr_get_byte(ipaddr, 1))
+#define esp_ip4_addr3_16(ipaddr) ((uint16_t) esp_ip4_addr_get_byte(ipaddr, 2))
+#define esp_ip4_addr4_16(ipaddr) ((uint16_t) esp_ip4_addr_get_byte(ipaddr, 3))
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) esp_ip4_addr1_16(ipaddr), esp_ip4_addr2_16(ipaddr), esp_ip4_addr3_16(ipaddr), esp_ip4_addr4_16(ipaddr)
+
+/// @brief Format an IPv4 address in dotted decimal.
+/// @return The buffer, or NULL if it is too short.
+char* esp_ip4addr_ntoa(const esp_ip4_addr_t* addr, char* buf, int buflen);
+
+/// @brief Parse an IPv4 address in dotted decimal.
+/// @return The address in network byte order, or 0 if it is invalid.
+uint32_t esp_ip4addr_aton(const char* addr);
+
+#endif // __ESP_NETIF_IP_ADDR_H__
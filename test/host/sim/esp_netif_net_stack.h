@@ -0,0 +1,9 @@
+#ifndef __ESP_NETIF_NET_STACK_H__
+#define __ESP_NETIF_NET_STACK_H__
+
+#include "esp_netif.h"
+
+/// @brief Get the lwIP interface behind an interface.
+void* esp_netif_get_netif_impl(esp_netif_t* esp_netif);
+
+#endif // __ESP_NETIF_NET_STACK_H__
@@ -0,0 +1,13 @@
+#ifndef __ESP_RANDOM_H__
+#define __ESP_RANDOM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Get a random number, from a fixed seed so that runs repeat.
+uint32_t esp_random(void);
+
+/// @brief Fill a buffer with random bytes.
+void esp_fill_random(void* buf, size_t len);
+
+#endif // __ESP_RANDOM_H__
@@ -0,0 +1,14 @@
+#ifndef __ESP_SYSTEM_H__
+#define __ESP_SYSTEM_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/// @brief Restart the chip: the simulation counts the restart and parks the calling task for ever.
+void esp_restart(void) __attribute__((noreturn));
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#endif // __ESP_SYSTEM_H__
@@ -0,0 +1,156 @@
+#include <esp_timer.h>
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#include "kernel.hh"
+
+/// @brief A timer, whose alarm is an action of the kernel.
+struct esp_timer {
+  esp_timer_cb_t callback;
+  void* arg;
+  std::string name;
+  /// @brief Whether the timer is started.
+  bool armed;
+  bool periodic;
+  /// @brief The period in microseconds.
+  int64_t period;
+  /// @brief The virtual time of the next alarm.
+  int64_t alarm;
+  /// @brief The action of the next alarm.
+  uint64_t action;
+};
+
+namespace {
+
+  struct Timers {
+    /// @brief The timers whose alarm went off, for the esp_timer task to call back in order.
+    std::deque<esp_timer*> due;
+    bool task_started = false;
+  };
+
+  Timers& timers() {
+    static Timers* instance = new Timers();
+    return *instance;
+  }
+
+  void runTimerTask() {
+    auto& t = timers();
+    sim::Lock lock(sim::mutex());
+    for (;;) {
+      sim::block(lock, [&t]() { return !t.due.empty(); }, sim::FOREVER, "timer alarms");
+      esp_timer* timer = t.due.front();
+      t.due.pop_front();
+      if (!timer->periodic) {
+        timer->armed = false;
+      }
+      esp_timer_cb_t callback = timer->callback;
+      void* arg = timer->arg;
+      lock.unlock();
+      callback(arg);
+      lock.lock();
+    }
+  }
+
+  /// @brief Start the esp_timer task on the first timer, as the IDF does at start-up.
+  void startTimerTask() {
+    auto& t = timers();
+    {
+      sim::Lock lock(sim::mutex());
+      if (t.task_started) {
+        return;
+      }
+      t.task_started = true;
+    }
+    sim::spawn("esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE, runTimerTask);
+  }
+
+  void arm(esp_timer* timer, int64_t at) {
+    timer->alarm = at;
+    timer->action = sim::schedule(at, [timer]() {
+      timers().due.push_back(timer);
+      if (timer->periodic) {
+        arm(timer, timer->alarm + timer->period);
+      }
+    });
+  }
+
+  esp_err_t start(esp_timer* timer, uint64_t timeout_us, bool periodic) {
+    if (timer == nullptr) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    sim::Lock lock(sim::mutex());
+    if (timer->armed) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->periodic = periodic;
+    timer->period = static_cast<int64_t>(timeout_us);
+    arm(timer, sim::now() + static_cast<int64_t>(timeout_us));
+    return ESP_OK;
+  }
+
+}
+
+int64_t esp_timer_get_time(void) {
+  sim::Lock lock(sim::mutex());
+  return sim::now();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+  if (create_args == nullptr || create_args->callback == nullptr || out_handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  startTimerTask();
+  *out_handle = new esp_timer {
+    create_args->callback, create_args->arg, create_args->name ? create_args->name : "", false, false, 0, 0, 0,
+  };
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  return start(timer, timeout_us, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+  return start(timer, period, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto& t = timers();
+  sim::Lock lock(sim::mutex());
+  if (!timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = false;
+  sim::cancel(timer->action);
+  t.due.erase(std::remove(t.due.begin(), t.due.end(), timer), t.due.end());
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  if (timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto& t = timers();
+  {
+    sim::Lock lock(sim::mutex());
+    if (timer->armed) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    // A one-shot alarm is disarmed when it went off, but may still wait for its turn.
+    t.due.erase(std::remove(t.due.begin(), t.due.end(), timer), t.due.end());
+  }
+  delete timer;
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+  sim::Lock lock(sim::mutex());
+  return timer != nullptr && timer->armed;
+}
@@ -0,0 +1,40 @@
+#ifndef __ESP_TIMER_H__
+#define __ESP_TIMER_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/// @brief The handle of a timer.
+typedef struct esp_timer* esp_timer_handle_t;
+
+/// @brief The timer callback.
+typedef void (*esp_timer_cb_t)(void* arg);
+
+/// @brief How the callback is dispatched; the simulation always calls it from the esp_timer task.
+typedef enum {
+  ESP_TIMER_TASK,
+  ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+/// @brief The timer configuration.
+typedef struct {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char* name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+/// @brief Get the virtual time since start-up.
+/// @return The time in microseconds.
+int64_t esp_timer_get_time(void);
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+#endif // __ESP_TIMER_H__
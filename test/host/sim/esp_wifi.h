@@ -0,0 +1,289 @@
+#ifndef __ESP_WIFI_H__
+#define __ESP_WIFI_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+// Like esp_wifi_default.h, which declares the default interfaces.
+#include "esp_netif.h"
+
+#define ESP_ERR_WIFI_BASE         0x3000
+#define ESP_ERR_WIFI_NOT_INIT     (ESP_ERR_WIFI_BASE + 1)
+#define ESP_ERR_WIFI_NOT_STARTED  (ESP_ERR_WIFI_BASE + 2)
+#define ESP_ERR_WIFI_NOT_STOPPED  (ESP_ERR_WIFI_BASE + 3)
+#define ESP_ERR_WIFI_IF           (ESP_ERR_WIFI_BASE + 4)
+#define ESP_ERR_WIFI_MODE         (ESP_ERR_WIFI_BASE + 5)
+#define ESP_ERR_WIFI_STATE        (ESP_ERR_WIFI_BASE + 6)
+#define ESP_ERR_WIFI_CONN         (ESP_ERR_WIFI_BASE + 7)
+#define ESP_ERR_WIFI_NVS          (ESP_ERR_WIFI_BASE + 8)
+#define ESP_ERR_WIFI_MAC          (ESP_ERR_WIFI_BASE + 9)
+#define ESP_ERR_WIFI_SSID         (ESP_ERR_WIFI_BASE + 10)
+#define ESP_ERR_WIFI_PASSWORD     (ESP_ERR_WIFI_BASE + 11)
+#define ESP_ERR_WIFI_TIMEOUT      (ESP_ERR_WIFI_BASE + 12)
+#define ESP_ERR_WIFI_WAKE_FAIL    (ESP_ERR_WIFI_BASE + 13)
+#define ESP_ERR_WIFI_WOULD_BLOCK  (ESP_ERR_WIFI_BASE + 14)
+#define ESP_ERR_WIFI_NOT_CONNECT  (ESP_ERR_WIFI_BASE + 15)
+
+typedef enum {
+  WIFI_MODE_NULL = 0,
+  WIFI_MODE_STA,
+  WIFI_MODE_AP,
+  WIFI_MODE_APSTA,
+  WIFI_MODE_MAX,
+} wifi_mode_t;
+
+typedef enum {
+  WIFI_IF_STA = 0,
+  WIFI_IF_AP,
+} wifi_interface_t;
+
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+  WIFI_AUTH_WPA_WPA2_PSK,
+  WIFI_AUTH_ENTERPRISE,
+  WIFI_AUTH_WPA3_PSK,
+  WIFI_AUTH_WPA2_WPA3_PSK,
+  WIFI_AUTH_MAX,
+} wifi_auth_mode_t;
+
+typedef enum {
+  WIFI_STORAGE_FLASH,
+  WIFI_STORAGE_RAM,
+} wifi_storage_t;
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+typedef enum {
+  WIFI_FAST_SCAN = 0,
+  WIFI_ALL_CHANNEL_SCAN,
+} wifi_scan_method_t;
+
+typedef enum {
+  WIFI_CONNECT_AP_BY_SIGNAL = 0,
+  WIFI_CONNECT_AP_BY_SECURITY,
+} wifi_sort_method_t;
+
+typedef enum {
+  WIFI_SCAN_TYPE_ACTIVE = 0,
+  WIFI_SCAN_TYPE_PASSIVE,
+} wifi_scan_type_t;
+
+typedef enum {
+  WPA3_SAE_PWE_UNSPECIFIED,
+  WPA3_SAE_PWE_HUNT_AND_PECK,
+  WPA3_SAE_PWE_HASH_TO_ELEMENT,
+  WPA3_SAE_PWE_BOTH,
+} wifi_sae_pwe_method_t;
+
+typedef enum {
+  WIFI_SECOND_CHAN_NONE = 0,
+  WIFI_SECOND_CHAN_ABOVE,
+  WIFI_SECOND_CHAN_BELOW,
+} wifi_second_chan_t;
+
+typedef enum {
+  WIFI_COUNTRY_POLICY_AUTO,
+  WIFI_COUNTRY_POLICY_MANUAL,
+} wifi_country_policy_t;
+
+/// @brief The weakest access point a station accepts.
+typedef struct {
+  int8_t rssi;
+  wifi_auth_mode_t authmode;
+} wifi_scan_threshold_t;
+
+/// @brief The configuration of the station.
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t password[64];
+  wifi_scan_method_t scan_method;
+  bool bssid_set;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint16_t listen_interval;
+  wifi_sort_method_t sort_method;
+  wifi_scan_threshold_t threshold;
+  wifi_sae_pwe_method_t sae_pwe_h2e;
+  uint8_t failure_retry_cnt;
+} wifi_sta_config_t;
+
+/// @brief The configuration of the access point.
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t password[64];
+  uint8_t ssid_len;
+  uint8_t channel;
+  wifi_auth_mode_t authmode;
+  uint8_t ssid_hidden;
+  uint8_t max_connection;
+  uint16_t beacon_interval;
+} wifi_ap_config_t;
+
+typedef union {
+  wifi_ap_config_t ap;
+  wifi_sta_config_t sta;
+} wifi_config_t;
+
+/// @brief The scan record of an access point.
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t ssid[33];
+  uint8_t primary;
+  wifi_second_chan_t second;
+  int8_t rssi;
+  wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef struct {
+  uint32_t min;
+  uint32_t max;
+} wifi_active_scan_time_t;
+
+typedef struct {
+  wifi_active_scan_time_t active;
+  uint32_t passive;
+} wifi_scan_time_t;
+
+/// @brief The parameters of a scan.
+typedef struct {
+  uint8_t* ssid;
+  uint8_t* bssid;
+  uint8_t channel;
+  bool show_hidden;
+  wifi_scan_type_t scan_type;
+  wifi_scan_time_t scan_time;
+  uint8_t home_chan_dwell_time;
+} wifi_scan_config_t;
+
+/// @brief The regulatory domain.
+typedef struct {
+  char cc[3];
+  uint8_t schan;
+  uint8_t nchan;
+  int8_t max_tx_power;
+  wifi_country_policy_t policy;
+} wifi_country_t;
+
+/// @brief The configuration of the driver; the simulation has no tunables.
+typedef struct {
+  int magic;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_MAGIC 0x1F2F3F4F
+#define WIFI_INIT_CONFIG_DEFAULT() { .magic = WIFI_INIT_CONFIG_MAGIC }
+
+ESP_EVENT_DECLARE_BASE(WIFI_EVENT);
+
+typedef enum {
+  WIFI_EVENT_WIFI_READY = 0,
+  WIFI_EVENT_SCAN_DONE,
+  WIFI_EVENT_STA_START,
+  WIFI_EVENT_STA_STOP,
+  WIFI_EVENT_STA_CONNECTED,
+  WIFI_EVENT_STA_DISCONNECTED,
+  WIFI_EVENT_STA_AUTHMODE_CHANGE,
+  WIFI_EVENT_STA_WPS_ER_SUCCESS,
+  WIFI_EVENT_STA_WPS_ER_FAILED,
+  WIFI_EVENT_STA_WPS_ER_TIMEOUT,
+  WIFI_EVENT_STA_WPS_ER_PIN,
+  WIFI_EVENT_STA_WPS_ER_PBC_OVERLAP,
+  WIFI_EVENT_AP_START,
+  WIFI_EVENT_AP_STOP,
+  WIFI_EVENT_AP_STACONNECTED,
+  WIFI_EVENT_AP_STADISCONNECTED,
+  WIFI_EVENT_AP_PROBEREQRECVED,
+  WIFI_EVENT_FTM_REPORT,
+  WIFI_EVENT_STA_BSS_RSSI_LOW,
+  WIFI_EVENT_ACTION_TX_STATUS,
+  WIFI_EVENT_ROC_DONE,
+  WIFI_EVENT_STA_BEACON_TIMEOUT,
+} wifi_event_t;
+
+typedef enum {
+  WIFI_REASON_UNSPECIFIED = 1,
+  WIFI_REASON_AUTH_EXPIRE = 2,
+  WIFI_REASON_AUTH_LEAVE = 3,
+  WIFI_REASON_ASSOC_EXPIRE = 4,
+  WIFI_REASON_ASSOC_LEAVE = 8,
+  WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+  WIFI_REASON_BEACON_TIMEOUT = 200,
+  WIFI_REASON_NO_AP_FOUND = 201,
+  WIFI_REASON_AUTH_FAIL = 202,
+  WIFI_REASON_ASSOC_FAIL = 203,
+  WIFI_REASON_HANDSHAKE_TIMEOUT = 204,
+  WIFI_REASON_CONNECTION_FAIL = 205,
+} wifi_err_reason_t;
+
+/// @brief The data of WIFI_EVENT_SCAN_DONE.
+typedef struct {
+  uint32_t status;
+  uint8_t number;
+  uint8_t scan_id;
+} wifi_event_sta_scan_done_t;
+
+/// @brief The data of WIFI_EVENT_STA_CONNECTED.
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t channel;
+  wifi_auth_mode_t authmode;
+  uint16_t aid;
+} wifi_event_sta_connected_t;
+
+/// @brief The data of WIFI_EVENT_STA_DISCONNECTED.
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+  int8_t rssi;
+} wifi_event_sta_disconnected_t;
+
+/// @brief The data of WIFI_EVENT_AP_STACONNECTED.
+typedef struct {
+  uint8_t mac[6];
+  uint8_t aid;
+  bool is_mesh_child;
+} wifi_event_ap_staconnected_t;
+
+/// @brief The data of WIFI_EVENT_AP_STADISCONNECTED.
+typedef struct {
+  uint8_t mac[6];
+  uint8_t aid;
+  bool is_mesh_child;
+  uint16_t reason;
+} wifi_event_ap_stadisconnected_t;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* config);
+esp_err_t esp_wifi_deinit(void);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_get_mode(wifi_mode_t* mode);
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t* conf);
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t* conf);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_restore(void);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_stop(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t* config, bool block);
+esp_err_t esp_wifi_scan_stop(void);
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t* number);
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t* number, wifi_ap_record_t* ap_records);
+esp_err_t esp_wifi_clear_ap_list(void);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info);
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second);
+esp_err_t esp_wifi_get_country(wifi_country_t* country);
+
+#endif // __ESP_WIFI_H__
@@ -0,0 +1,129 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <new>
+
+#include "kernel.hh"
+
+/// @brief A semaphore: a mutex, a binary or a counting one.
+struct QueueDefinition {
+  UBaseType_t count;
+  UBaseType_t max_count;
+  /// @brief Whether the storage belongs to the caller.
+  bool is_static;
+};
+
+static_assert(sizeof(QueueDefinition) <= sizeof(StaticSemaphore_t), "The semaphore must fit its static storage");
+
+/// @brief An event group.
+struct EventGroupDef_t {
+  EventBits_t bits;
+};
+
+static SemaphoreHandle_t createSemaphore(UBaseType_t max_count, UBaseType_t initial_count, StaticSemaphore_t* buffer) {
+  if (buffer != nullptr) {
+    return new (buffer) QueueDefinition { initial_count, max_count, true };
+  }
+  return new QueueDefinition { initial_count, max_count, false };
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return createSemaphore(1, 1, nullptr);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer) {
+  return createSemaphore(1, 1, buffer);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return createSemaphore(1, 0, nullptr);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) {
+  return createSemaphore(1, 0, buffer);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+  return createSemaphore(max_count, initial_count, nullptr);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+  sim::Lock lock(sim::mutex());
+  bool taken = sim::block(lock, [semaphore]() {
+    if (semaphore->count == 0) {
+      return false;
+    }
+    --semaphore->count;
+    return true;
+  }, sim::deadlineAfter(ticks_to_wait), "semaphore");
+  return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  sim::Lock lock(sim::mutex());
+  if (semaphore->count >= semaphore->max_count) {
+    return pdFALSE;
+  }
+  ++semaphore->count;
+  sim::wake(lock);
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  if (semaphore == nullptr) {
+    return;
+  }
+  if (semaphore->is_static) {
+    semaphore->~QueueDefinition();
+  } else {
+    delete semaphore;
+  }
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+  return new EventGroupDef_t { 0 };
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+  delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+  sim::Lock lock(sim::mutex());
+  group->bits |= bits;
+  sim::wake(lock);
+  // Like FreeRTOS, the bits a woken waiter cleared on exit are already gone.
+  return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+  sim::Lock lock(sim::mutex());
+  EventBits_t previous = group->bits;
+  group->bits &= ~bits;
+  return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+  sim::Lock lock(sim::mutex());
+  return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+  BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+  sim::Lock lock(sim::mutex());
+  EventBits_t result = 0;
+  bool satisfied = sim::block(lock, [group, bits, clear_on_exit, wait_for_all, &result]() {
+    EventBits_t set = group->bits & bits;
+    if (wait_for_all ? set != bits : set == 0) {
+      return false;
+    }
+    result = group->bits;
+    if (clear_on_exit) {
+      group->bits &= ~bits;
+    }
+    return true;
+  }, sim::deadlineAfter(ticks_to_wait), "event group");
+  return satisfied ? result : group->bits;
+}
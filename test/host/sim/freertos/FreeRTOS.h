@@ -0,0 +1,38 @@
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_system.h"
+#include "sdkconfig.h"
+
+// The kernel types and constants of the ESP-IDF FreeRTOS port, with one tick per millisecond.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+#define configTICK_RATE_HZ  CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS  ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY       ((TickType_t) 0xffffffffUL)
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000U))
+
+#define pdFALSE  ((BaseType_t) 0)
+#define pdTRUE   ((BaseType_t) 1)
+#define pdPASS   pdTRUE
+#define pdFAIL   pdFALSE
+
+#define tskNO_AFFINITY    ((BaseType_t) 0x7FFFFFFF)
+#define tskIDLE_PRIORITY  ((UBaseType_t) 0U)
+
+#define BIT7  0x00000080
+#define BIT6  0x00000040
+#define BIT5  0x00000020
+#define BIT4  0x00000010
+#define BIT3  0x00000008
+#define BIT2  0x00000004
+#define BIT1  0x00000002
+#define BIT0  0x00000001
+
+#endif // INC_FREERTOS_H
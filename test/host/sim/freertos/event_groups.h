@@ -0,0 +1,19 @@
+#ifndef EVENT_GROUPS_H
+#define EVENT_GROUPS_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/// @brief The handle of an event group.
+typedef struct EventGroupDef_t* EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+  BaseType_t wait_for_all, TickType_t ticks_to_wait);
+
+#endif // EVENT_GROUPS_H
@@ -0,0 +1,26 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/// @brief The handle of a queue, of which the semaphores are a kind.
+typedef struct QueueDefinition* QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+
+/// @brief The storage of a statically allocated queue.
+typedef struct xSTATIC_QUEUE {
+  void* dummy[10];
+} StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif // SEMAPHORE_H
@@ -0,0 +1,36 @@
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+/// @brief The handle of a task, a thread of the simulation.
+typedef struct tskTaskControlBlock* TaskHandle_t;
+
+/// @brief The task function, which must never return.
+typedef void (*TaskFunction_t)(void* params);
+
+/// @brief The control block of a statically allocated task; the simulation runs the task on a host thread.
+typedef struct xSTATIC_TCB {
+  void* dummy[24];
+} StaticTask_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+  UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+  UBaseType_t priority, StackType_t* stack_buffer, StaticTask_t* task_buffer, BaseType_t core_id);
+
+static inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+  UBaseType_t priority, TaskHandle_t* created_task) {
+  return xTaskCreatePinnedToCore(function, name, stack_depth, params, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskSuspend(TaskHandle_t task);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char* name);
+/// @brief The stack of a host thread is not measured, this is always 0.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#endif // INC_TASK_H
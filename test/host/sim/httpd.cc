@@ -0,0 +1,781 @@
+#include <esp_http_server.h>
+// The stack calls its sockets by their lwip_ names, like lwIP itself.
+#define LWIP_COMPAT_SOCKETS 0
+#include <lwip/sockets.h>
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kernel.hh"
+
+// The listening socket and the two control sockets of a server.
+#define SERVER_SOCKETS 3
+
+#define CLIENT_PORT_FIRST 50000
+
+namespace {
+
+  struct Server;
+
+  /// @brief A request and its response on a connection.
+  struct Exchange {
+    httpd_method_t method;
+    std::string uri;
+    sim::Headers headers;
+    /// @brief The body the phone sent, up to content_len.
+    std::string body;
+    size_t content_len;
+    size_t body_read = 0;
+    /// @brief Whether the status line and the header fields went out.
+    bool started = false;
+    /// @brief Whether the handler is done with the request, so the phone sees the response and the connection as they are left.
+    bool delivered = false;
+    sim::HttpResponse response;
+  };
+
+  /// @brief A connection to a server.
+  struct Session {
+    Server* server;
+    int fd = -1;
+    /// @brief The address and port of the phone, in network byte order.
+    uint32_t peer;
+    uint16_t peer_port;
+    /// @brief Whether a handler or a detached request holds the session, which delays its next request.
+    bool busy = false;
+    /// @brief Whether the connection is closed, or was refused.
+    bool closed = false;
+    uint64_t lru = 0;
+  };
+
+  enum class WorkKind {
+    Open,
+    Request,
+    Call,
+    Close,
+    Stop,
+  };
+
+  struct Work {
+    WorkKind kind;
+    std::shared_ptr<Session> session;
+    std::shared_ptr<Exchange> exchange;
+    httpd_work_fn_t function;
+    void* arg;
+  };
+
+  struct Handler {
+    std::string uri;
+    httpd_method_t method;
+    esp_err_t (*function)(httpd_req_t* r);
+    void* user_ctx;
+  };
+
+  /// @brief A server.
+  struct Server {
+    httpd_config_t config;
+    std::vector<Handler> handlers;
+    std::vector<std::shared_ptr<Session>> sessions;
+    std::deque<Work> queue;
+    uint64_t lru_counter = 0;
+    bool stopping = false;
+    bool stopped = false;
+  };
+
+  /// @brief The request state behind httpd_req_t::aux.
+  struct RequestAux {
+    std::shared_ptr<Session> session;
+    std::shared_ptr<Exchange> exchange;
+    const char* status = nullptr;
+    const char* type = nullptr;
+    std::vector<std::pair<const char*, const char*>> headers;
+    /// @brief Whether the handler detached the request.
+    bool detached = false;
+  };
+
+  struct Servers {
+    std::map<uint16_t, Server*> by_port;
+    /// @brief The stopped servers, kept so that the work a phone still has in flight cannot reach a freed one.
+    std::vector<Server*> stopped;
+    uint16_t next_client_port = CLIENT_PORT_FIRST;
+  };
+
+  Servers& servers() {
+    static Servers* instance = new Servers();
+    return *instance;
+  }
+
+  RequestAux& auxOf(httpd_req_t* r) {
+    return *static_cast<RequestAux*>(r->aux);
+  }
+
+  /// @brief Hand work to the server task, with the lock held.
+  void pushWork(Server* server, Work work) {
+    if (server->stopping) {
+      if (work.session) {
+        work.session->closed = true;
+      }
+      return;
+    }
+    server->queue.push_back(std::move(work));
+  }
+
+  /// @brief Close a session on the server task, with the lock held; the callback runs without it.
+  void closeSession(sim::Lock& lock, Server* server, const std::shared_ptr<Session>& session) {
+    auto it = std::find(server->sessions.begin(), server->sessions.end(), session);
+    if (it == server->sessions.end()) {
+      return;
+    }
+    server->sessions.erase(it);
+    session->closed = true;
+    sim::wake(lock);
+    lock.unlock();
+    if (server->config.close_fn) {
+      server->config.close_fn(server, session->fd);
+    } else {
+      lwip_close(session->fd);
+    }
+    lock.lock();
+  }
+
+  void openSession(sim::Lock& lock, Server* server, const std::shared_ptr<Session>& session) {
+    if (server->sessions.size() >= server->config.max_open_sockets && server->config.lru_purge_enable) {
+      std::shared_ptr<Session> oldest;
+      for (auto& candidate : server->sessions) {
+        if (!candidate->busy && (!oldest || candidate->lru < oldest->lru)) {
+          oldest = candidate;
+        }
+      }
+      if (oldest) {
+        closeSession(lock, server, oldest);
+      }
+    }
+    int fd = server->sessions.size() < server->config.max_open_sockets ? sim::openStream(session->peer, session->peer_port) : -1;
+    if (fd < 0) {
+      session->closed = true;
+      sim::wake(lock);
+      return;
+    }
+    session->fd = fd;
+    session->lru = ++server->lru_counter;
+    server->sessions.push_back(session);
+    if (server->config.open_fn) {
+      lock.unlock();
+      esp_err_t err = server->config.open_fn(server, fd);
+      lock.lock();
+      if (err != ESP_OK) {
+        server->sessions.erase(std::find(server->sessions.begin(), server->sessions.end(), session));
+        session->closed = true;
+        sim::wake(lock);
+        lock.unlock();
+        lwip_close(fd);
+        lock.lock();
+      }
+    }
+  }
+
+  void handleRequest(sim::Lock& lock, Server* server, const std::shared_ptr<Session>& session,
+    const std::shared_ptr<Exchange>& exchange) {
+    session->busy = true;
+    session->lru = ++server->lru_counter;
+
+    // Like the IDF, the first handler matching the path wins, and a path matched with another method only is a 405.
+    size_t path_len = strcspn(exchange->uri.c_str(), "?");
+    const Handler* found = nullptr;
+    httpd_err_code_t error = HTTPD_404_NOT_FOUND;
+    for (const auto& handler : server->handlers) {
+      bool matched = server->config.uri_match_fn
+        ? server->config.uri_match_fn(handler.uri.c_str(), exchange->uri.c_str(), path_len)
+        : handler.uri.size() == path_len && strncmp(handler.uri.c_str(), exchange->uri.c_str(), path_len) == 0;
+      if (!matched) {
+        continue;
+      }
+      if (handler.method == exchange->method) {
+        found = &handler;
+        break;
+      }
+      error = HTTPD_405_METHOD_NOT_ALLOWED;
+    }
+    auto function = found ? found->function : nullptr;
+    void* user_ctx = found ? found->user_ctx : nullptr;
+
+    RequestAux aux;
+    aux.session = session;
+    aux.exchange = exchange;
+    httpd_req_t req = {};
+    req.handle = server;
+    req.method = exchange->method;
+    snprintf(const_cast<char*>(req.uri), sizeof(req.uri), "%s", exchange->uri.c_str());
+    req.content_len = exchange->content_len;
+    req.aux = &aux;
+    req.user_ctx = user_ctx;
+
+    lock.unlock();
+    esp_err_t err;
+    if (function) {
+      err = function(&req);
+    } else {
+      httpd_resp_send_err(&req, error, nullptr);
+      err = ESP_FAIL;
+    }
+    lock.lock();
+
+    if (!aux.detached) {
+      session->busy = false;
+    }
+    if (err != ESP_OK) {
+      closeSession(lock, server, session);
+    }
+    if (!aux.detached) {
+      exchange->delivered = true;
+    }
+    sim::wake(lock);
+  }
+
+  void runServer(Server* server) {
+    sim::Lock lock(sim::mutex());
+    for (;;) {
+      // A request waits for the previous one on its connection; anything else is taken in order.
+      size_t next = 0;
+      sim::block(lock, [server, &next]() {
+        for (next = 0; next < server->queue.size(); ++next) {
+          const auto& work = server->queue[next];
+          if (work.kind != WorkKind::Request || !work.session->busy) {
+            return true;
+          }
+        }
+        return false;
+      }, sim::FOREVER, "httpd work");
+      Work work = std::move(server->queue[next]);
+      server->queue.erase(server->queue.begin() + next);
+
+      switch (work.kind) {
+        case WorkKind::Open:
+          openSession(lock, server, work.session);
+          break;
+        case WorkKind::Request:
+          if (!work.session->closed) {
+            handleRequest(lock, server, work.session, work.exchange);
+          }
+          break;
+        case WorkKind::Call:
+          lock.unlock();
+          work.function(work.arg);
+          lock.lock();
+          break;
+        case WorkKind::Close:
+          closeSession(lock, server, work.session);
+          break;
+        case WorkKind::Stop:
+          while (!server->sessions.empty()) {
+            closeSession(lock, server, server->sessions.front());
+          }
+          server->stopped = true;
+          sim::wake(lock);
+          return;
+      }
+    }
+  }
+
+  const char* getStatusText(httpd_err_code_t error) {
+    switch (error) {
+      case HTTPD_500_INTERNAL_SERVER_ERROR: return "500 Internal Server Error";
+      case HTTPD_501_METHOD_NOT_IMPLEMENTED: return "501 Method Not Implemented";
+      case HTTPD_505_VERSION_NOT_SUPPORTED: return "505 Version Not Supported";
+      case HTTPD_400_BAD_REQUEST: return "400 Bad Request";
+      case HTTPD_401_UNAUTHORIZED: return "401 Unauthorized";
+      case HTTPD_403_FORBIDDEN: return "403 Forbidden";
+      case HTTPD_404_NOT_FOUND: return "404 Not Found";
+      case HTTPD_405_METHOD_NOT_ALLOWED: return "405 Method Not Allowed";
+      case HTTPD_408_REQ_TIMEOUT: return "408 Request Timeout";
+      case HTTPD_411_LENGTH_REQUIRED: return "411 Length Required";
+      case HTTPD_414_URI_TOO_LONG: return "414 URI Too Long";
+      case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE: return "431 Request Header Fields Too Large";
+      default: return "500 Internal Server Error";
+    }
+  }
+
+  /// @brief Send a piece of the response, the status line and header fields first.
+  esp_err_t sendResponse(httpd_req_t* r, const char* buf, size_t len, bool last) {
+    auto& aux = auxOf(r);
+    sim::Lock lock(sim::mutex());
+    if (aux.session->closed) {
+      return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    auto& exchange = *aux.exchange;
+    if (exchange.response.complete) {
+      return ESP_OK;
+    }
+    if (!exchange.started) {
+      exchange.started = true;
+      exchange.response.status = atoi(aux.status ? aux.status : "200");
+      exchange.response.headers.emplace_back("Content-Type", aux.type ? aux.type : "text/html");
+      for (const auto& header : aux.headers) {
+        exchange.response.headers.emplace_back(header.first, header.second);
+      }
+    }
+    exchange.response.body.append(buf != nullptr ? buf : "", buf != nullptr ? len : 0);
+    if (last) {
+      exchange.response.complete = true;
+    }
+    sim::wake(lock);
+    return ESP_OK;
+  }
+
+  const std::string* findHeader(const sim::Headers& headers, const char* field) {
+    for (const auto& header : headers) {
+      if (strcasecmp(header.first.c_str(), field) == 0) {
+        return &header.second;
+      }
+    }
+    return nullptr;
+  }
+
+  /// @brief Copy a value the IDF way: truncated to the buffer, and reported so.
+  esp_err_t copyValue(const char* value, size_t len, char* buf, size_t size) {
+    if (buf == nullptr || size == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    size_t copied = std::min(len, size - 1);
+    memcpy(buf, value, copied);
+    buf[copied] = '\0';
+    return copied < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+  }
+
+}
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config) {
+  if (handle == nullptr || config == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto& s = servers();
+  Server* server;
+  {
+    sim::Lock lock(sim::mutex());
+    if (s.by_port.count(config->server_port) != 0) {
+      return ESP_FAIL;
+    }
+    if (!sim::reserveSockets(SERVER_SOCKETS)) {
+      return ESP_ERR_HTTPD_TASK;
+    }
+    server = new Server();
+    server->config = *config;
+    s.by_port[config->server_port] = server;
+  }
+  sim::spawn("httpd", config->stack_size, [server]() { runServer(server); });
+  *handle = server;
+  return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+  auto server = static_cast<Server*>(handle);
+  if (server == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  if (server->stopping) {
+    return ESP_OK;
+  }
+  server->queue.push_back({ WorkKind::Stop, nullptr, nullptr, nullptr, nullptr });
+  server->stopping = true;
+  sim::wake(lock);
+  sim::block(lock, [server]() { return server->stopped; }, sim::FOREVER, "httpd stop");
+  servers().by_port.erase(server->config.server_port);
+  servers().stopped.push_back(server);
+  sim::releaseSockets(SERVER_SOCKETS);
+  return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler) {
+  auto server = static_cast<Server*>(handle);
+  if (server == nullptr || uri_handler == nullptr || uri_handler->uri == nullptr || uri_handler->handler == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  for (const auto& handler : server->handlers) {
+    if (handler.uri == uri_handler->uri && handler.method == uri_handler->method) {
+      return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+  }
+  if (server->handlers.size() >= server->config.max_uri_handlers) {
+    return ESP_ERR_HTTPD_HANDLERS_FULL;
+  }
+  server->handlers.push_back({ uri_handler->uri, uri_handler->method, uri_handler->handler, uri_handler->user_ctx });
+  return ESP_OK;
+}
+
+bool httpd_uri_match_wildcard(const char* uri_template, const char* uri_to_match, size_t match_upto) {
+  // The IDF implementation: a trailing '*' matches anything, a trailing '?' makes the character before it optional.
+  const size_t tpl_len = strlen(uri_template);
+  size_t exact_match_chars = tpl_len;
+  const char last = tpl_len > 0 ? uri_template[tpl_len - 1] : 0;
+  const char prevlast = tpl_len > 1 ? uri_template[tpl_len - 2] : 0;
+  const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+  const bool quest = last == '?' || (prevlast == '?' && last == '*');
+  if (exact_match_chars < static_cast<size_t>(asterisk + quest * 2)) {
+    return false;
+  }
+  exact_match_chars -= asterisk + quest * 2;
+  if (match_upto < exact_match_chars) {
+    return false;
+  }
+  if (!quest) {
+    if (!asterisk && match_upto != exact_match_chars) {
+      return false;
+    }
+    return strncmp(uri_template, uri_to_match, exact_match_chars) == 0;
+  }
+  if (match_upto > exact_match_chars && uri_template[exact_match_chars] != uri_to_match[exact_match_chars]) {
+    return false;
+  }
+  if (strncmp(uri_template, uri_to_match, exact_match_chars) != 0) {
+    return false;
+  }
+  return asterisk || match_upto <= exact_match_chars + 1;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+  if (r == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : static_cast<size_t>(buf_len);
+  return sendResponse(r, buf, len, true);
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+  if (r == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : static_cast<size_t>(buf_len);
+  // An empty chunk ends the response.
+  return sendResponse(r, buf, len, buf == nullptr || len == 0);
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status) {
+  if (r == nullptr || status == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auxOf(r).status = status;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {
+  if (r == nullptr || type == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auxOf(r).type = type;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value) {
+  if (r == nullptr || field == nullptr || value == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto& aux = auxOf(r);
+  auto server = static_cast<Server*>(r->handle);
+  if (aux.headers.size() >= server->config.max_resp_headers) {
+    return ESP_ERR_HTTPD_RESP_HDR;
+  }
+  aux.headers.emplace_back(field, value);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* req, httpd_err_code_t error, const char* msg) {
+  if (req == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const char* status = getStatusText(error);
+  httpd_resp_set_status(req, status);
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, msg ? msg : status, HTTPD_RESP_USE_STRLEN);
+}
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {
+  if (r == nullptr || buf == nullptr) {
+    return HTTPD_SOCK_ERR_INVALID;
+  }
+  auto& aux = auxOf(r);
+  auto server = static_cast<Server*>(r->handle);
+  sim::Lock lock(sim::mutex());
+  auto& exchange = *aux.exchange;
+  if (exchange.body_read >= exchange.content_len || buf_len == 0) {
+    return 0;
+  }
+  auto session = aux.session;
+  bool ready = sim::block(lock, [&exchange, &session]() {
+    return session->closed || exchange.body.size() > exchange.body_read;
+  }, sim::now() + server->config.recv_wait_timeout * 1000000ll, "httpd_req_recv");
+  if (session->closed) {
+    return HTTPD_SOCK_ERR_FAIL;
+  }
+  if (!ready) {
+    return HTTPD_SOCK_ERR_TIMEOUT;
+  }
+  size_t len = std::min({ buf_len, exchange.body.size() - exchange.body_read, exchange.content_len - exchange.body_read });
+  memcpy(buf, exchange.body.data() + exchange.body_read, len);
+  exchange.body_read += len;
+  return static_cast<int>(len);
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field) {
+  if (r == nullptr || field == nullptr) {
+    return 0;
+  }
+  auto value = findHeader(auxOf(r).exchange->headers, field);
+  return value ? value->size() : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size) {
+  if (r == nullptr || field == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto value = findHeader(auxOf(r).exchange->headers, field);
+  if (value == nullptr) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return copyValue(value->data(), value->size(), val, val_size);
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* r) {
+  if (r == nullptr) {
+    return 0;
+  }
+  const char* query = strchr(r->uri, '?');
+  return query ? strlen(query + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len) {
+  if (r == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const char* query = strchr(r->uri, '?');
+  if (query == nullptr) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return copyValue(query + 1, strlen(query + 1), buf, buf_len);
+}
+
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size) {
+  if (qry == nullptr || key == nullptr || val == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  size_t key_len = strlen(key);
+  const char* pair = qry;
+  while (*pair != '\0') {
+    size_t pair_len = strcspn(pair, "&");
+    const char* equals = static_cast<const char*>(memchr(pair, '=', pair_len));
+    if (equals != nullptr && static_cast<size_t>(equals - pair) == key_len && strncmp(pair, key, key_len) == 0) {
+      return copyValue(equals + 1, pair + pair_len - equals - 1, val, val_size);
+    }
+    pair += pair_len;
+    if (*pair == '&') {
+      ++pair;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_to_sockfd(httpd_req_t* r) {
+  return r != nullptr ? auxOf(r).session->fd : -1;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t* r, httpd_req_t** out) {
+  if (r == nullptr || out == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // Like the IDF, the copy carries the pending status and header fields along.
+  auto aux = new RequestAux(auxOf(r));
+  auto copy = new httpd_req_t(*r);
+  copy->aux = aux;
+  auxOf(r).detached = true;
+  *out = copy;
+  return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t* r) {
+  if (r == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto aux = static_cast<RequestAux*>(r->aux);
+  {
+    sim::Lock lock(sim::mutex());
+    aux->session->busy = false;
+    aux->exchange->delivered = true;
+    aux->session->lru = ++static_cast<Server*>(r->handle)->lru_counter;
+    sim::wake(lock);
+  }
+  delete aux;
+  delete r;
+  return ESP_OK;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+  auto server = static_cast<Server*>(handle);
+  if (server == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  for (const auto& session : server->sessions) {
+    if (session->fd == sockfd) {
+      if (server->stopping) {
+        return ESP_FAIL;
+      }
+      pushWork(server, { WorkKind::Close, session, nullptr, nullptr, nullptr });
+      sim::wake(lock);
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg) {
+  auto server = static_cast<Server*>(handle);
+  if (server == nullptr || work == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  if (server->stopping) {
+    return ESP_FAIL;
+  }
+  pushWork(server, { WorkKind::Call, nullptr, nullptr, work, arg });
+  sim::wake(lock);
+  return ESP_OK;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t* fds, int* client_fds) {
+  auto server = static_cast<Server*>(handle);
+  if (server == nullptr || fds == nullptr || client_fds == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  size_t count = std::min(*fds, server->sessions.size());
+  for (size_t i = 0; i < count; ++i) {
+    client_fds[i] = server->sessions[i]->fd;
+  }
+  *fds = count;
+  return ESP_OK;
+}
+
+////////////////////////////////
+// The phones
+
+namespace sim {
+
+  /// @brief A connection of a phone, and whether its last response was cut short.
+  struct HttpClient::Connection {
+    std::shared_ptr<Session> session;
+    bool stalled = false;
+  };
+
+  const char* HttpResponse::header(const char* name) const {
+    auto value = findHeader(headers, name);
+    return value ? value->c_str() : nullptr;
+  }
+
+  /// @brief Send work to the server after the latency of the air, with the lock held.
+  static void sendWork(Server* server, Work work) {
+    uint32_t latency_us = getLatency();
+    if (latency_us == 0) {
+      pushWork(server, std::move(work));
+      return;
+    }
+    schedule(now() + latency_us, [server, work = std::move(work)]() mutable {
+      pushWork(server, std::move(work));
+    });
+  }
+
+  HttpClient::HttpClient(uint32_t client, uint32_t server, uint16_t port)
+    : client(client)
+    , server(server)
+    , port(port)
+    , connection()
+    , connections(0)
+  {
+  }
+
+  HttpClient::~HttpClient() {
+    close();
+  }
+
+  HttpResponse HttpClient::get(const std::string& uri, const Headers& headers, uint32_t timeout_ms) {
+    return request(HTTP_GET, uri, headers, "", timeout_ms, 0);
+  }
+
+  HttpResponse HttpClient::post(const std::string& uri, const std::string& body, const Headers& headers,
+    uint32_t timeout_ms) {
+    return request(HTTP_POST, uri, headers, body, timeout_ms, body.size());
+  }
+
+  HttpResponse HttpClient::request(httpd_method_t method, const std::string& uri, const Headers& headers,
+    const std::string& body, uint32_t timeout_ms, size_t content_len) {
+    // A browser gives up on a connection whose response it stopped waiting for.
+    if (connection && connection->stalled) {
+      close();
+    }
+
+    Lock lock(mutex());
+    auto it = servers().by_port.find(port);
+    Server* target = it != servers().by_port.end() ? it->second : nullptr;
+    if (!connection || connection->session->closed) {
+      connection = std::make_shared<Connection>();
+      auto session = std::make_shared<Session>();
+      session->server = target;
+      session->peer = client;
+      auto& s = servers();
+      session->peer_port = htons(s.next_client_port);
+      s.next_client_port = s.next_client_port == UINT16_MAX ? CLIENT_PORT_FIRST : s.next_client_port + 1;
+      connection->session = session;
+      ++connections;
+      if (target == nullptr) {
+        session->closed = true;
+      } else {
+        sendWork(target, { WorkKind::Open, session, nullptr, nullptr, nullptr });
+      }
+    }
+    auto session = connection->session;
+
+    auto exchange = std::make_shared<Exchange>();
+    exchange->method = method;
+    exchange->uri = uri;
+    exchange->headers = headers;
+    exchange->body = body.substr(0, std::max(content_len, body.size()));
+    exchange->content_len = std::max(content_len, body.size());
+    if (!session->closed) {
+      sendWork(session->server, { WorkKind::Request, session, exchange, nullptr, nullptr });
+    }
+    wake(lock);
+    block(lock, [&exchange, &session]() { return exchange->delivered || session->closed; },
+      now() + static_cast<int64_t>(timeout_ms) * 1000, "http response");
+
+    HttpResponse response = exchange->response;
+    response.closed = session->closed;
+    connection->stalled = !response.complete && !response.closed;
+    // The response takes the air back to the phone.
+    uint32_t latency_us = getLatency();
+    if (latency_us > 0) {
+      block(lock, []() { return false; }, now() + latency_us, "http latency");
+    }
+    return response;
+  }
+
+  void HttpClient::close() {
+    Lock lock(mutex());
+    if (connection && !connection->session->closed) {
+      sendWork(connection->session->server, { WorkKind::Close, connection->session, nullptr, nullptr, nullptr });
+      wake(lock);
+    }
+    connection.reset();
+  }
+
+  uint32_t HttpClient::getConnectionCount() const {
+    return connections;
+  }
+
+}
@@ -0,0 +1,292 @@
+#include "kernel.hh"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The virtual time past which a test is considered stuck, e.g. polling for something that never comes.
+#define TIME_LIMIT_US (3600ll * 1000000)
+
+namespace sim {
+
+  namespace {
+
+    /// @brief A task waiting for a condition.
+    struct Waiter {
+      const std::function<bool()>* ready;
+      int64_t deadline;
+      TaskHandle_t task;
+      bool woken;
+      bool satisfied;
+    };
+
+    struct Kernel {
+      std::mutex mutex;
+      std::condition_variable condition;
+      /// @brief The virtual time in microseconds.
+      int64_t now = 0;
+      /// @brief The number of tasks not waiting.
+      int running = 1;
+      /// @brief Whether wake() is running, so that the actions it runs do not call it again.
+      bool waking = false;
+      std::vector<Waiter*> waiters;
+      /// @brief The scheduled actions by time, then by order of scheduling.
+      std::map<std::pair<int64_t, uint64_t>, std::function<void()>> actions;
+      std::unordered_map<uint64_t, int64_t> action_times;
+      uint64_t next_action = 1;
+      std::vector<TaskHandle_t> tasks;
+      tskTaskControlBlock main_task = { "main", 0, false, false, nullptr };
+    };
+
+    /// @brief The kernel, never destroyed, as tasks may still wait on it when the process exits.
+    Kernel& kernel() {
+      static Kernel* instance = new Kernel();
+      return *instance;
+    }
+
+    thread_local TaskHandle_t current_task = nullptr;
+
+    [[noreturn]] void abortStuck(Kernel& k, const char* why) {
+      fprintf(stderr, "sim: %s at %lld ms, the tasks wait for:\n", why, static_cast<long long>(k.now / 1000));
+      std::vector<TaskHandle_t> tasks = { &k.main_task };
+      tasks.insert(tasks.end(), k.tasks.begin(), k.tasks.end());
+      for (auto task : tasks) {
+        if (!task->exited) {
+          fprintf(stderr, "  %s: %s\n", task->name.c_str(), task->waiting ? task->waiting : "(running)");
+        }
+      }
+      abort();
+    }
+
+  }
+
+  std::mutex& mutex() {
+    return kernel().mutex;
+  }
+
+  int64_t now() {
+    return kernel().now;
+  }
+
+  int64_t deadlineAfter(TickType_t ticks) {
+    if (ticks == portMAX_DELAY) {
+      return FOREVER;
+    }
+    return kernel().now + static_cast<int64_t>(ticks) * 1000000 / configTICK_RATE_HZ;
+  }
+
+  bool block(Lock& lock, const std::function<bool()>& ready, int64_t deadline, const char* waiting) {
+    auto& k = kernel();
+    TaskHandle_t task = currentTask();
+    if (task->deleted) {
+      throw TaskExit();
+    }
+    if (ready()) {
+      return true;
+    }
+    if (deadline <= k.now) {
+      return false;
+    }
+
+    Waiter waiter = { &ready, deadline, task, false, false };
+    k.waiters.push_back(&waiter);
+    task->waiting = waiting;
+    --k.running;
+    wake(lock);
+    k.condition.wait(lock, [&waiter]() { return waiter.woken; });
+    task->waiting = nullptr;
+    k.waiters.erase(std::find(k.waiters.begin(), k.waiters.end(), &waiter));
+    if (task->deleted) {
+      throw TaskExit();
+    }
+    return waiter.satisfied;
+  }
+
+  void wake(Lock& lock) {
+    auto& k = kernel();
+    // An action calling back here is followed by a new pass of the loop below anyway.
+    if (k.waking) {
+      return;
+    }
+    k.waking = true;
+    bool woken = false;
+    for (;;) {
+      for (auto waiter : k.waiters) {
+        if (waiter->woken) {
+          continue;
+        }
+        if (waiter->task->deleted) {
+          waiter->woken = true;
+        } else if ((*waiter->ready)()) {
+          waiter->woken = true;
+          waiter->satisfied = true;
+        } else if (waiter->deadline <= k.now) {
+          waiter->woken = true;
+        }
+        if (waiter->woken) {
+          ++k.running;
+          woken = true;
+        }
+      }
+      if (k.running > 0) {
+        break;
+      }
+
+      // Everyone waits: move on to the nearest deadline or action.
+      int64_t next = FOREVER;
+      for (auto waiter : k.waiters) {
+        next = std::min(next, waiter->deadline);
+      }
+      if (!k.actions.empty()) {
+        next = std::min(next, k.actions.begin()->first.first);
+      }
+      if (next == FOREVER) {
+        abortStuck(k, "deadlock");
+      }
+      if (next > TIME_LIMIT_US) {
+        abortStuck(k, "time limit reached");
+      }
+      k.now = std::max(k.now, next);
+      while (!k.actions.empty() && k.actions.begin()->first.first <= k.now) {
+        auto it = k.actions.begin();
+        auto action = std::move(it->second);
+        k.action_times.erase(it->first.second);
+        k.actions.erase(it);
+        action();
+      }
+    }
+    k.waking = false;
+    if (woken) {
+      k.condition.notify_all();
+    }
+  }
+
+  uint64_t schedule(int64_t at, std::function<void()> action) {
+    auto& k = kernel();
+    uint64_t id = k.next_action++;
+    k.actions.emplace(std::make_pair(at, id), std::move(action));
+    k.action_times.emplace(id, at);
+    return id;
+  }
+
+  void cancel(uint64_t id) {
+    auto& k = kernel();
+    auto it = k.action_times.find(id);
+    if (it != k.action_times.end()) {
+      k.actions.erase(std::make_pair(it->second, id));
+      k.action_times.erase(it);
+    }
+  }
+
+  TaskHandle_t spawn(const char* name, uint32_t stack_size, std::function<void()> body) {
+    auto& k = kernel();
+    auto task = new tskTaskControlBlock { name, stack_size, false, false, nullptr };
+    {
+      Lock lock(k.mutex);
+      k.tasks.push_back(task);
+      ++k.running;
+    }
+    std::thread([task, body = std::move(body)]() {
+      current_task = task;
+      try {
+        body();
+      } catch (const TaskExit&) {
+      }
+      auto& k = kernel();
+      Lock lock(k.mutex);
+      task->exited = true;
+      --k.running;
+      wake(lock);
+    }).detach();
+    return task;
+  }
+
+  TaskHandle_t currentTask() {
+    return current_task != nullptr ? current_task : &kernel().main_task;
+  }
+
+}
+
+////////////////////////////////
+// FreeRTOS tasks
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+  UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id) {
+  TaskHandle_t task = sim::spawn(name, stack_depth, [function, params, name = std::string(name)]() {
+    function(params);
+    fprintf(stderr, "sim: the task %s returned, a FreeRTOS task must delete itself\n", name.c_str());
+    abort();
+  });
+  if (created_task != nullptr) {
+    *created_task = task;
+  }
+  return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+  UBaseType_t priority, StackType_t* stack_buffer, StaticTask_t* task_buffer, BaseType_t core_id) {
+  if (stack_buffer == nullptr || task_buffer == nullptr) {
+    return nullptr;
+  }
+  TaskHandle_t task = nullptr;
+  xTaskCreatePinnedToCore(function, name, stack_depth, params, priority, &task, core_id);
+  return task;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  TaskHandle_t current = sim::currentTask();
+  if (task == nullptr || task == current) {
+    if (current == &sim::kernel().main_task) {
+      fprintf(stderr, "sim: the main task cannot delete itself\n");
+      abort();
+    }
+    throw sim::TaskExit();
+  }
+  sim::Lock lock(sim::mutex());
+  task->deleted = true;
+  sim::wake(lock);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  sim::Lock lock(sim::mutex());
+  sim::block(lock, []() { return false; }, sim::deadlineAfter(ticks), "delay");
+}
+
+void vTaskSuspend(TaskHandle_t task) {
+  if (task != nullptr && task != sim::currentTask()) {
+    fprintf(stderr, "sim: only a task suspending itself is supported\n");
+    abort();
+  }
+  sim::Lock lock(sim::mutex());
+  sim::block(lock, []() { return false; }, sim::FOREVER, "suspended");
+}
+
+TickType_t xTaskGetTickCount(void) {
+  sim::Lock lock(sim::mutex());
+  return static_cast<TickType_t>(sim::now() * configTICK_RATE_HZ / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  return sim::currentTask();
+}
+
+TaskHandle_t xTaskGetHandle(const char* name) {
+  auto& k = sim::kernel();
+  sim::Lock lock(k.mutex);
+  for (auto task : k.tasks) {
+    if (!task->exited && !task->deleted && task->name == name) {
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 0;
+}
@@ -0,0 +1,120 @@
+#ifndef __SIM_KERNEL_HH__
+#define __SIM_KERNEL_HH__
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+
+#include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sim.hh"
+
+/// @brief A task, run on a host thread of its own.
+struct tskTaskControlBlock {
+  /// @brief The task name.
+  std::string name;
+  /// @brief The stack size asked for, in bytes.
+  uint32_t stack_size;
+  /// @brief Whether vTaskDelete() was called on the task, which ends it at its next wait.
+  bool deleted;
+  /// @brief Whether the thread of the task ended.
+  bool exited;
+  /// @brief What the task waits for, for the deadlock report.
+  const char* waiting;
+};
+
+// The scheduler of the simulation. Tasks run concurrently like on two cores, and the virtual
+// time only moves when all of them wait: it jumps to the nearest deadline, and runs the actions
+// scheduled up to it, such as the alarms of the timers and the steps of the radio.
+//
+// A single lock guards the kernel and every simulated driver. The component is never called
+// with it held: the event handlers, timer callbacks and URI handlers run on their tasks without it.
+namespace sim {
+
+  typedef std::unique_lock<std::mutex> Lock;
+
+  /// @brief The deadline of a wait without a timeout.
+  constexpr int64_t FOREVER = std::numeric_limits<int64_t>::max();
+
+  /// @brief Thrown in a deleted task at its next wait, to unwind its thread.
+  struct TaskExit {};
+
+  /// @brief Get the lock of the simulation.
+  std::mutex& mutex();
+
+  /// @brief Get the virtual time, with the lock held.
+  /// @return The time since start-up in microseconds.
+  int64_t now();
+
+  /// @brief Get the deadline of a wait of a number of ticks, with the lock held.
+  int64_t deadlineAfter(TickType_t ticks);
+
+  /// @brief Wait until a condition holds, with the lock held.
+  /// The condition is checked with the lock held whenever the state may have changed, and takes
+  /// what it waits for when it holds, e.g. decrements a semaphore, so that no other task can.
+  /// @param ready The condition, which must not take the lock.
+  /// @param deadline The virtual time to give up at, or FOREVER.
+  /// @param waiting What the task waits for, for the deadlock report.
+  /// @return True if the condition held, false on timeout.
+  bool block(Lock& lock, const std::function<bool()>& ready, int64_t deadline, const char* waiting);
+
+  /// @brief Check the waiting tasks after a change of state, with the lock held.
+  void wake(Lock& lock);
+
+  /// @brief Run an action at a virtual time, with the lock held.
+  /// The action runs with the lock held, and must not wait.
+  /// @return The identifier of the action.
+  uint64_t schedule(int64_t at, std::function<void()> action);
+
+  /// @brief Cancel a scheduled action, with the lock held; an action already run is ignored.
+  void cancel(uint64_t id);
+
+  /// @brief Start a task, without the lock held.
+  /// @param body The task body; it ends the task when it returns or throws TaskExit.
+  TaskHandle_t spawn(const char* name, uint32_t stack_size, std::function<void()> body);
+
+  /// @brief Get the task of the calling thread, the main task on the main thread.
+  TaskHandle_t currentTask();
+
+  ////////////////////////////////
+  // Between the simulated drivers, all with the lock held.
+
+  /// @brief Queue an event on the default event loop; dropped if there is no loop.
+  void postEvent(esp_event_base_t base, int32_t id, const void* data, size_t size);
+
+  /// @brief Bring the station interface up on an association.
+  void stationLinkUp(const AccessPoint& ap);
+
+  /// @brief Bring the station interface down on a disconnection.
+  void stationLinkDown();
+
+  /// @brief Lease an address from the DHCP server of the access point interface.
+  /// @return The address in network byte order, or 0 if the server is not running.
+  uint32_t leaseStationAddress(uint16_t index);
+
+  /// @brief Get the address the device sends from on a socket bound to all interfaces.
+  uint32_t getLocalAddress();
+
+  /// @brief Get the time a phone packet takes to reach the device, in microseconds.
+  uint32_t getLatency();
+
+  /// @brief Open the socket of a connection accepted by the web server.
+  /// @param peer The address of the phone in network byte order.
+  /// @param peer_port The port of the phone in network byte order.
+  /// @return The descriptor, or -1 if the device is out of sockets.
+  int openStream(uint32_t peer, uint16_t peer_port);
+
+  /// @brief Reserve sockets for the listening and control sockets of a web server.
+  /// @return True if the device had them free.
+  bool reserveSockets(int count);
+
+  /// @brief Release reserved sockets.
+  void releaseSockets(int count);
+
+}
+
+#endif // __SIM_KERNEL_HH__
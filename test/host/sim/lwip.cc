@@ -0,0 +1,387 @@
+// The stack calls its sockets by their lwip_ names, like lwIP itself.
+#define LWIP_COMPAT_SOCKETS 0
+#include <lwip/sockets.h>
+#include <sdkconfig.h>
+
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "kernel.hh"
+
+#define EPHEMERAL_PORT_FIRST 49152
+
+namespace {
+
+  struct Datagram {
+    /// @brief The address and port of the sender, in network byte order.
+    uint32_t addr;
+    uint16_t port;
+    std::vector<uint8_t> data;
+  };
+
+  struct Socket {
+    int type;
+    /// @brief The bound address and port in network byte order, port 0 until bound.
+    uint32_t addr;
+    uint16_t port;
+    /// @brief The peer of a stream, in network byte order.
+    uint32_t peer;
+    uint16_t peer_port;
+    std::deque<Datagram> queue;
+    /// @brief The receive timeout in microseconds, 0 for none.
+    int64_t recv_timeout_us;
+    bool closed;
+  };
+
+  struct Stack {
+    /// @brief The sockets of the device by descriptor.
+    std::map<int, std::shared_ptr<Socket>> sockets;
+    /// @brief The sockets of the phones, outside the socket budget of the device.
+    std::vector<std::shared_ptr<Socket>> external;
+    /// @brief The device sockets in use, including the reserved ones.
+    int used = 0;
+    uint16_t next_port = EPHEMERAL_PORT_FIRST;
+  };
+
+  Stack& stack() {
+    static Stack* instance = new Stack();
+    return *instance;
+  }
+
+  int allocate(std::shared_ptr<Socket> socket) {
+    auto& s = stack();
+    if (s.used >= CONFIG_LWIP_MAX_SOCKETS) {
+      return -1;
+    }
+    int fd = LWIP_SOCKET_OFFSET;
+    while (s.sockets.count(fd) != 0) {
+      ++fd;
+    }
+    s.sockets[fd] = std::move(socket);
+    ++s.used;
+    return fd;
+  }
+
+  Socket* find(int fd) {
+    auto& s = stack();
+    auto it = s.sockets.find(fd);
+    return it != s.sockets.end() ? it->second.get() : nullptr;
+  }
+
+  bool portInUse(uint16_t port, uint32_t addr) {
+    auto& s = stack();
+    auto conflicts = [port, addr](const std::shared_ptr<Socket>& socket) {
+      return socket->type == SOCK_DGRAM && socket->port == port
+        && (socket->addr == addr || socket->addr == INADDR_ANY || addr == INADDR_ANY);
+    };
+    return std::any_of(s.sockets.begin(), s.sockets.end(), [&conflicts](const auto& entry) { return conflicts(entry.second); })
+      || std::any_of(s.external.begin(), s.external.end(), conflicts);
+  }
+
+  uint16_t ephemeralPort(uint32_t addr) {
+    auto& s = stack();
+    for (;;) {
+      uint16_t port = htons(s.next_port);
+      s.next_port = s.next_port == UINT16_MAX ? EPHEMERAL_PORT_FIRST : s.next_port + 1;
+      if (!portInUse(port, addr)) {
+        return port;
+      }
+    }
+  }
+
+  /// @brief Deliver a datagram to the socket bound to its destination, after the latency of the air.
+  void deliver(uint32_t from, uint16_t from_port, uint32_t to, uint16_t to_port, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    Datagram datagram = { from, from_port, std::vector<uint8_t>(bytes, bytes + size) };
+    auto arrive = [datagram = std::move(datagram), to, to_port]() {
+      auto& s = stack();
+      auto bound = [to, to_port](const std::shared_ptr<Socket>& socket) {
+        return socket->type == SOCK_DGRAM && !socket->closed && socket->port == to_port
+          && (socket->addr == to || socket->addr == INADDR_ANY);
+      };
+      for (auto& entry : s.sockets) {
+        if (bound(entry.second)) {
+          entry.second->queue.push_back(datagram);
+          return;
+        }
+      }
+      for (auto& socket : s.external) {
+        if (bound(socket)) {
+          socket->queue.push_back(datagram);
+          return;
+        }
+      }
+    };
+    uint32_t latency_us = sim::getLatency();
+    if (latency_us == 0) {
+      arrive();
+    } else {
+      sim::schedule(sim::now() + latency_us, std::move(arrive));
+    }
+  }
+
+  int fail(int error) {
+    errno = error;
+    return -1;
+  }
+
+}
+
+namespace sim {
+
+  int openStream(uint32_t peer, uint16_t peer_port) {
+    auto socket = std::make_shared<Socket>();
+    socket->type = SOCK_STREAM;
+    socket->addr = getLocalAddress();
+    socket->port = htons(80);
+    socket->peer = peer;
+    socket->peer_port = peer_port;
+    return allocate(std::move(socket));
+  }
+
+  bool reserveSockets(int count) {
+    auto& s = stack();
+    if (s.used + count > CONFIG_LWIP_MAX_SOCKETS) {
+      return false;
+    }
+    s.used += count;
+    return true;
+  }
+
+  void releaseSockets(int count) {
+    stack().used -= count;
+  }
+
+  int exchangeDatagram(uint32_t from, uint32_t to, uint16_t port, const uint8_t* request, size_t len,
+    uint8_t* reply, size_t size, uint32_t timeout_ms) {
+    Lock lock(mutex());
+    auto& s = stack();
+    auto socket = std::make_shared<Socket>();
+    socket->type = SOCK_DGRAM;
+    socket->addr = from;
+    socket->port = ephemeralPort(from);
+    s.external.push_back(socket);
+
+    deliver(from, socket->port, to, htons(port), request, len);
+    wake(lock);
+    bool received = block(lock, [&socket]() { return !socket->queue.empty(); },
+      now() + static_cast<int64_t>(timeout_ms) * 1000, "datagram reply");
+
+    int result = -1;
+    if (received) {
+      auto& datagram = socket->queue.front();
+      result = static_cast<int>(std::min(size, datagram.data.size()));
+      memcpy(reply, datagram.data.data(), result);
+    }
+    s.external.erase(std::find(s.external.begin(), s.external.end(), socket));
+    return result;
+  }
+
+}
+
+int lwip_socket(int domain, int type, int protocol) {
+  if (domain != AF_INET || type != SOCK_DGRAM) {
+    return fail(EAFNOSUPPORT);
+  }
+  sim::Lock lock(sim::mutex());
+  auto socket = std::make_shared<Socket>();
+  socket->type = type;
+  int fd = allocate(std::move(socket));
+  return fd >= 0 ? fd : fail(ENFILE);
+}
+
+int lwip_bind(int s, const struct sockaddr* name, socklen_t namelen) {
+  if (name == nullptr || namelen < sizeof(sockaddr_in) || name->sa_family != AF_INET) {
+    return fail(EINVAL);
+  }
+  sim::Lock lock(sim::mutex());
+  Socket* socket = find(s);
+  if (socket == nullptr) {
+    return fail(EBADF);
+  }
+  auto addr = reinterpret_cast<const sockaddr_in*>(name);
+  if (socket->port != 0) {
+    return fail(EINVAL);
+  }
+  uint16_t port = addr->sin_port;
+  if (port == 0) {
+    port = ephemeralPort(addr->sin_addr.s_addr);
+  } else if (portInUse(port, addr->sin_addr.s_addr)) {
+    return fail(EADDRINUSE);
+  }
+  socket->addr = addr->sin_addr.s_addr;
+  socket->port = port;
+  return 0;
+}
+
+static int getAddress(uint32_t ip, uint16_t port, struct sockaddr* name, socklen_t* namelen) {
+  if (name == nullptr || namelen == nullptr) {
+    return fail(EINVAL);
+  }
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = ip;
+  addr.sin_port = port;
+  memcpy(name, &addr, std::min<size_t>(*namelen, sizeof(addr)));
+  *namelen = sizeof(addr);
+  return 0;
+}
+
+int lwip_getsockname(int s, struct sockaddr* name, socklen_t* namelen) {
+  sim::Lock lock(sim::mutex());
+  Socket* socket = find(s);
+  if (socket == nullptr) {
+    return fail(EBADF);
+  }
+  return getAddress(socket->addr, socket->port, name, namelen);
+}
+
+int lwip_getpeername(int s, struct sockaddr* name, socklen_t* namelen) {
+  sim::Lock lock(sim::mutex());
+  Socket* socket = find(s);
+  if (socket == nullptr) {
+    return fail(EBADF);
+  }
+  if (socket->type != SOCK_STREAM) {
+    return fail(ENOTCONN);
+  }
+  return getAddress(socket->peer, socket->peer_port, name, namelen);
+}
+
+int lwip_setsockopt(int s, int level, int optname, const void* optval, socklen_t optlen) {
+  sim::Lock lock(sim::mutex());
+  Socket* socket = find(s);
+  if (socket == nullptr) {
+    return fail(EBADF);
+  }
+  if (level == SOL_SOCKET && optname == SO_RCVTIMEO) {
+    if (optval == nullptr || optlen < sizeof(timeval)) {
+      return fail(EINVAL);
+    }
+    auto timeout = static_cast<const timeval*>(optval);
+    socket->recv_timeout_us = timeout->tv_sec * 1000000ll + timeout->tv_usec;
+  }
+  return 0;
+}
+
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout) {
+  sim::Lock lock(sim::mutex());
+  std::vector<int> fds;
+  for (int fd = LWIP_SOCKET_OFFSET; fd < maxfdp1; ++fd) {
+    if (readset != nullptr && FD_ISSET(fd, readset)) {
+      if (find(fd) == nullptr) {
+        return fail(EBADF);
+      }
+      fds.push_back(fd);
+    }
+  }
+  int64_t deadline = timeout != nullptr
+    ? sim::now() + timeout->tv_sec * 1000000ll + timeout->tv_usec
+    : sim::FOREVER;
+  sim::block(lock, [&fds]() {
+    return std::any_of(fds.begin(), fds.end(), [](int fd) {
+      Socket* socket = find(fd);
+      return socket == nullptr || !socket->queue.empty();
+    });
+  }, deadline, "select");
+
+  // A socket closed meanwhile reads as ready, its read fails.
+  int ready = 0;
+  for (int fd : fds) {
+    Socket* socket = find(fd);
+    if (socket == nullptr || !socket->queue.empty()) {
+      ++ready;
+    } else {
+      FD_CLR(fd, readset);
+    }
+  }
+  if (writeset != nullptr) {
+    FD_ZERO(writeset);
+  }
+  if (exceptset != nullptr) {
+    FD_ZERO(exceptset);
+  }
+  return ready;
+}
+
+ssize_t lwip_recvfrom(int s, void* mem, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen) {
+  sim::Lock lock(sim::mutex());
+  Socket* socket = find(s);
+  if (socket == nullptr) {
+    return fail(EBADF);
+  }
+  if (socket->queue.empty()) {
+    if (flags & MSG_DONTWAIT) {
+      return fail(EWOULDBLOCK);
+    }
+    int64_t deadline = socket->recv_timeout_us > 0 ? sim::now() + socket->recv_timeout_us : sim::FOREVER;
+    bool received = sim::block(lock, [s]() {
+      Socket* socket = find(s);
+      return socket == nullptr || !socket->queue.empty();
+    }, deadline, "recvfrom");
+    socket = find(s);
+    if (socket == nullptr) {
+      return fail(EBADF);
+    }
+    if (!received) {
+      return fail(EAGAIN);
+    }
+  }
+  Datagram datagram = std::move(socket->queue.front());
+  socket->queue.pop_front();
+  size_t size = std::min(len, datagram.data.size());
+  memcpy(mem, datagram.data.data(), size);
+  if (from != nullptr && fromlen != nullptr) {
+    getAddress(datagram.addr, datagram.port, from, fromlen);
+  }
+  return static_cast<ssize_t>(size);
+}
+
+ssize_t lwip_sendto(int s, const void* dataptr, size_t size, int flags, const struct sockaddr* to, socklen_t tolen) {
+  if (to == nullptr || tolen < sizeof(sockaddr_in) || to->sa_family != AF_INET) {
+    return fail(EINVAL);
+  }
+  sim::Lock lock(sim::mutex());
+  Socket* socket = find(s);
+  if (socket == nullptr) {
+    return fail(EBADF);
+  }
+  if (socket->port == 0) {
+    socket->addr = INADDR_ANY;
+    socket->port = ephemeralPort(INADDR_ANY);
+  }
+  auto addr = reinterpret_cast<const sockaddr_in*>(to);
+  uint32_t from = socket->addr != INADDR_ANY ? socket->addr : sim::getLocalAddress();
+  deliver(from, socket->port, addr->sin_addr.s_addr, addr->sin_port, dataptr, size);
+  sim::wake(lock);
+  return static_cast<ssize_t>(size);
+}
+
+int lwip_close(int s) {
+  sim::Lock lock(sim::mutex());
+  auto& st = stack();
+  auto it = st.sockets.find(s);
+  if (it == st.sockets.end()) {
+    return fail(EBADF);
+  }
+  it->second->closed = true;
+  st.sockets.erase(it);
+  --st.used;
+  sim::wake(lock);
+  return 0;
+}
+
+// The component closes its sockets with close(), like on the device where the VFS routes the
+// lwIP descriptors to lwip_close(); the descriptors of the host process pass through.
+extern "C" int close(int fd) {
+  if (fd >= LWIP_SOCKET_OFFSET) {
+    return lwip_close(fd);
+  }
+  return static_cast<int>(syscall(SYS_close, fd));
+}
@@ -0,0 +1,21 @@
+#ifndef LWIP_HDR_DHCP_H
+#define LWIP_HDR_DHCP_H
+
+#include "lwip/netif.h"
+
+/// @brief The DHCP client state of an interface.
+struct dhcp {
+  uint32_t offered_t0_lease;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dhcp* netif_dhcp_data(struct netif* netif);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LWIP_HDR_DHCP_H
@@ -0,0 +1,20 @@
+#ifndef LWIP_HDR_NETIF_ETHARP_H
+#define LWIP_HDR_NETIF_ETHARP_H
+
+#include <sys/types.h>
+
+#include "lwip/netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+err_t etharp_request(struct netif* netif, const ip4_addr_t* ipaddr);
+ssize_t etharp_find_addr(struct netif* netif, const ip4_addr_t* ipaddr, struct eth_addr** eth_ret,
+  const ip4_addr_t** ip_ret);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LWIP_HDR_NETIF_ETHARP_H
@@ -0,0 +1,6 @@
+#ifndef LWIP_HDR_INET_H
+#define LWIP_HDR_INET_H
+
+#include <arpa/inet.h>
+
+#endif // LWIP_HDR_INET_H
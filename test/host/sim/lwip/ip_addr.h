@@ -0,0 +1,17 @@
+#ifndef LWIP_HDR_IP_ADDR_H
+#define LWIP_HDR_IP_ADDR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Parse an IPv4 address in dotted decimal, in network byte order.
+uint32_t ipaddr_addr(const char* cp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LWIP_HDR_IP_ADDR_H
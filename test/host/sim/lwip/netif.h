@@ -0,0 +1,33 @@
+#ifndef LWIP_HDR_NETIF_H
+#define LWIP_HDR_NETIF_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK   0
+#define ERR_MEM  -1
+#define ERR_ARG  -16
+
+#define NETIF_MAX_HWADDR_LEN 6U
+
+/// @brief An IPv4 address, in network byte order.
+struct ip4_addr {
+  uint32_t addr;
+};
+typedef struct ip4_addr ip4_addr_t;
+
+/// @brief An Ethernet address.
+struct eth_addr {
+  uint8_t addr[6];
+};
+
+/// @brief The lwIP side of an interface.
+struct netif {
+  uint8_t hwaddr[NETIF_MAX_HWADDR_LEN];
+  uint8_t hwaddr_len;
+  ip4_addr_t ip_addr;
+  void* state;
+};
+
+#endif // LWIP_HDR_NETIF_H
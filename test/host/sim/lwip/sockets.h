@@ -0,0 +1,55 @@
+#ifndef LWIP_HDR_SOCKETS_H
+#define LWIP_HDR_SOCKETS_H
+
+// The sockets of the simulated stack. The descriptors start at
+// LWIP_SOCKET_OFFSET, above anything the host process opens, and the BSD
+// names map onto the lwip_* calls like LWIP_COMPAT_SOCKETS does on the device.
+// close() is not a macro, as in lwIP with the VFS: the simulation interposes
+// it and passes the host descriptors through.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define LWIP_SOCKET_OFFSET 900
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lwip_socket(int domain, int type, int protocol);
+int lwip_bind(int s, const struct sockaddr* name, socklen_t namelen);
+int lwip_getsockname(int s, struct sockaddr* name, socklen_t* namelen);
+int lwip_getpeername(int s, struct sockaddr* name, socklen_t* namelen);
+int lwip_setsockopt(int s, int level, int optname, const void* optval, socklen_t optlen);
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout);
+ssize_t lwip_recvfrom(int s, void* mem, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen);
+ssize_t lwip_sendto(int s, const void* dataptr, size_t size, int flags, const struct sockaddr* to, socklen_t tolen);
+int lwip_close(int s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifndef LWIP_COMPAT_SOCKETS
+#define LWIP_COMPAT_SOCKETS 1
+#endif
+
+#if LWIP_COMPAT_SOCKETS
+#define socket(domain, type, protocol) lwip_socket(domain, type, protocol)
+#define bind(s, name, namelen) lwip_bind(s, name, namelen)
+#define getsockname(s, name, namelen) lwip_getsockname(s, name, namelen)
+#define getpeername(s, name, namelen) lwip_getpeername(s, name, namelen)
+#define setsockopt(s, level, optname, opval, optlen) lwip_setsockopt(s, level, optname, opval, optlen)
+#define select(maxfdp1, readset, writeset, exceptset, timeout) lwip_select(maxfdp1, readset, writeset, exceptset, timeout)
+#define recvfrom(s, mem, len, flags, from, fromlen) lwip_recvfrom(s, mem, len, flags, from, fromlen)
+#define sendto(s, dataptr, size, flags, to, tolen) lwip_sendto(s, dataptr, size, flags, to, tolen)
+#endif
+
+#endif // LWIP_HDR_SOCKETS_H
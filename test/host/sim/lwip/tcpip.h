@@ -0,0 +1,24 @@
+#ifndef LWIP_HDR_TCPIP_H
+#define LWIP_HDR_TCPIP_H
+
+#include "lwip/netif.h"
+
+/// @brief The header of a call into the TCP/IP thread.
+struct tcpip_api_call_data {
+  err_t err;
+};
+
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data* call);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Run a function with the stack locked.
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data* call);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LWIP_HDR_TCPIP_H
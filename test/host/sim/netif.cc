@@ -0,0 +1,406 @@
+#include <esp_mac.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+
+#include <lwip/dhcp.h>
+#include <lwip/etharp.h>
+#include <lwip/inet.h>
+#include <lwip/ip_addr.h>
+#include <lwip/tcpip.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "kernel.hh"
+
+#define ARP_TABLE_SIZE 10
+
+/// @brief An ARP table entry.
+struct ArpEntry {
+  ip4_addr_t ip;
+  struct eth_addr eth;
+  bool used;
+};
+
+/// @brief An interface, with its lwIP side and its DHCP client or server.
+struct esp_netif_obj {
+  std::string key;
+  bool is_ap;
+  esp_netif_ip_info_t ip_info;
+  esp_netif_dns_info_t dns[ESP_NETIF_DNS_MAX];
+  /// @brief Whether the DHCP client (station) or server (access point) runs.
+  bool dhcp_started;
+  struct netif lwip;
+  struct dhcp dhcp;
+  /// @brief Whether the station is associated.
+  bool link_up;
+  /// @brief The access point the station is associated with.
+  sim::AccessPoint ap;
+  /// @brief The pending DHCP exchange, 0 for none.
+  uint64_t lease_action;
+  /// @brief The last address announced with IP_EVENT_STA_GOT_IP.
+  uint32_t last_ip;
+  /// @brief The captive portal URI the DHCP server advertises.
+  std::string captive_uri;
+  ArpEntry arp[ARP_TABLE_SIZE];
+};
+
+namespace {
+
+  std::map<std::string, esp_netif_t*>& interfaces() {
+    static auto instance = new std::map<std::string, esp_netif_t*>();
+    return *instance;
+  }
+
+  esp_netif_t* find(const char* key) {
+    auto& all = interfaces();
+    auto it = all.find(key);
+    return it != all.end() ? it->second : nullptr;
+  }
+
+  esp_netif_t* create(const char* key, bool is_ap) {
+    sim::Lock lock(sim::mutex());
+    if (find(key) != nullptr) {
+      // As in the IDF, where the default constructors assert on a duplicate key.
+      fprintf(stderr, "sim: the interface %s already exists\n", key);
+      abort();
+    }
+    auto netif = new esp_netif_obj();
+    netif->key = key;
+    netif->is_ap = is_ap;
+    netif->lwip.hwaddr_len = NETIF_MAX_HWADDR_LEN;
+    netif->lwip.state = netif;
+    esp_read_mac(netif->lwip.hwaddr, is_ap ? ESP_MAC_WIFI_SOFTAP : ESP_MAC_WIFI_STA);
+    if (is_ap) {
+      IP4_ADDR(&netif->ip_info.ip, 192, 168, 4, 1);
+      IP4_ADDR(&netif->ip_info.gw, 192, 168, 4, 1);
+      IP4_ADDR(&netif->ip_info.netmask, 255, 255, 255, 0);
+      netif->lwip.ip_addr.addr = netif->ip_info.ip.addr;
+    }
+    netif->dhcp_started = true;
+    interfaces()[key] = netif;
+    return netif;
+  }
+
+  void postGotIP(esp_netif_t* netif) {
+    ip_event_got_ip_t event = {};
+    event.esp_netif = netif;
+    event.ip_info = netif->ip_info;
+    event.ip_changed = netif->ip_info.ip.addr != netif->last_ip;
+    netif->last_ip = netif->ip_info.ip.addr;
+    sim::postEvent(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event));
+  }
+
+  void setAddress(esp_netif_t* netif, uint32_t ip, uint32_t netmask, uint32_t gw) {
+    netif->ip_info.ip.addr = ip;
+    netif->ip_info.netmask.addr = netmask;
+    netif->ip_info.gw.addr = gw;
+    netif->lwip.ip_addr.addr = ip;
+  }
+
+  /// @brief Run the DHCP exchange of the station, which the access point answers after its delay.
+  void requestLease(esp_netif_t* netif) {
+    if (netif->lease_action != 0) {
+      sim::cancel(netif->lease_action);
+      netif->lease_action = 0;
+    }
+    if (!netif->ap.dhcp) {
+      return;
+    }
+    netif->lease_action = sim::schedule(sim::now() + netif->ap.dhcp_ms * 1000ll, [netif]() {
+      netif->lease_action = 0;
+      const auto& ap = netif->ap;
+      setAddress(netif, ap.ip, ap.netmask, ap.gw);
+      netif->dns[ESP_NETIF_DNS_MAIN].ip.u_addr.ip4.addr = ap.dns;
+      netif->dns[ESP_NETIF_DNS_MAIN].ip.type = ESP_IPADDR_TYPE_V4;
+      netif->dhcp.offered_t0_lease = ap.lease_time_s;
+      postGotIP(netif);
+    });
+  }
+
+  void cancelLease(esp_netif_t* netif) {
+    if (netif->lease_action != 0) {
+      sim::cancel(netif->lease_action);
+      netif->lease_action = 0;
+    }
+  }
+
+  /// @brief The lock of the TCP/IP task, taken by tcpip_api_call().
+  std::recursive_mutex& tcpipMutex() {
+    static auto instance = new std::recursive_mutex();
+    return *instance;
+  }
+
+}
+
+namespace sim {
+
+  void stationLinkUp(const AccessPoint& ap) {
+    esp_netif_t* netif = find("WIFI_STA_DEF");
+    if (netif == nullptr) {
+      return;
+    }
+    netif->link_up = true;
+    netif->ap = ap;
+    if (netif->dhcp_started) {
+      requestLease(netif);
+    } else if (netif->ip_info.ip.addr != 0) {
+      postGotIP(netif);
+    }
+  }
+
+  void stationLinkDown() {
+    esp_netif_t* netif = find("WIFI_STA_DEF");
+    if (netif == nullptr || !netif->link_up) {
+      return;
+    }
+    netif->link_up = false;
+    cancelLease(netif);
+    if (netif->dhcp_started) {
+      setAddress(netif, 0, 0, 0);
+    }
+    memset(netif->arp, 0, sizeof(netif->arp));
+  }
+
+  uint32_t leaseStationAddress(uint16_t index) {
+    esp_netif_t* netif = find("WIFI_AP_DEF");
+    if (netif == nullptr || !netif->dhcp_started) {
+      return 0;
+    }
+    uint32_t subnet = ntohl(netif->ip_info.ip.addr & netif->ip_info.netmask.addr);
+    return htonl(subnet + 2 + index);
+  }
+
+  uint32_t getLocalAddress() {
+    esp_netif_t* ap = find("WIFI_AP_DEF");
+    if (ap != nullptr && ap->ip_info.ip.addr != 0) {
+      return ap->ip_info.ip.addr;
+    }
+    esp_netif_t* sta = find("WIFI_STA_DEF");
+    if (sta != nullptr && sta->ip_info.ip.addr != 0) {
+      return sta->ip_info.ip.addr;
+    }
+    return htonl(INADDR_LOOPBACK);
+  }
+
+  std::string getCaptivePortalURI() {
+    Lock lock(mutex());
+    esp_netif_t* netif = find("WIFI_AP_DEF");
+    return netif != nullptr ? netif->captive_uri : std::string();
+  }
+
+}
+
+esp_err_t esp_netif_init(void) {
+  return ESP_OK;
+}
+
+esp_netif_t* esp_netif_create_default_wifi_ap(void) {
+  return create("WIFI_AP_DEF", true);
+}
+
+esp_netif_t* esp_netif_create_default_wifi_sta(void) {
+  return create("WIFI_STA_DEF", false);
+}
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key) {
+  sim::Lock lock(sim::mutex());
+  return find(if_key);
+}
+
+void esp_netif_destroy(esp_netif_t* esp_netif) {
+  if (esp_netif == nullptr) {
+    return;
+  }
+  {
+    sim::Lock lock(sim::mutex());
+    cancelLease(esp_netif);
+    interfaces().erase(esp_netif->key);
+  }
+  delete esp_netif;
+}
+
+void* esp_netif_get_netif_impl(esp_netif_t* esp_netif) {
+  return esp_netif != nullptr ? &esp_netif->lwip : nullptr;
+}
+
+esp_err_t esp_netif_dhcps_start(esp_netif_t* esp_netif) {
+  if (esp_netif == nullptr || !esp_netif->is_ap) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  if (esp_netif->dhcp_started) {
+    return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED;
+  }
+  esp_netif->dhcp_started = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_stop(esp_netif_t* esp_netif) {
+  if (esp_netif == nullptr || !esp_netif->is_ap) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  if (!esp_netif->dhcp_started) {
+    return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED;
+  }
+  esp_netif->dhcp_started = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_option(esp_netif_t* esp_netif, esp_netif_dhcp_option_mode_t opt_op,
+  esp_netif_dhcp_option_id_t opt_id, void* opt_val, uint32_t opt_len) {
+  if (esp_netif == nullptr || !esp_netif->is_ap || opt_val == nullptr) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  if (opt_op == ESP_NETIF_OP_SET && esp_netif->dhcp_started) {
+    return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED;
+  }
+  if (opt_id != ESP_NETIF_CAPTIVEPORTAL_URI) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  if (opt_op == ESP_NETIF_OP_SET) {
+    esp_netif->captive_uri.assign(static_cast<const char*>(opt_val), opt_len);
+  } else if (opt_op == ESP_NETIF_OP_GET) {
+    snprintf(static_cast<char*>(opt_val), opt_len, "%s", esp_netif->captive_uri.c_str());
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t* esp_netif) {
+  if (esp_netif == nullptr || esp_netif->is_ap) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  if (esp_netif->dhcp_started) {
+    return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED;
+  }
+  esp_netif->dhcp_started = true;
+  if (esp_netif->link_up) {
+    requestLease(esp_netif);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t* esp_netif) {
+  if (esp_netif == nullptr || esp_netif->is_ap) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  if (!esp_netif->dhcp_started) {
+    return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED;
+  }
+  esp_netif->dhcp_started = false;
+  cancelLease(esp_netif);
+  setAddress(esp_netif, 0, 0, 0);
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t* esp_netif, const esp_netif_ip_info_t* ip_info) {
+  if (esp_netif == nullptr || ip_info == nullptr) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  if (esp_netif->dhcp_started) {
+    return ESP_ERR_ESP_NETIF_DHCP_NOT_STOPPED;
+  }
+  setAddress(esp_netif, ip_info->ip.addr, ip_info->netmask.addr, ip_info->gw.addr);
+  if (!esp_netif->is_ap && esp_netif->link_up && ip_info->ip.addr != 0) {
+    postGotIP(esp_netif);
+    sim::wake(lock);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t* esp_netif, esp_netif_ip_info_t* ip_info) {
+  if (esp_netif == nullptr || ip_info == nullptr) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  *ip_info = esp_netif->ip_info;
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t* esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t* dns) {
+  if (esp_netif == nullptr || dns == nullptr || type >= ESP_NETIF_DNS_MAX) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  esp_netif->dns[type] = *dns;
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t* esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t* dns) {
+  if (esp_netif == nullptr || dns == nullptr || type >= ESP_NETIF_DNS_MAX) {
+    return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+  }
+  sim::Lock lock(sim::mutex());
+  *dns = esp_netif->dns[type];
+  return ESP_OK;
+}
+
+char* esp_ip4addr_ntoa(const esp_ip4_addr_t* addr, char* buf, int buflen) {
+  int len = snprintf(buf, buflen, IPSTR, IP2STR(addr));
+  return len < buflen ? buf : nullptr;
+}
+
+uint32_t esp_ip4addr_aton(const char* addr) {
+  return ipaddr_addr(addr);
+}
+
+////////////////////////////////
+// lwIP
+
+uint32_t ipaddr_addr(const char* cp) {
+  struct in_addr addr;
+  return inet_aton(cp, &addr) != 0 ? addr.s_addr : INADDR_NONE;
+}
+
+struct dhcp* netif_dhcp_data(struct netif* netif) {
+  return &static_cast<esp_netif_t*>(netif->state)->dhcp;
+}
+
+err_t etharp_request(struct netif* netif, const ip4_addr_t* ipaddr) {
+  auto esp_netif = static_cast<esp_netif_t*>(netif->state);
+  sim::Lock lock(sim::mutex());
+  // Only another host holding the address answers.
+  if (!esp_netif->link_up || esp_netif->ap.conflict_ip == 0 || esp_netif->ap.conflict_ip != ipaddr->addr) {
+    return ERR_OK;
+  }
+  for (auto& entry : esp_netif->arp) {
+    if (!entry.used || entry.ip.addr == ipaddr->addr) {
+      entry.used = true;
+      entry.ip = *ipaddr;
+      static const uint8_t holder[6] = { 0x02, 0x00, 0x5e, 0x10, 0x20, 0x30 };
+      memcpy(entry.eth.addr, holder, sizeof(holder));
+      return ERR_OK;
+    }
+  }
+  return ERR_MEM;
+}
+
+ssize_t etharp_find_addr(struct netif* netif, const ip4_addr_t* ipaddr, struct eth_addr** eth_ret,
+  const ip4_addr_t** ip_ret) {
+  auto esp_netif = static_cast<esp_netif_t*>(netif->state);
+  sim::Lock lock(sim::mutex());
+  for (size_t i = 0; i < ARP_TABLE_SIZE; ++i) {
+    auto& entry = esp_netif->arp[i];
+    if (entry.used && entry.ip.addr == ipaddr->addr) {
+      *eth_ret = &entry.eth;
+      *ip_ret = &entry.ip;
+      return static_cast<ssize_t>(i);
+    }
+  }
+  return -1;
+}
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data* call) {
+  std::lock_guard<std::recursive_mutex> lock(tcpipMutex());
+  call->err = fn(call);
+  return call->err;
+}
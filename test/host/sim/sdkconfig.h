@@ -0,0 +1,9 @@
+#ifndef __SDKCONFIG_H__
+#define __SDKCONFIG_H__
+
+// The configuration of the simulated target: the IDF defaults the component depends on.
+#define CONFIG_FREERTOS_HZ              1000
+#define CONFIG_LWIP_MAX_SOCKETS         10
+#define CONFIG_ESP_TIMER_TASK_STACK_SIZE 3584
+
+#endif // __SDKCONFIG_H__
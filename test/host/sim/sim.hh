@@ -0,0 +1,191 @@
+#ifndef __SIM_HH__
+#define __SIM_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <esp_http_server.h>
+#include <esp_netif_ip_addr.h>
+#include <esp_wifi.h>
+
+// The simulation of the IDF drivers the component runs on: FreeRTOS tasks on host threads,
+// esp_timer and esp_event on their own tasks, a WiFi driver with scripted access points,
+// esp_netif with DHCP, lwIP datagram sockets and esp_http_server.
+//
+// Time is virtual: it only moves when every task waits, straight to the next deadline, so
+// scans, associations and DHCP exchanges take their scripted durations without taking them
+// on the clock, and the same script always gives the same times.
+//
+// The functions below drive the simulation from the test, standing for the air around the
+// device and the phones joining its access point.
+namespace sim {
+
+  /// @brief An access point in range of the station.
+  struct AccessPoint {
+    /// @brief The SSID.
+    std::string ssid;
+    /// @brief The passphrase, unused by an open network.
+    std::string password;
+    /// @brief The BSSID, which identifies the access point.
+    uint8_t bssid[6] = {};
+    /// @brief The primary channel.
+    uint8_t channel = 1;
+    /// @brief The signal strength seen by the station.
+    int8_t rssi = -60;
+    /// @brief The authentication mode.
+    wifi_auth_mode_t authmode = WIFI_AUTH_WPA2_PSK;
+    /// @brief Whether the SSID is left out of the beacons, so only a directed probe finds it.
+    bool hidden = false;
+    /// @brief The time from finding the access point to the association, in milliseconds.
+    uint32_t assoc_ms = 50;
+    /// @brief The number of association attempts to fail, with failure_reason, before the next succeeds.
+    uint32_t auth_failures = 0;
+    /// @brief The reason of the scripted failures.
+    uint8_t failure_reason = WIFI_REASON_AUTH_FAIL;
+    /// @brief Whether a DHCP server answers behind the access point.
+    bool dhcp = true;
+    /// @brief The time from the association to the lease, in milliseconds.
+    uint32_t dhcp_ms = 100;
+    /// @brief The address leased to the station, in network byte order.
+    uint32_t ip = ESP_IP4TOADDR(192, 168, 1, 100);
+    /// @brief The netmask of the lease, in network byte order.
+    uint32_t netmask = ESP_IP4TOADDR(255, 255, 255, 0);
+    /// @brief The gateway of the lease, in network byte order.
+    uint32_t gw = ESP_IP4TOADDR(192, 168, 1, 1);
+    /// @brief The DNS server of the lease, in network byte order.
+    uint32_t dns = ESP_IP4TOADDR(192, 168, 1, 1);
+    /// @brief The lease time, in seconds.
+    uint32_t lease_time_s = 7200;
+    /// @brief An address another host on the network holds and answers ARP requests for, 0 for none.
+    uint32_t conflict_ip = 0;
+  };
+
+  /// @brief The timing of the radio.
+  struct Radio {
+    /// @brief The duration of esp_wifi_init(), in milliseconds.
+    uint32_t init_ms = 30;
+    /// @brief The dwell time of a channel when the scan does not set one, in milliseconds.
+    uint32_t channel_time_ms = 120;
+    /// @brief The one-way latency between the phones and the device, in microseconds.
+    uint32_t latency_us = 0;
+  };
+
+  /// @brief Set the timing of the radio.
+  void setRadio(const Radio& radio);
+
+  /// @brief Put an access point in range, replacing the one with the same BSSID.
+  void addAccessPoint(const AccessPoint& ap);
+
+  /// @brief Take an access point out of range; a station connected to it keeps its link until dropLink().
+  /// @return True if the access point was in range.
+  bool removeAccessPoint(const uint8_t* bssid);
+
+  /// @brief Take every access point out of range.
+  void clearAccessPoints();
+
+  /// @brief Drop the link of the station, as if the access point had gone away.
+  /// @param reason The reason of the disconnection event.
+  /// @return True if the station was connected.
+  bool dropLink(uint8_t reason);
+
+  /// @brief Join the access point of the device with a phone.
+  /// @param mac The MAC address of the phone.
+  /// @return The address leased by the DHCP server in network byte order, or 0 if the phone could not join.
+  uint32_t joinStation(const uint8_t* mac);
+
+  /// @brief Leave the access point of the device.
+  /// @return True if the phone had joined.
+  bool leaveStation(const uint8_t* mac);
+
+  /// @brief Get the captive portal URI the DHCP server of the access point advertises.
+  /// @return The URI, empty if none.
+  std::string getCaptivePortalURI();
+
+  /// @brief Send a datagram to the device and wait for the reply.
+  /// @param from The address of the sender in network byte order.
+  /// @param to The address of the device in network byte order.
+  /// @param port The port of the device in host byte order.
+  /// @return The length of the reply, or -1 on timeout.
+  int exchangeDatagram(uint32_t from, uint32_t to, uint16_t port, const uint8_t* request, size_t len,
+    uint8_t* reply, size_t size, uint32_t timeout_ms);
+
+  /// @brief Get the number of esp_restart() calls.
+  uint32_t getRestartCount();
+
+  /// @brief The header fields of a request or a response.
+  typedef std::vector<std::pair<std::string, std::string>> Headers;
+
+  /// @brief The response to an HTTP request.
+  struct HttpResponse {
+    /// @brief The status code, 0 if no status line was sent.
+    int status = 0;
+    /// @brief The header fields.
+    Headers headers;
+    /// @brief The body, without the chunk framing.
+    std::string body;
+    /// @brief Whether the response was complete before the timeout.
+    bool complete = false;
+    /// @brief Whether the server closed the connection.
+    bool closed = false;
+
+    /// @brief Get a header field, regardless of the case of its name.
+    /// @return The value, or nullptr if the field is missing.
+    const char* header(const char* name) const;
+  };
+
+  /// @brief A phone browsing the web server of the device over one keep-alive connection,
+  /// opened again when the server closed it.
+  class HttpClient {
+  public:
+    /// @brief The constructor.
+    /// @param client The address of the phone in network byte order.
+    /// @param server The address of the device in network byte order.
+    /// @param port The port of the web server in host byte order.
+    HttpClient(uint32_t client, uint32_t server, uint16_t port = 80);
+    /// @brief The destructor, which closes the connection.
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    /// @brief Send a GET request and wait for the response.
+    HttpResponse get(const std::string& uri, const Headers& headers = {}, uint32_t timeout_ms = 5000);
+
+    /// @brief Send a POST request and wait for the response.
+    HttpResponse post(const std::string& uri, const std::string& body, const Headers& headers = {},
+      uint32_t timeout_ms = 5000);
+
+    /// @brief Send a request and wait for the response.
+    /// @param content_len The declared body length, more than the body sent to stall the server.
+    /// @return The response, partial if it did not complete before the timeout.
+    HttpResponse request(httpd_method_t method, const std::string& uri, const Headers& headers,
+      const std::string& body, uint32_t timeout_ms, size_t content_len);
+
+    /// @brief Close the connection.
+    void close();
+
+    /// @brief Get the number of connections opened so far.
+    uint32_t getConnectionCount() const;
+
+  private:
+    struct Connection;
+
+    /// @brief The address of the phone.
+    uint32_t client;
+    /// @brief The address of the device.
+    uint32_t server;
+    /// @brief The port of the web server.
+    uint16_t port;
+    /// @brief The current connection.
+    std::shared_ptr<Connection> connection;
+    /// @brief The number of connections opened.
+    uint32_t connections;
+  };
+
+}
+
+#endif // __SIM_HH__
@@ -0,0 +1,172 @@
+#include <esp_err.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_mac.h>
+#include <esp_random.h>
+#include <esp_system.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "kernel.hh"
+
+// The free heap of a typical ESP32 application with WiFi up.
+#define HEAP_FREE_SIZE          180000
+#define HEAP_MINIMUM_FREE_SIZE  150000
+
+namespace {
+
+  struct System {
+    std::mutex log_mutex;
+    std::map<std::string, esp_log_level_t> levels;
+    esp_log_level_t default_level = ESP_LOG_INFO;
+    uint32_t random_state = 0x2545f491;
+    uint32_t restarts = 0;
+  };
+
+  System& system() {
+    static System* instance = new System();
+    return *instance;
+  }
+
+}
+
+namespace sim {
+
+  uint32_t getRestartCount() {
+    Lock lock(mutex());
+    return system().restarts;
+  }
+
+}
+
+////////////////////////////////
+// Logging
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+  auto& s = system();
+  std::lock_guard<std::mutex> lock(s.log_mutex);
+  if (strcmp(tag, "*") == 0) {
+    s.levels.clear();
+    s.default_level = level;
+  } else {
+    s.levels[tag] = level;
+  }
+}
+
+uint32_t esp_log_timestamp(void) {
+  sim::Lock lock(sim::mutex());
+  return static_cast<uint32_t>(sim::now() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+  auto& s = system();
+  std::lock_guard<std::mutex> lock(s.log_mutex);
+  auto it = s.levels.find(tag);
+  if (level > (it != s.levels.end() ? it->second : s.default_level)) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+}
+
+////////////////////////////////
+// Errors
+
+const char* esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+void _esp_error_check_failed(esp_err_t rc, const char* file, int line, const char* function, const char* expression) {
+  fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\n", rc, esp_err_to_name(rc), file, line);
+  fprintf(stderr, "function: %s\nexpression: %s\n", function, expression);
+  abort();
+}
+
+////////////////////////////////
+// Chip
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+  if (mac == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // As on the chip, the interfaces take consecutive addresses from the base one of the station.
+  static const uint8_t base[6] = { 0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56 };
+  memcpy(mac, base, sizeof(base));
+  mac[5] += static_cast<uint8_t>(type);
+  return ESP_OK;
+}
+
+uint32_t esp_random(void) {
+  // xorshift32, from a fixed seed so that the runs repeat.
+  sim::Lock lock(sim::mutex());
+  uint32_t& x = system().random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+void esp_fill_random(void* buf, size_t len) {
+  auto bytes = static_cast<uint8_t*>(buf);
+  while (len > 0) {
+    uint32_t word = esp_random();
+    size_t count = len < sizeof(word) ? len : sizeof(word);
+    memcpy(bytes, &word, count);
+    bytes += count;
+    len -= count;
+  }
+}
+
+void esp_restart(void) {
+  sim::Lock lock(sim::mutex());
+  ++system().restarts;
+  fprintf(stderr, "sim: esp_restart() from %s\n", sim::currentTask()->name.c_str());
+  sim::wake(lock);
+  for (;;) {
+    sim::block(lock, []() { return false; }, sim::FOREVER, "esp_restart");
+  }
+}
+
+uint32_t esp_get_free_heap_size(void) {
+  return HEAP_FREE_SIZE;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+  return HEAP_MINIMUM_FREE_SIZE;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return HEAP_FREE_SIZE;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return HEAP_MINIMUM_FREE_SIZE;
+}
+
+esp_err_t heap_caps_monitor_local_minimum_free_size_start(void) {
+  return ESP_OK;
+}
+
+esp_err_t heap_caps_monitor_local_minimum_free_size_stop(void) {
+  return ESP_OK;
+}
@@ -0,0 +1,801 @@
+#include <esp_netif.h>
+#include <esp_wifi.h>
+#include <nvs.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "kernel.hh"
+
+// Where the driver persists the station configuration with WIFI_STORAGE_FLASH.
+#define NVS_NAMESPACE_DRIVER  "nvs.net80211"
+#define NVS_KEY_STA_CONFIG    "sta.config"
+
+#define FIRST_CHANNEL  1
+#define LAST_CHANNEL   13
+
+namespace {
+
+  /// @brief An access point in range, with its scripted failures left.
+  struct Air {
+    sim::AccessPoint ap;
+    uint32_t failures_left;
+  };
+
+  /// @brief A phone joined to the access point of the device.
+  struct Station {
+    uint8_t mac[6];
+    uint16_t aid;
+  };
+
+  enum class StaState {
+    Idle,
+    Connecting,
+    Connected,
+  };
+
+  struct Driver {
+    bool initialised = false;
+    bool started = false;
+    wifi_mode_t mode = WIFI_MODE_NULL;
+    wifi_storage_t storage = WIFI_STORAGE_FLASH;
+    wifi_config_t sta_config = {};
+    wifi_config_t ap_config = {};
+
+    StaState sta_state = StaState::Idle;
+    /// @brief Counts the connection attempts, so that the steps of an abandoned one are ignored.
+    uint32_t generation = 0;
+    /// @brief The pending step of the connection attempt, 0 for none.
+    uint64_t connect_action = 0;
+    /// @brief The attempts left before the failure is reported.
+    uint32_t attempts_left = 0;
+    /// @brief The access point the station is associated with.
+    sim::AccessPoint connected;
+
+    bool scanning = false;
+    uint64_t scan_action = 0;
+    uint8_t scan_id = 0;
+    std::vector<wifi_ap_record_t> results;
+
+    std::vector<Air> air;
+    sim::Radio radio;
+    std::vector<Station> stations;
+  };
+
+  Driver& driver() {
+    static Driver* instance = new Driver();
+    return *instance;
+  }
+
+  bool hasSta(wifi_mode_t mode) {
+    return mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA;
+  }
+
+  bool hasAP(wifi_mode_t mode) {
+    return mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA;
+  }
+
+  int64_t dwellUs(uint32_t ms) {
+    return static_cast<int64_t>(ms != 0 ? ms : driver().radio.channel_time_ms) * 1000;
+  }
+
+  void fillRecord(const sim::AccessPoint& ap, wifi_ap_record_t& record, bool hide_ssid) {
+    memset(&record, 0, sizeof(record));
+    memcpy(record.bssid, ap.bssid, sizeof(record.bssid));
+    if (!hide_ssid) {
+      memcpy(record.ssid, ap.ssid.data(), std::min(ap.ssid.size(), sizeof(record.ssid) - 1));
+    }
+    record.primary = ap.channel;
+    record.second = WIFI_SECOND_CHAN_NONE;
+    record.rssi = ap.rssi;
+    record.authmode = ap.authmode;
+  }
+
+  void copySsid(const std::string& ssid, uint8_t* out, uint8_t& out_len) {
+    out_len = static_cast<uint8_t>(std::min<size_t>(ssid.size(), 32));
+    memcpy(out, ssid.data(), out_len);
+  }
+
+  void postDisconnected(const sim::AccessPoint* ap, const wifi_sta_config_t& config, uint8_t reason) {
+    wifi_event_sta_disconnected_t event = {};
+    if (ap != nullptr) {
+      copySsid(ap->ssid, event.ssid, event.ssid_len);
+      memcpy(event.bssid, ap->bssid, sizeof(event.bssid));
+      event.rssi = ap->rssi;
+    } else {
+      event.ssid_len = static_cast<uint8_t>(strnlen(reinterpret_cast<const char*>(config.ssid), sizeof(config.ssid)));
+      memcpy(event.ssid, config.ssid, event.ssid_len);
+    }
+    event.reason = reason;
+    sim::postEvent(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event));
+  }
+
+  /// @brief Leave the connection or the attempt, reporting it with a reason.
+  void leave(uint8_t reason) {
+    auto& d = driver();
+    if (d.sta_state == StaState::Idle) {
+      return;
+    }
+    if (d.connect_action != 0) {
+      sim::cancel(d.connect_action);
+      d.connect_action = 0;
+    }
+    ++d.generation;
+    if (d.sta_state == StaState::Connected) {
+      sim::stationLinkDown();
+      postDisconnected(&d.connected, d.sta_config.sta, reason);
+    } else {
+      postDisconnected(nullptr, d.sta_config.sta, reason);
+    }
+    d.sta_state = StaState::Idle;
+  }
+
+  bool matches(const Air& air, const wifi_sta_config_t& config) {
+    const auto& ap = air.ap;
+    size_t ssid_len = strnlen(reinterpret_cast<const char*>(config.ssid), sizeof(config.ssid));
+    return ap.ssid.size() == ssid_len && memcmp(ap.ssid.data(), config.ssid, ssid_len) == 0
+      && (!config.bssid_set || memcmp(ap.bssid, config.bssid, sizeof(ap.bssid)) == 0)
+      && (config.channel == 0 || ap.channel == config.channel)
+      && ap.authmode >= config.threshold.authmode;
+  }
+
+  Air* findAir(const uint8_t* bssid) {
+    auto& d = driver();
+    for (auto& air : d.air) {
+      if (memcmp(air.ap.bssid, bssid, sizeof(air.ap.bssid)) == 0) {
+        return &air;
+      }
+    }
+    return nullptr;
+  }
+
+  void startAttempt();
+
+  /// @brief End an attempt that failed, retrying while the configuration allows it.
+  void failAttempt(const sim::AccessPoint* ap, uint8_t reason) {
+    auto& d = driver();
+    if (d.attempts_left > 1) {
+      --d.attempts_left;
+      startAttempt();
+      return;
+    }
+    d.sta_state = StaState::Idle;
+    ++d.generation;
+    postDisconnected(ap, d.sta_config.sta, reason);
+  }
+
+  /// @brief Look for the configured network like the driver does, then associate after the scripted delay.
+  void startAttempt() {
+    auto& d = driver();
+    const auto& config = d.sta_config.sta;
+    int64_t dwell = dwellUs(0);
+
+    // A fast scan stops at the first channel with a match, a full scan sweeps all of them for the strongest.
+    const Air* best = nullptr;
+    int64_t scan_us;
+    if (config.channel != 0) {
+      for (const auto& air : d.air) {
+        if (matches(air, config) && (best == nullptr || air.ap.rssi > best->ap.rssi)) {
+          best = &air;
+        }
+      }
+      scan_us = dwell;
+    } else if (config.scan_method == WIFI_FAST_SCAN) {
+      scan_us = (LAST_CHANNEL - FIRST_CHANNEL + 1) * dwell;
+      for (int channel = FIRST_CHANNEL; channel <= LAST_CHANNEL && best == nullptr; ++channel) {
+        for (const auto& air : d.air) {
+          if (air.ap.channel == channel && matches(air, config) && (best == nullptr || air.ap.rssi > best->ap.rssi)) {
+            best = &air;
+            scan_us = (channel - FIRST_CHANNEL + 1) * dwell;
+          }
+        }
+      }
+    } else {
+      for (const auto& air : d.air) {
+        if (matches(air, config) && (best == nullptr || air.ap.rssi > best->ap.rssi)) {
+          best = &air;
+        }
+      }
+      scan_us = (LAST_CHANNEL - FIRST_CHANNEL + 1) * dwell;
+    }
+
+    uint32_t generation = d.generation;
+    if (best == nullptr) {
+      d.connect_action = sim::schedule(sim::now() + scan_us, [generation]() {
+        auto& d = driver();
+        if (d.generation != generation) {
+          return;
+        }
+        d.connect_action = 0;
+        failAttempt(nullptr, WIFI_REASON_NO_AP_FOUND);
+      });
+      return;
+    }
+
+    sim::AccessPoint target = best->ap;
+    d.connect_action = sim::schedule(sim::now() + scan_us + target.assoc_ms * 1000ll, [generation, target]() {
+      auto& d = driver();
+      if (d.generation != generation) {
+        return;
+      }
+      d.connect_action = 0;
+      Air* air = findAir(target.bssid);
+      if (air == nullptr) {
+        failAttempt(&target, WIFI_REASON_NO_AP_FOUND);
+        return;
+      }
+      if (air->failures_left > 0) {
+        --air->failures_left;
+        failAttempt(&air->ap, air->ap.failure_reason);
+        return;
+      }
+      const auto& config = d.sta_config.sta;
+      if (air->ap.authmode != WIFI_AUTH_OPEN
+        && strncmp(reinterpret_cast<const char*>(config.password), air->ap.password.c_str(), sizeof(config.password)) != 0) {
+        failAttempt(&air->ap, WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT);
+        return;
+      }
+
+      d.sta_state = StaState::Connected;
+      d.connected = air->ap;
+      wifi_event_sta_connected_t event = {};
+      copySsid(air->ap.ssid, event.ssid, event.ssid_len);
+      memcpy(event.bssid, air->ap.bssid, sizeof(event.bssid));
+      event.channel = air->ap.channel;
+      event.authmode = air->ap.authmode;
+      event.aid = 1;
+      sim::postEvent(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &event, sizeof(event));
+      sim::stationLinkUp(air->ap);
+    });
+  }
+
+  void finishScan(uint8_t status) {
+    auto& d = driver();
+    d.scanning = false;
+    d.scan_action = 0;
+    wifi_event_sta_scan_done_t event = {};
+    event.status = status;
+    event.number = static_cast<uint8_t>(std::min<size_t>(d.results.size(), UINT8_MAX));
+    event.scan_id = d.scan_id;
+    sim::postEvent(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &event, sizeof(event));
+  }
+
+  void stationsLeave() {
+    auto& d = driver();
+    for (const auto& station : d.stations) {
+      wifi_event_ap_stadisconnected_t event = {};
+      memcpy(event.mac, station.mac, sizeof(event.mac));
+      event.aid = static_cast<uint8_t>(station.aid);
+      event.reason = WIFI_REASON_ASSOC_LEAVE;
+      sim::postEvent(WIFI_EVENT, WIFI_EVENT_AP_STADISCONNECTED, &event, sizeof(event));
+    }
+    d.stations.clear();
+  }
+
+  void cancelScan() {
+    auto& d = driver();
+    if (d.scanning) {
+      sim::cancel(d.scan_action);
+      d.results.clear();
+      finishScan(1);
+    }
+  }
+
+  void loadStaConfig() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE_DRIVER, NVS_READONLY, &handle) != ESP_OK) {
+      return;
+    }
+    wifi_sta_config_t config;
+    size_t size = sizeof(config);
+    if (nvs_get_blob(handle, NVS_KEY_STA_CONFIG, &config, &size) == ESP_OK && size == sizeof(config)) {
+      sim::Lock lock(sim::mutex());
+      driver().sta_config.sta = config;
+    }
+    nvs_close(handle);
+  }
+
+  void saveStaConfig(const wifi_sta_config_t& config) {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE_DRIVER, NVS_READWRITE, &handle) != ESP_OK) {
+      return;
+    }
+    if (nvs_set_blob(handle, NVS_KEY_STA_CONFIG, &config, sizeof(config)) == ESP_OK) {
+      nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+
+}
+
+namespace sim {
+
+  void setRadio(const Radio& radio) {
+    Lock lock(mutex());
+    driver().radio = radio;
+  }
+
+  uint32_t getLatency() {
+    return driver().radio.latency_us;
+  }
+
+  void addAccessPoint(const AccessPoint& ap) {
+    Lock lock(mutex());
+    auto& d = driver();
+    Air* air = findAir(ap.bssid);
+    if (air != nullptr) {
+      *air = { ap, ap.auth_failures };
+    } else {
+      d.air.push_back({ ap, ap.auth_failures });
+    }
+  }
+
+  bool removeAccessPoint(const uint8_t* bssid) {
+    Lock lock(mutex());
+    auto& d = driver();
+    auto it = std::find_if(d.air.begin(), d.air.end(), [bssid](const Air& air) {
+      return memcmp(air.ap.bssid, bssid, sizeof(air.ap.bssid)) == 0;
+    });
+    if (it == d.air.end()) {
+      return false;
+    }
+    d.air.erase(it);
+    return true;
+  }
+
+  void clearAccessPoints() {
+    Lock lock(mutex());
+    driver().air.clear();
+  }
+
+  bool dropLink(uint8_t reason) {
+    Lock lock(mutex());
+    auto& d = driver();
+    if (d.sta_state != StaState::Connected) {
+      return false;
+    }
+    leave(reason);
+    wake(lock);
+    return true;
+  }
+
+  uint32_t joinStation(const uint8_t* mac) {
+    Lock lock(mutex());
+    auto& d = driver();
+    if (!d.started || !hasAP(d.mode) || d.stations.size() >= d.ap_config.ap.max_connection) {
+      return 0;
+    }
+    for (const auto& station : d.stations) {
+      if (memcmp(station.mac, mac, sizeof(station.mac)) == 0) {
+        return 0;
+      }
+    }
+    uint16_t aid = 1;
+    while (std::any_of(d.stations.begin(), d.stations.end(), [aid](const Station& s) { return s.aid == aid; })) {
+      ++aid;
+    }
+    Station station;
+    memcpy(station.mac, mac, sizeof(station.mac));
+    station.aid = aid;
+    d.stations.push_back(station);
+
+    wifi_event_ap_staconnected_t connected = {};
+    memcpy(connected.mac, mac, sizeof(connected.mac));
+    connected.aid = static_cast<uint8_t>(aid);
+    postEvent(WIFI_EVENT, WIFI_EVENT_AP_STACONNECTED, &connected, sizeof(connected));
+
+    uint32_t ip = leaseStationAddress(aid - 1);
+    if (ip != 0) {
+      ip_event_ap_staipassigned_t assigned = {};
+      assigned.ip.addr = ip;
+      memcpy(assigned.mac, mac, sizeof(assigned.mac));
+      postEvent(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED, &assigned, sizeof(assigned));
+    }
+    wake(lock);
+    return ip;
+  }
+
+  bool leaveStation(const uint8_t* mac) {
+    Lock lock(mutex());
+    auto& d = driver();
+    auto it = std::find_if(d.stations.begin(), d.stations.end(), [mac](const Station& station) {
+      return memcmp(station.mac, mac, sizeof(station.mac)) == 0;
+    });
+    if (it == d.stations.end()) {
+      return false;
+    }
+    wifi_event_ap_stadisconnected_t event = {};
+    memcpy(event.mac, mac, sizeof(event.mac));
+    event.aid = static_cast<uint8_t>(it->aid);
+    event.reason = WIFI_REASON_ASSOC_LEAVE;
+    d.stations.erase(it);
+    postEvent(WIFI_EVENT, WIFI_EVENT_AP_STADISCONNECTED, &event, sizeof(event));
+    wake(lock);
+    return true;
+  }
+
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* config) {
+  if (config == nullptr || config->magic != WIFI_INIT_CONFIG_MAGIC) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  {
+    sim::Lock lock(sim::mutex());
+    auto& d = driver();
+    if (d.initialised) {
+      return ESP_OK;
+    }
+    // Bringing up the radio takes a while, which the start-up timings account for.
+    sim::block(lock, []() { return false; }, sim::now() + d.radio.init_ms * 1000ll, "esp_wifi_init");
+    d.initialised = true;
+    d.storage = WIFI_STORAGE_FLASH;
+    d.sta_config = {};
+    d.ap_config = {};
+  }
+  loadStaConfig();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (d.started) {
+    return ESP_ERR_WIFI_NOT_STOPPED;
+  }
+  d.initialised = false;
+  d.mode = WIFI_MODE_NULL;
+  d.results.clear();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+  if (mode >= WIFI_MODE_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  wifi_mode_t previous = d.mode;
+  d.mode = mode;
+  if (d.started) {
+    if (hasSta(previous) && !hasSta(mode)) {
+      cancelScan();
+      leave(WIFI_REASON_ASSOC_LEAVE);
+      sim::postEvent(WIFI_EVENT, WIFI_EVENT_STA_STOP, nullptr, 0);
+    } else if (!hasSta(previous) && hasSta(mode)) {
+      sim::postEvent(WIFI_EVENT, WIFI_EVENT_STA_START, nullptr, 0);
+    }
+    if (hasAP(previous) && !hasAP(mode)) {
+      stationsLeave();
+      sim::postEvent(WIFI_EVENT, WIFI_EVENT_AP_STOP, nullptr, 0);
+    } else if (!hasAP(previous) && hasAP(mode)) {
+      sim::postEvent(WIFI_EVENT, WIFI_EVENT_AP_START, nullptr, 0);
+    }
+    sim::wake(lock);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mode(wifi_mode_t* mode) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  *mode = d.mode;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  d.storage = storage;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t* conf) {
+  if (conf == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  bool persist;
+  {
+    sim::Lock lock(sim::mutex());
+    auto& d = driver();
+    if (!d.initialised) {
+      return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (interface == WIFI_IF_STA ? !hasSta(d.mode) : !hasAP(d.mode)) {
+      return ESP_ERR_WIFI_MODE;
+    }
+    if (interface == WIFI_IF_AP) {
+      d.ap_config.ap = conf->ap;
+      return ESP_OK;
+    }
+    d.sta_config.sta = conf->sta;
+    persist = d.storage == WIFI_STORAGE_FLASH;
+  }
+  if (persist) {
+    saveStaConfig(conf->sta);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t* conf) {
+  if (conf == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  *conf = interface == WIFI_IF_STA ? d.sta_config : d.ap_config;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_restore(void) {
+  {
+    sim::Lock lock(sim::mutex());
+    auto& d = driver();
+    if (!d.initialised) {
+      return ESP_ERR_WIFI_NOT_INIT;
+    }
+    d.sta_config = {};
+    d.ap_config = {};
+  }
+  nvs_handle_t handle;
+  if (nvs_open(NVS_NAMESPACE_DRIVER, NVS_READWRITE, &handle) == ESP_OK) {
+    nvs_erase_key(handle, NVS_KEY_STA_CONFIG);
+    nvs_commit(handle);
+    nvs_close(handle);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (d.started) {
+    return ESP_OK;
+  }
+  d.started = true;
+  if (hasSta(d.mode)) {
+    sim::postEvent(WIFI_EVENT, WIFI_EVENT_STA_START, nullptr, 0);
+  }
+  if (hasAP(d.mode)) {
+    sim::postEvent(WIFI_EVENT, WIFI_EVENT_AP_START, nullptr, 0);
+  }
+  sim::wake(lock);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (!d.started) {
+    return ESP_OK;
+  }
+  cancelScan();
+  leave(WIFI_REASON_ASSOC_LEAVE);
+  stationsLeave();
+  d.started = false;
+  if (hasSta(d.mode)) {
+    sim::postEvent(WIFI_EVENT, WIFI_EVENT_STA_STOP, nullptr, 0);
+  }
+  if (hasAP(d.mode)) {
+    sim::postEvent(WIFI_EVENT, WIFI_EVENT_AP_STOP, nullptr, 0);
+  }
+  sim::wake(lock);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (!d.started) {
+    return ESP_ERR_WIFI_NOT_STARTED;
+  }
+  if (!hasSta(d.mode)) {
+    return ESP_ERR_WIFI_MODE;
+  }
+  if (d.sta_state == StaState::Connected) {
+    leave(WIFI_REASON_ASSOC_LEAVE);
+  } else if (d.connect_action != 0) {
+    // A new attempt replaces the one in progress.
+    sim::cancel(d.connect_action);
+    d.connect_action = 0;
+    ++d.generation;
+  }
+  d.sta_state = StaState::Connecting;
+  d.attempts_left = 1 + d.sta_config.sta.failure_retry_cnt;
+  startAttempt();
+  sim::wake(lock);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (!d.started) {
+    return ESP_ERR_WIFI_NOT_STARTED;
+  }
+  leave(WIFI_REASON_ASSOC_LEAVE);
+  sim::wake(lock);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t* config, bool block) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (!d.started) {
+    return ESP_ERR_WIFI_NOT_STARTED;
+  }
+  if (!hasSta(d.mode)) {
+    return ESP_ERR_WIFI_MODE;
+  }
+  if (d.scanning || d.sta_state == StaState::Connecting) {
+    return ESP_ERR_WIFI_STATE;
+  }
+
+  wifi_scan_config_t scan = {};
+  if (config != nullptr) {
+    scan = *config;
+  }
+  uint8_t first = scan.channel != 0 ? scan.channel : FIRST_CHANNEL;
+  uint8_t last = scan.channel != 0 ? scan.channel : LAST_CHANNEL;
+  int64_t dwell = dwellUs(scan.scan_type == WIFI_SCAN_TYPE_ACTIVE ? scan.scan_time.active.max : scan.scan_time.passive);
+  std::string ssid = scan.ssid != nullptr ? reinterpret_cast<const char*>(scan.ssid) : "";
+
+  // The results are those in range when the sweep ends.
+  d.scanning = true;
+  ++d.scan_id;
+  uint8_t scan_id = d.scan_id;
+  d.scan_action = sim::schedule(sim::now() + (last - first + 1) * dwell, [scan, first, last, ssid]() {
+    auto& d = driver();
+    d.results.clear();
+    for (const auto& air : d.air) {
+      const auto& ap = air.ap;
+      if (ap.channel < first || ap.channel > last || (!ssid.empty() && ap.ssid != ssid)
+        || (scan.bssid != nullptr && memcmp(ap.bssid, scan.bssid, sizeof(ap.bssid)) != 0)) {
+        continue;
+      }
+      // A hidden network answers a directed probe only, and shows up without its name otherwise.
+      if (ap.hidden && ssid.empty() && !scan.show_hidden) {
+        continue;
+      }
+      wifi_ap_record_t record;
+      fillRecord(ap, record, ap.hidden && ssid.empty());
+      d.results.push_back(record);
+    }
+    std::stable_sort(d.results.begin(), d.results.end(), [](const wifi_ap_record_t& a, const wifi_ap_record_t& b) {
+      return a.rssi > b.rssi;
+    });
+    finishScan(0);
+  });
+  sim::wake(lock);
+
+  if (block) {
+    sim::block(lock, [&d, scan_id]() { return !d.scanning || d.scan_id != scan_id; }, sim::FOREVER, "blocking scan");
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_stop(void) {
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (!d.started) {
+    return ESP_ERR_WIFI_NOT_STARTED;
+  }
+  cancelScan();
+  sim::wake(lock);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t* number) {
+  if (number == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  *number = static_cast<uint16_t>(d.results.size());
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t* number, wifi_ap_record_t* ap_records) {
+  if (number == nullptr || ap_records == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  size_t count = std::min<size_t>(*number, d.results.size());
+  std::copy(d.results.begin(), d.results.begin() + count, ap_records);
+  *number = static_cast<uint16_t>(count);
+  // Like the driver, reading the records frees the list.
+  d.results.clear();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_clear_ap_list(void) {
+  sim::Lock lock(sim::mutex());
+  driver().results.clear();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info) {
+  if (ap_info == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (d.sta_state != StaState::Connected) {
+    return ESP_ERR_WIFI_NOT_CONNECT;
+  }
+  fillRecord(d.connected, *ap_info, false);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second) {
+  if (primary == nullptr || second == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::Lock lock(sim::mutex());
+  auto& d = driver();
+  if (!d.initialised) {
+    return ESP_ERR_WIFI_NOT_INIT;
+  }
+  if (d.sta_state == StaState::Connected) {
+    *primary = d.connected.channel;
+  } else if (hasAP(d.mode) && d.ap_config.ap.channel != 0) {
+    *primary = d.ap_config.ap.channel;
+  } else {
+    *primary = FIRST_CHANNEL;
+  }
+  *second = WIFI_SECOND_CHAN_NONE;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_country(wifi_country_t* country) {
+  if (country == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *country = { "CN", FIRST_CHANNEL, LAST_CHANNEL - FIRST_CHANNEL + 1, 20, WIFI_COUNTRY_POLICY_AUTO };
+  return ESP_OK;
+}
@@ -0,0 +1,99 @@
+// The per-phase connection timing: phases, the rolling window of the histograms and the reason counts.
+
+#include <chrono>
+#include <thread>
+
+#include "check.hh"
+#include "connection_stats.hh"
+
+using namespace wifi_connect;
+
+static void runAttempt(ConnectionStats& stats, bool success, int association_ms = 0) {
+  stats.beginAttempt();
+  if (association_ms > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(association_ms));
+  }
+  stats.onAssociated();
+  if (success) {
+    stats.onGotIP();
+  } else {
+    stats.onDisconnected(15);
+  }
+  stats.endAttempt(success);
+}
+
+static void testPhases() {
+  ConnectionStats stats;
+  runAttempt(stats, true);
+  runAttempt(stats, false);
+  auto attempt = stats.getLastAttempt();
+  CHECK(!attempt.success);
+  CHECK(attempt.associated_us >= attempt.start_us);
+  CHECK(attempt.got_ip_us == 0);
+  CHECK(attempt.disconnect_reason == 15);
+  // A failed attempt still counts its association, only successful ones count in total.
+  CHECK(stats.getAssociationHistogram().count == 2);
+  CHECK(stats.getDHCPHistogram().count == 1);
+  CHECK(stats.getTotalHistogram().count == 1);
+}
+
+static void testWindow() {
+  ConnectionStats stats;
+  runAttempt(stats, true, 5);
+  auto histogram = stats.getAssociationHistogram();
+  CHECK(histogram.max_us >= 5000);
+  CHECK(histogram.buckets[0] == 0);
+
+  // The slow attempt leaves the histograms once the window moved past it.
+  for (size_t i = 0; i < ConnectionStats::WINDOW_SIZE - 1; ++i) {
+    runAttempt(stats, true);
+  }
+  CHECK(stats.getAssociationHistogram().max_us >= 5000);
+  runAttempt(stats, true);
+  histogram = stats.getAssociationHistogram();
+  CHECK(histogram.count == ConnectionStats::WINDOW_SIZE);
+  CHECK(histogram.max_us < 5000);
+}
+
+static void testReasons() {
+  ConnectionStats stats;
+  for (uint16_t reason = 1; reason <= ConnectionStats::MAX_REASONS + 2; ++reason) {
+    stats.onDisconnected(reason);
+  }
+  stats.onDisconnected(1);
+  ConnectionStats::ReasonCount reasons[ConnectionStats::MAX_REASONS];
+  CHECK(stats.getReasons(reasons, 2) == 2);
+  CHECK(stats.getReasons(reasons, ConnectionStats::MAX_REASONS) == ConnectionStats::MAX_REASONS);
+  CHECK(reasons[0].reason == 1 && reasons[0].count == 2);
+  CHECK(stats.getOtherReasons() == 2);
+  stats.reset();
+  CHECK(stats.getReasons(reasons, ConnectionStats::MAX_REASONS) == 0);
+  CHECK(stats.getAssociationHistogram().count == 0);
+}
+
+static void testConcurrent() {
+  // Readers get consistent copies while the events are recorded.
+  ConnectionStats stats;
+  std::thread writer([&stats]() {
+    for (int i = 0; i < 10000; ++i) {
+      runAttempt(stats, true);
+    }
+  });
+  for (int i = 0; i < 10000; ++i) {
+    auto histogram = stats.getAssociationHistogram();
+    uint32_t count = 0;
+    for (auto bucket : histogram.buckets) {
+      count += bucket;
+    }
+    CHECK(count == histogram.count && count <= ConnectionStats::WINDOW_SIZE);
+  }
+  writer.join();
+}
+
+int main() {
+  testPhases();
+  testWindow();
+  testReasons();
+  testConcurrent();
+  return 0;
+}
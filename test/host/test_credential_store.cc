@@ -0,0 +1,80 @@
+// The known networks on the in-memory NVS backend.
+
+#include <cstring>
+
+#include "check.hh"
+#include "credential_store.hh"
+#include "nvs.h"
+
+using namespace wifi_connect;
+
+static const uint8_t* key(const char* ssid) {
+  static uint8_t padded[32];
+  memset(padded, 0, sizeof(padded));
+  memcpy(padded, ssid, strnlen(ssid, sizeof(padded)));
+  return padded;
+}
+
+static void testRoundTrip() {
+  nvs_host_erase_all();
+  CredentialStore store;
+  store.load();
+  CHECK(store.getCount() == 0);
+
+  store.add("home", "secret", 3, 0);
+  store.add("office", "password", 3, 1);
+  store.save();
+
+  CredentialStore loaded;
+  loaded.load();
+  CHECK(loaded.getCount() == 2);
+  auto profile = loaded.find(key("office"));
+  CHECK(profile != nullptr);
+  CHECK(memcmp(profile->password, "password", 9) == 0);
+  CHECK(profile->priority == 1);
+
+  CHECK(loaded.remove("home"));
+  CHECK(!loaded.remove("home"));
+  loaded.save();
+  store.load();
+  CHECK(store.getCount() == 1);
+  CHECK(store.find(key("home")) == nullptr);
+}
+
+static void testFullTable() {
+  nvs_host_erase_all();
+  CredentialStore store;
+  store.load();
+  char ssid[8];
+  for (size_t i = 0; i < CredentialStore::MAX_PROFILES; ++i) {
+    snprintf(ssid, sizeof(ssid), "net%zu", i);
+    store.add(ssid, "password", 3, 0);
+  }
+  // The network failing the most is replaced first.
+  store.recordFailure(2);
+  store.add("new", "password", 3, 0);
+  CHECK(store.getCount() == CredentialStore::MAX_PROFILES);
+  CHECK(store.find(key("net2")) == nullptr);
+  CHECK(store.find(key("new")) != nullptr);
+}
+
+static void testScore() {
+  nvs_host_erase_all();
+  CredentialStore store;
+  store.add("a", "password", 3, 0);
+  store.add("b", "password", 3, 0);
+  CHECK(store.score(0, -60) == store.score(1, -60));
+  store.recordSuccess(0);
+  CHECK(store.score(0, -60) > store.score(1, -60));
+  store.recordFailure(0);
+  store.recordFailure(0);
+  store.recordFailure(0);
+  CHECK(store.score(0, -60) < store.score(1, -60));
+}
+
+int main() {
+  testRoundTrip();
+  testFullTable();
+  testScore();
+  return 0;
+}
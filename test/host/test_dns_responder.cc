@@ -0,0 +1,170 @@
+// The DNS wire format: answers, error responses and dropped messages.
+
+#include <arpa/inet.h>
+
+#include "check.hh"
+#include "dns_messages.hh"
+#include "dns_responder.hh"
+
+using namespace wifi_connect;
+
+static uint16_t readU16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+static DNSResponder makeResponder() {
+  DNSResponder responder;
+  responder.setAddress(inet_addr("192.168.4.1"));
+  return responder;
+}
+
+static void testAnswerA() {
+  auto responder = makeResponder();
+  uint8_t query[300];
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  size_t query_len = buildQuery(query, 0xBEEF, "connectivitycheck.gstatic.com", 1);
+  DNSResponder::QueryType type;
+  size_t len = responder.respond(query, query_len, response, sizeof(response), &type);
+  CHECK(type == DNSResponder::QueryType::A);
+  CHECK(len == query_len + 16);
+  CHECK(readU16(response) == 0xBEEF);
+  CHECK((response[2] & 0x80) != 0);
+  CHECK((response[3] & 0x0F) == 0);
+  CHECK(readU16(response + 4) == 1);
+  CHECK(readU16(response + 6) == 1);
+  // The question is echoed, then the answer points back to its name.
+  CHECK(memcmp(response + 12, query + 12, query_len - 12) == 0);
+  CHECK(readU16(response + query_len) == 0xC00C);
+  const uint8_t address[4] = { 192, 168, 4, 1 };
+  CHECK(memcmp(response + len - 4, address, 4) == 0);
+}
+
+static void testEDNS() {
+  auto responder = makeResponder();
+  uint8_t query[300];
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  size_t query_len = buildQuery(query, 1, "example.com", 1, true);
+  size_t len = responder.respond(query, query_len, response, sizeof(response));
+  // Question, A record, and our own OPT record.
+  CHECK(len == query_len - 11 + 16 + 11);
+  CHECK(readU16(response + 10) == 1);
+  CHECK(readU16(response + len - 10) == 41);
+
+  // An unknown EDNS version gets BADVERS, split between the header and the OPT record.
+  query[query_len - 5] = 1;
+  len = responder.respond(query, query_len, response, sizeof(response));
+  CHECK(len != 0);
+  CHECK((response[3] & 0x0F) == 0);
+  CHECK(response[len - 6] == 1);
+  CHECK(readU16(response + 6) == 0);
+}
+
+static void testErrors() {
+  auto responder = makeResponder();
+  uint8_t query[300];
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  size_t query_len = buildQuery(query, 1, "example.com", 1);
+
+  // Responses and truncated headers are dropped.
+  query[2] |= 0x80;
+  CHECK(responder.respond(query, query_len, response, sizeof(response)) == 0);
+  query[2] &= ~0x80;
+  CHECK(responder.respond(query, 11, response, sizeof(response)) == 0);
+
+  // Several questions are a format error, without the question echoed.
+  query[5] = 2;
+  CHECK(responder.respond(query, query_len, response, sizeof(response)) == 12);
+  CHECK((response[3] & 0x0F) == 1);
+  query[5] = 1;
+
+  // A truncated question as well.
+  CHECK(responder.respond(query, query_len - 2, response, sizeof(response)) == 12);
+  CHECK((response[3] & 0x0F) == 1);
+
+  // Other opcodes are not implemented.
+  query[2] |= 0x10;
+  CHECK(responder.respond(query, query_len, response, sizeof(response)) == 12);
+  CHECK((response[3] & 0x0F) == 4);
+  query[2] &= ~0x10;
+
+  // Other classes are refused.
+  query[query_len - 1] = 3;
+  CHECK(responder.respond(query, query_len, response, sizeof(response)) == query_len);
+  CHECK((response[3] & 0x0F) == 5);
+  query[query_len - 1] = 1;
+
+  // A response that does not fit is dropped rather than truncated.
+  CHECK(responder.respond(query, query_len, response, query_len + 15) == 0);
+}
+
+static void testLongName() {
+  auto responder = makeResponder();
+  uint8_t query[DNSResponder::MAX_MESSAGE_SIZE];
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  // Four 63-byte labels exceed the 255-byte name limit.
+  char name[4 * 64];
+  for (size_t i = 0; i < sizeof(name) - 1; ++i) {
+    name[i] = i % 64 == 63 ? '.' : 'a';
+  }
+  name[sizeof(name) - 1] = '\0';
+  size_t query_len = buildQuery(query, 1, name, 1);
+  CHECK(responder.respond(query, query_len, response, sizeof(response)) == 12);
+  CHECK((response[3] & 0x0F) == 1);
+}
+
+static void testQueryTypes() {
+  auto responder = makeResponder();
+  uint8_t query[300];
+  uint8_t response[DNSResponder::MAX_MESSAGE_SIZE];
+  DNSResponder::QueryType type;
+
+  // AAAA and HTTPS get NOERROR with no data, so clients fall back to IPv4 at once.
+  size_t query_len = buildQuery(query, 1, "captive.apple.com", 28);
+  CHECK(responder.respond(query, query_len, response, sizeof(response), &type) == query_len);
+  CHECK(type == DNSResponder::QueryType::AAAA);
+  CHECK((response[3] & 0x0F) == 0 && readU16(response + 6) == 0);
+  query_len = buildQuery(query, 1, "captive.apple.com", 65);
+  CHECK(responder.respond(query, query_len, response, sizeof(response), &type) == query_len);
+  CHECK(type == DNSResponder::QueryType::HTTPS);
+  CHECK((response[3] & 0x0F) == 0 && readU16(response + 6) == 0);
+  query_len = buildQuery(query, 1, "captive.apple.com", 64);
+  CHECK(responder.respond(query, query_len, response, sizeof(response), &type) == query_len);
+  CHECK(type == DNSResponder::QueryType::HTTPS);
+
+  // Reverse lookups get NXDOMAIN.
+  query_len = buildQuery(query, 1, "1.4.168.192.in-addr.arpa", 12);
+  CHECK(responder.respond(query, query_len, response, sizeof(response), &type) == query_len);
+  CHECK(type == DNSResponder::QueryType::PTR);
+  CHECK((response[3] & 0x0F) == 3);
+
+  // Other types get no data.
+  query_len = buildQuery(query, 1, "example.com", 16);
+  CHECK(responder.respond(query, query_len, response, sizeof(response), &type) == query_len);
+  CHECK(type == DNSResponder::QueryType::Other);
+  CHECK((response[3] & 0x0F) == 0 && readU16(response + 6) == 0);
+
+  // ANY gets the A record, and with an IPv6 address the AAAA record too.
+  query_len = buildQuery(query, 1, "example.com", 255);
+  CHECK(responder.respond(query, query_len, response, sizeof(response), &type) == query_len + 16);
+  CHECK(type == DNSResponder::QueryType::ANY);
+  CHECK(readU16(response + 6) == 1);
+
+  static const uint8_t address6[16] = { 0xFD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+  responder.setAddress6(address6);
+  CHECK(responder.respond(query, query_len, response, sizeof(response)) == query_len + 16 + 28);
+  CHECK(readU16(response + 6) == 2);
+  query_len = buildQuery(query, 1, "captive.apple.com", 28);
+  size_t len = responder.respond(query, query_len, response, sizeof(response));
+  CHECK(len == query_len + 28);
+  CHECK(readU16(response + query_len + 2) == 28);
+  CHECK(memcmp(response + len - 16, address6, 16) == 0);
+}
+
+int main() {
+  testAnswerA();
+  testQueryTypes();
+  testEDNS();
+  testErrors();
+  testLongName();
+  return 0;
+}
@@ -0,0 +1,90 @@
+// The form body parser: decoding, field order, pieces, and malformed bodies.
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "check.hh"
+#include "form_parser.hh"
+
+using namespace wifi_connect;
+
+struct Form {
+  char ssid[33];
+  char password[65];
+  FormParser::Field fields[2];
+
+  Form()
+    : fields{ { "ssid", ssid, sizeof(ssid), 0, false }, { "password", password, sizeof(password), 0, false } }
+  {
+  }
+};
+
+/// @brief Parse a body fed in pieces of the given size, 0 for a single piece.
+static bool parse(Form& form, const std::string& body, size_t piece = 0) {
+  FormParser parser(form.fields, 2);
+  if (piece == 0) {
+    piece = body.size();
+  }
+  for (size_t i = 0; i < body.size(); i += piece) {
+    if (!parser.feed(body.data() + i, std::min(piece, body.size() - i))) {
+      return false;
+    }
+  }
+  return parser.finish();
+}
+
+static void testDecode() {
+  Form form;
+  CHECK(parse(form, "ssid=My+Home%20WiFi&password=p%40ss%2Bw%C3%B6rd"));
+  CHECK(strcmp(form.ssid, "My Home WiFi") == 0);
+  CHECK(strcmp(form.password, "p@ss+w\xc3\xb6rd") == 0);
+  CHECK(form.fields[1].length == 10);
+
+  // The field order does not matter, and other fields are skipped.
+  CHECK(parse(form, "extra=1&password=b&csrf=%41%42&ssid=a"));
+  CHECK(strcmp(form.ssid, "a") == 0);
+  CHECK(strcmp(form.password, "b") == 0);
+
+  // A missing field, a field without '=', and a repeated field where the last one wins.
+  CHECK(parse(form, "ssid=a&ssid=b&password"));
+  CHECK(strcmp(form.ssid, "b") == 0);
+  CHECK(form.fields[1].present);
+  CHECK(form.fields[1].length == 0);
+  CHECK(parse(form, "ssid=a"));
+  CHECK(!form.fields[1].present);
+}
+
+static void testPieces() {
+  // Splitting the body anywhere, including inside an escape, gives the same result.
+  const std::string body = "ssid=caf%C3%A9+au+lait&password=%21%22%23%24%25%26%27";
+  for (size_t piece = 1; piece <= body.size(); ++piece) {
+    Form form;
+    CHECK(parse(form, body, piece));
+    CHECK(strcmp(form.ssid, "caf\xc3\xa9 au lait") == 0);
+    CHECK(strcmp(form.password, "!\"#$%&'") == 0);
+  }
+}
+
+static void testMalformed() {
+  Form form;
+  // A trailing or truncated escape, bad hex digits, and an encoded null byte.
+  CHECK(!parse(form, "ssid=a%"));
+  CHECK(!parse(form, "ssid=a%4"));
+  CHECK(!parse(form, "ssid=a%zz"));
+  CHECK(!parse(form, "ssid=a%00b"));
+  // The SSID fills its 32 bytes, one more does not fit.
+  CHECK(parse(form, "ssid=" + std::string(32, 'x')));
+  CHECK(form.fields[0].length == 32);
+  CHECK(!parse(form, "ssid=" + std::string(33, 'x')));
+  // Overlong names of unknown fields are skipped with their values.
+  CHECK(parse(form, std::string(100, 'n') + "=" + std::string(1000, 'v') + "&ssid=a"));
+  CHECK(strcmp(form.ssid, "a") == 0);
+}
+
+int main() {
+  testDecode();
+  testPieces();
+  testMalformed();
+  return 0;
+}
@@ -0,0 +1,95 @@
+// The streaming JSON writer: structure, escaping, and chunking by buffer size.
+
+#include <string>
+
+#include "check.hh"
+#include "json_writer.hh"
+
+using namespace wifi_connect;
+
+struct Sink {
+  std::string output;
+  size_t flushes = 0;
+  size_t fail_after = SIZE_MAX;
+};
+
+static bool flush(void* ctx, const char* data, size_t len) {
+  auto sink = static_cast<Sink*>(ctx);
+  if (sink->flushes == sink->fail_after) {
+    return false;
+  }
+  ++sink->flushes;
+  sink->output.append(data, len);
+  return true;
+}
+
+static void writeDocument(JsonWriter& writer) {
+  writer.beginArray();
+  writer.beginObject();
+  writer.key("ssid");
+  writer.string("say \"hi\" \\ o/");
+  writer.key("rssi");
+  writer.number(-42);
+  writer.key("open");
+  writer.boolean(false);
+  writer.endObject();
+  writer.beginObject();
+  writer.key("ssid");
+  writer.string("tab\there\nnew\x01\x7f");
+  writer.key("list");
+  writer.beginArray();
+  writer.number(1);
+  writer.number(2);
+  writer.endArray();
+  writer.endObject();
+  writer.string("caf\xc3\xa9", 5);
+  writer.endArray();
+}
+
+static const char* EXPECTED =
+  "[{\"ssid\":\"say \\\"hi\\\" \\\\ o/\",\"rssi\":-42,\"open\":false},"
+  "{\"ssid\":\"tab\\there\\nnew\\u0001\\u007f\",\"list\":[1,2]},"
+  "\"caf\xc3\xa9\"]";
+
+static void testDocument() {
+  Sink sink;
+  char buffer[512];
+  JsonWriter writer(buffer, sizeof(buffer), flush, &sink);
+  writeDocument(writer);
+  CHECK(writer.finish());
+  CHECK(sink.output == EXPECTED);
+  // A document smaller than the buffer goes out in a single send.
+  CHECK(sink.flushes == 1);
+}
+
+static void testChunking() {
+  // Every buffer size gives the same output, in full chunks but the last.
+  for (size_t size = 1; size <= 16; ++size) {
+    Sink sink;
+    char buffer[16];
+    JsonWriter writer(buffer, size, flush, &sink);
+    writeDocument(writer);
+    CHECK(writer.finish());
+    CHECK(sink.output == EXPECTED);
+    CHECK(sink.flushes == (sink.output.size() + size - 1) / size);
+  }
+}
+
+static void testFailure() {
+  Sink sink;
+  sink.fail_after = 1;
+  char buffer[8];
+  JsonWriter writer(buffer, sizeof(buffer), flush, &sink);
+  writeDocument(writer);
+  CHECK(!writer.finish());
+  // Nothing is sent after a failed send.
+  CHECK(sink.flushes == 1);
+  CHECK(sink.output.size() == sizeof(buffer));
+}
+
+int main() {
+  testDocument();
+  testChunking();
+  testFailure();
+  return 0;
+}
@@ -0,0 +1,76 @@
+// The per-client token bucket limiter: bursts, refills, waits and the reuse of the buckets.
+
+#include "check.hh"
+#include "rate_limiter.hh"
+
+using namespace wifi_connect;
+
+static constexpr int64_t SECOND = 1000000;
+
+static void testBurst() {
+  RateLimiter limiter(3, 1000);
+  CHECK(limiter.acquire(1, 0) == 0);
+  CHECK(limiter.acquire(1, 0) == 0);
+  CHECK(limiter.acquire(1, 0) == 0);
+  // The bucket is empty, the wait is until the next token.
+  CHECK(limiter.acquire(1, 0) == SECOND);
+  CHECK(limiter.acquire(1, SECOND / 4) == SECOND * 3 / 4);
+  // A refused request does not take a token.
+  CHECK(limiter.acquire(1, SECOND) == 0);
+  CHECK(limiter.acquire(1, SECOND) == SECOND);
+}
+
+static void testRefill() {
+  RateLimiter limiter(2, 500);
+  CHECK(limiter.acquire(1, 0) == 0);
+  CHECK(limiter.acquire(1, 0) == 0);
+  CHECK(limiter.acquire(1, 0) > 0);
+  // One token per interval, never more than the burst.
+  CHECK(limiter.acquire(1, SECOND / 2) == 0);
+  CHECK(limiter.acquire(1, SECOND / 2) > 0);
+  CHECK(limiter.acquire(1, 10 * SECOND) == 0);
+  CHECK(limiter.acquire(1, 10 * SECOND) == 0);
+  CHECK(limiter.acquire(1, 10 * SECOND) > 0);
+}
+
+static void testClients() {
+  // Clients do not share their buckets.
+  RateLimiter limiter(1, 1000);
+  CHECK(limiter.acquire(1, 0) == 0);
+  CHECK(limiter.acquire(1, 0) > 0);
+  CHECK(limiter.acquire(2, 0) == 0);
+  CHECK(limiter.acquire(UINT32_MAX, 0) == 0);
+  CHECK(limiter.acquire(UINT32_MAX, 0) > 0);
+}
+
+static void testReuse() {
+  // With the table full, the bucket full the longest goes to the new client.
+  RateLimiter limiter(2, 1000);
+  for (uint32_t client = 1; client <= RateLimiter::MAX_CLIENTS; ++client) {
+    CHECK(limiter.acquire(client, client) == 0);
+  }
+  CHECK(limiter.acquire(2, 100) == 0);
+  CHECK(limiter.acquire(2, 100) > 0);
+  CHECK(limiter.acquire(100, 100) == 0);
+  // The throttled client kept its bucket, the oldest one starts over.
+  CHECK(limiter.acquire(2, 100) > 0);
+  CHECK(limiter.acquire(1, 100) == 0);
+  CHECK(limiter.acquire(1, 100) == 0);
+}
+
+static void testReset() {
+  RateLimiter limiter(1, 1000);
+  CHECK(limiter.acquire(1, 0) == 0);
+  CHECK(limiter.acquire(1, 0) > 0);
+  limiter.reset();
+  CHECK(limiter.acquire(1, 0) == 0);
+}
+
+int main() {
+  testBurst();
+  testRefill();
+  testClients();
+  testReuse();
+  testReset();
+  return 0;
+}
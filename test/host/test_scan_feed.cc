@@ -0,0 +1,132 @@
+// The list of networks pushed to the provisioning pages: merging, thresholds and the JSON changes.
+
+#include <cstring>
+#include <string>
+
+#include "check.hh"
+#include "scan_feed.hh"
+
+using namespace wifi_connect;
+
+static wifi_ap_record_t record(const char* ssid, int8_t rssi, wifi_auth_mode_t authmode = WIFI_AUTH_WPA2_PSK) {
+  wifi_ap_record_t result = {};
+  strncpy(reinterpret_cast<char*>(result.ssid), ssid, sizeof(result.ssid) - 1);
+  result.rssi = rssi;
+  result.authmode = authmode;
+  return result;
+}
+
+static bool flush(void* ctx, const char* data, size_t len) {
+  static_cast<std::string*>(ctx)->append(data, len);
+  return true;
+}
+
+static std::string delta(const ScanFeed& feed) {
+  std::string output;
+  char buffer[64];
+  JsonWriter writer(buffer, sizeof(buffer), flush, &output);
+  feed.writeDelta(writer);
+  CHECK(writer.finish());
+  return output;
+}
+
+static std::string full(const ScanFeed& feed) {
+  std::string output;
+  char buffer[64];
+  JsonWriter writer(buffer, sizeof(buffer), flush, &output);
+  feed.writeFull(writer);
+  CHECK(writer.finish());
+  return output;
+}
+
+static void testEmpty() {
+  ScanFeed feed;
+  CHECK(full(feed) == "{\"reset\":true,\"added\":[]}");
+  CHECK(!feed.update(nullptr, 0));
+  CHECK(delta(feed) == "{\"added\":[],\"changed\":[],\"removed\":[]}");
+}
+
+static void testMerge() {
+  // Hidden networks are left out, and each SSID keeps its strongest access point.
+  ScanFeed feed;
+  const wifi_ap_record_t records[] = {
+    record("home", -70),
+    record("", -30),
+    record("cafe", -60, WIFI_AUTH_OPEN),
+    record("home", -50),
+    record("home", -80),
+  };
+  CHECK(feed.update(records, 5));
+  CHECK(delta(feed) ==
+    "{\"added\":[{\"ssid\":\"home\",\"rssi\":-50,\"authmode\":3},{\"ssid\":\"cafe\",\"rssi\":-60,\"authmode\":0}],"
+    "\"changed\":[],\"removed\":[]}");
+  CHECK(full(feed) ==
+    "{\"reset\":true,\"added\":[{\"ssid\":\"home\",\"rssi\":-50,\"authmode\":3},{\"ssid\":\"cafe\",\"rssi\":-60,\"authmode\":0}]}");
+}
+
+static void testChanges() {
+  ScanFeed feed;
+  const wifi_ap_record_t first[] = { record("home", -50), record("cafe", -60), record("office", -70) };
+  CHECK(feed.update(first, 3));
+
+  // A signal change below the step is not reported, and the reported signal stays put.
+  const wifi_ap_record_t second[] = { record("home", -52), record("cafe", -60), record("office", -70) };
+  CHECK(!feed.update(second, 3));
+  CHECK(delta(feed) == "{\"added\":[],\"changed\":[],\"removed\":[]}");
+
+  // It adds up against the reported signal, not the last scan.
+  const wifi_ap_record_t third[] = { record("home", -53), record("cafe", -60), record("office", -70) };
+  CHECK(feed.update(third, 3));
+  CHECK(delta(feed) == "{\"added\":[],\"changed\":[{\"ssid\":\"home\",\"rssi\":-53,\"authmode\":3}],\"removed\":[]}");
+
+  // An authentication mode change is always reported.
+  const wifi_ap_record_t fourth[] = { record("home", -53), record("cafe", -60, WIFI_AUTH_WPA3_PSK), record("office", -70) };
+  CHECK(feed.update(fourth, 3));
+  CHECK(delta(feed) == "{\"added\":[],\"changed\":[{\"ssid\":\"cafe\",\"rssi\":-60,\"authmode\":6}],\"removed\":[]}");
+
+  // Networks come and go.
+  const wifi_ap_record_t fifth[] = { record("lab", -40), record("home", -53) };
+  CHECK(feed.update(fifth, 2));
+  CHECK(delta(feed) ==
+    "{\"added\":[{\"ssid\":\"lab\",\"rssi\":-40,\"authmode\":3}],\"changed\":[],\"removed\":[\"cafe\",\"office\"]}");
+  CHECK(full(feed) ==
+    "{\"reset\":true,\"added\":[{\"ssid\":\"lab\",\"rssi\":-40,\"authmode\":3},{\"ssid\":\"home\",\"rssi\":-53,\"authmode\":3}]}");
+}
+
+static void testClear() {
+  ScanFeed feed;
+  const wifi_ap_record_t records[] = { record("home", -50) };
+  CHECK(feed.update(records, 1));
+  feed.clear();
+  CHECK(full(feed) == "{\"reset\":true,\"added\":[]}");
+  // The next scan reports every network as new.
+  CHECK(feed.update(records, 1));
+  CHECK(delta(feed) == "{\"added\":[{\"ssid\":\"home\",\"rssi\":-50,\"authmode\":3}],\"changed\":[],\"removed\":[]}");
+}
+
+static void testCapacity() {
+  // Networks beyond the capacity are dropped.
+  ScanFeed feed;
+  wifi_ap_record_t records[ScanFeed::MAX_ENTRIES + 2];
+  for (size_t i = 0; i < ScanFeed::MAX_ENTRIES + 2; ++i) {
+    char ssid[16];
+    snprintf(ssid, sizeof(ssid), "net%zu", i);
+    records[i] = record(ssid, -50);
+  }
+  CHECK(feed.update(records, ScanFeed::MAX_ENTRIES + 2));
+  std::string output = full(feed);
+  char last[16];
+  snprintf(last, sizeof(last), "\"net%zu\"", ScanFeed::MAX_ENTRIES - 1);
+  CHECK(output.find(last) != std::string::npos);
+  snprintf(last, sizeof(last), "\"net%zu\"", ScanFeed::MAX_ENTRIES);
+  CHECK(output.find(last) == std::string::npos);
+}
+
+int main() {
+  testEmpty();
+  testMerge();
+  testChanges();
+  testClear();
+  testCapacity();
+  return 0;
+}
@@ -0,0 +1,121 @@
+// The Connector on the simulated drivers: the fallbacks between its connection
+// paths on scripted authentication failures and DHCP delays, and the automatic
+// reconnection after the access point drops the link.
+
+#include <mutex>
+#include <vector>
+
+#include "check.hh"
+#include "sim.hh"
+#include "wifi_connector.hh"
+
+using namespace wifi_connect;
+
+static sim::AccessPoint getOffice() {
+  sim::AccessPoint office;
+  office.ssid = "Office";
+  office.password = "office-pass";
+  office.bssid[5] = 0x10;
+  office.channel = 11;
+  office.rssi = -55;
+  office.ip = ESP_IP4TOADDR(10, 0, 0, 42);
+  return office;
+}
+
+/// @brief Let the event task finish with the events of the connection, which set the link state after connect() returns.
+static void settle() {
+  vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+static void testNotStored() {
+  // Never provisioned: the driver is not even brought up to find out.
+  CHECK(!Connector::getInstance().isStored());
+  CHECK(Connector::getInstance().getStartupTiming().driver_inits == 0);
+}
+
+static void testAuthFailure() {
+  // The first association fails, so the ranked attempt does, and the full scan joins.
+  auto office = getOffice();
+  office.auth_failures = 1;
+  sim::addAccessPoint(office);
+
+  auto& connector = Connector::getInstance();
+  CHECK(connector.connect(WIFI_AUTH_WPA2_PSK, "Office", "office-pass"));
+  settle();
+  CHECK(connector.getLastResult().success);
+  CHECK(connector.getLastResult().path == Connector::ConnectPath::Full);
+  CHECK(connector.getIP() == "10.0.0.42");
+  CHECK(connector.getLinkState() == Connector::LinkState::Up);
+  CHECK(connector.isStored());
+}
+
+static void testSlowDHCP() {
+  // A lease slower than the fast path allows fails it, the ranked attempt waits longer.
+  auto office = getOffice();
+  office.dhcp_ms = 4000;
+  sim::addAccessPoint(office);
+
+  auto& connector = Connector::getInstance();
+  connector.disconnect();
+  CHECK(connector.connect(WIFI_AUTH_WPA2_PSK));
+  CHECK(connector.getLastResult().path == Connector::ConnectPath::Ranked);
+  CHECK(connector.getLastResult().duration_us > 7000000);
+  CHECK(connector.getIP() == "10.0.0.42");
+
+  // Back to a quick lease, the cached access point is joined directly.
+  sim::addAccessPoint(getOffice());
+  connector.disconnect();
+  CHECK(connector.connect(WIFI_AUTH_WPA2_PSK));
+  settle();
+  CHECK(connector.getLastResult().path == Connector::ConnectPath::Fast);
+  CHECK(connector.getLastResult().duration_us < 1000000);
+}
+
+static std::mutex states_mutex;
+static std::vector<Connector::LinkState> states;
+
+static void testReconnect() {
+  auto& connector = Connector::getInstance();
+  CHECK(connector.subscribe([](void* ctx, Connector::LinkState state) {
+    std::lock_guard<std::mutex> lock(states_mutex);
+    states.push_back(state);
+  }, nullptr));
+
+  CHECK(sim::dropLink(WIFI_REASON_BEACON_TIMEOUT));
+  // The link goes down and back up on the event task.
+  for (int i = 0; i < 100; ++i) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+    std::lock_guard<std::mutex> lock(states_mutex);
+    if (states.size() >= 2) {
+      break;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(states_mutex);
+    CHECK(states.size() == 2);
+    CHECK(states[0] == Connector::LinkState::Reconnecting);
+    CHECK(states[1] == Connector::LinkState::Up);
+  }
+  CHECK(connector.getIP() == "10.0.0.42");
+}
+
+static void testNoNetwork() {
+  auto& connector = Connector::getInstance();
+  connector.disconnect();
+  sim::clearAccessPoints();
+  CHECK(!connector.connect(WIFI_AUTH_WPA2_PSK));
+  CHECK(connector.getLastResult().path == Connector::ConnectPath::None);
+  CHECK(connector.getLinkState() != Connector::LinkState::Up);
+  connector.disconnect();
+}
+
+int main() {
+  ESP_ERROR_CHECK(esp_netif_init());
+  ESP_ERROR_CHECK(esp_event_loop_create_default());
+  testNotStored();
+  testAuthFailure();
+  testSlowDHCP();
+  testReconnect();
+  testNoNetwork();
+  return 0;
+}
@@ -0,0 +1,201 @@
+// The provisioning flow end to end on the simulated drivers: a phone joins the
+// access point, resolves a name, is redirected to the portal, loads the page
+// and the scan, submits a wrong then the right password, and the connection
+// is handed off to the Connector.
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "check.hh"
+#include "dns_messages.hh"
+#include "sim.hh"
+#include "wifi_configurator.hh"
+#include "wifi_connector.hh"
+
+using namespace wifi_connect;
+
+static const uint32_t ap_ip = ESP_IP4TOADDR(192, 168, 4, 1);
+
+static std::atomic<bool> handed_off(false);
+
+static void addAccessPoints() {
+  sim::AccessPoint home;
+  home.ssid = "HomeNet";
+  home.password = "correct horse";
+  home.bssid[5] = 1;
+  home.channel = 6;
+  home.rssi = -50;
+  sim::addAccessPoint(home);
+
+  sim::AccessPoint cafe;
+  cafe.ssid = "Cafe";
+  cafe.bssid[5] = 2;
+  cafe.channel = 1;
+  cafe.rssi = -70;
+  cafe.authmode = WIFI_AUTH_OPEN;
+  sim::addAccessPoint(cafe);
+
+  sim::AccessPoint secret;
+  secret.ssid = "Secret";
+  secret.password = "hidden";
+  secret.bssid[5] = 3;
+  secret.channel = 11;
+  secret.hidden = true;
+  sim::addAccessPoint(secret);
+}
+
+/// @brief Get the unsigned number of a key of a flat JSON object, 0 if missing.
+static uint32_t getNumber(const std::string& json, const char* key) {
+  auto pos = json.find(std::string("\"") + key + "\":");
+  return pos != std::string::npos ? strtoul(json.c_str() + pos + strlen(key) + 3, nullptr, 10) : 0;
+}
+
+/// @brief Follow /status with long polls until the connection job ends.
+/// @return The last status.
+static std::string waitForOutcome(sim::HttpClient& phone, uint32_t seq) {
+  for (int i = 0; i < 20; ++i) {
+    auto response = phone.get("/status?seq=" + std::to_string(seq), {}, 30000);
+    CHECK(response.complete);
+    if (response.status == 503) {
+      vTaskDelay(pdMS_TO_TICKS(1000));
+      continue;
+    }
+    CHECK(response.status == 200);
+    if (response.body.find("\"failed\"") != std::string::npos || response.body.find("\"connected\"") != std::string::npos) {
+      return response.body;
+    }
+    seq = getNumber(response.body, "seq");
+  }
+  CHECK(false);
+  return "";
+}
+
+static void testProvisioning() {
+  auto& configurator = Configurator::getInstance();
+  configurator.setAPIP("192.168.4.1");
+  configurator.setHandOff(true, [](void* ctx) {
+    static_cast<std::atomic<bool>*>(ctx)->store(true);
+  }, &handed_off);
+  configurator.start();
+
+  const uint8_t mac[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+  uint32_t phone_ip = sim::joinStation(mac);
+  CHECK(phone_ip != 0);
+  CHECK(sim::getCaptivePortalURI() == "http://192.168.4.1/captive-portal/api");
+
+  // Every name resolves to the portal.
+  uint8_t query[300], reply[512];
+  size_t query_len = buildQuery(query, 0x1234, "connectivitycheck.gstatic.com", 1);
+  int reply_len = sim::exchangeDatagram(phone_ip, ap_ip, 53, query, query_len, reply, sizeof(reply), 1000);
+  CHECK(reply_len > static_cast<int>(query_len));
+  CHECK(reply[0] == 0x12 && reply[1] == 0x34);
+  CHECK((reply[2] & 0x80) != 0);
+  CHECK(memcmp(reply + reply_len - 4, &ap_ip, 4) == 0);
+
+  {
+    sim::HttpClient phone(phone_ip, ap_ip);
+
+    auto response = phone.get("/generate_204");
+    CHECK(response.status == 302);
+    CHECK(response.header("location") != nullptr && strcmp(response.header("location"), "http://192.168.4.1/") == 0);
+
+    response = phone.get("/captive-portal/api");
+    CHECK(response.status == 200);
+    CHECK(response.body.find("\"captive\":true") != std::string::npos);
+
+    response = phone.get("/", { { "Accept-Encoding", "gzip, deflate" } });
+    CHECK(response.status == 200);
+    CHECK(response.header("Content-Encoding") != nullptr);
+    CHECK(!response.body.empty());
+    std::string etag = response.header("ETag");
+    response = phone.get("/", { { "Accept-Encoding", "gzip" }, { "If-None-Match", etag } });
+    CHECK(response.status == 304);
+    CHECK(response.body.empty());
+
+    // Anything else is not found, on the same connection; a wrong method is not allowed, and closes it.
+    response = phone.get("/favicon.ico");
+    CHECK(response.status == 404);
+    CHECK(!response.closed);
+    uint32_t connections = phone.getConnectionCount();
+    response = phone.post("/scan", "");
+    CHECK(response.status == 405);
+    CHECK(response.closed);
+    response = phone.get("/done");
+    CHECK(response.status == 200);
+    CHECK(phone.getConnectionCount() == connections + 1);
+
+    // The scan fills in progressively; the hidden network never shows.
+    for (int i = 0; i < 10; ++i) {
+      response = phone.get("/scan");
+      CHECK(response.status == 200);
+      CHECK(response.header("X-Scan-Age") != nullptr);
+      if (response.body.find("HomeNet") != std::string::npos && response.body.find("Cafe") != std::string::npos) {
+        break;
+      }
+      vTaskDelay(pdMS_TO_TICKS(2500));
+    }
+    CHECK(response.body.find("HomeNet") != std::string::npos);
+    CHECK(response.body.find("Cafe") != std::string::npos);
+    CHECK(response.body.find("Secret") == std::string::npos);
+
+    // The scan updates stream until the page goes away.
+    {
+      sim::HttpClient page(phone_ip, ap_ip);
+      response = page.get("/scan/events", {}, 500);
+      CHECK(!response.complete);
+      CHECK(response.status == 200);
+      CHECK(response.body.compare(0, 6, "data: ") == 0);
+    }
+
+    response = phone.post("/submit", "ssid=HomeNet&password=wrong");
+    CHECK(response.status == 202);
+    std::string outcome = waitForOutcome(phone, getNumber(response.body, "seq"));
+    CHECK(outcome.find("\"failed\"") != std::string::npos);
+    CHECK(getNumber(outcome, "reason") == WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT);
+
+    response = phone.post("/submit", "ssid=HomeNet&password=correct+horse");
+    CHECK(response.status == 202);
+    outcome = waitForOutcome(phone, getNumber(response.body, "seq"));
+    CHECK(outcome.find("\"connected\"") != std::string::npos);
+    CHECK(outcome.find("\"ip\":\"192.168.1.100\"") != std::string::npos);
+  }
+
+  for (int i = 0; i < 100 && !handed_off; ++i) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+  CHECK(handed_off);
+  CHECK(sim::getRestartCount() == 0);
+
+  auto timeline = configurator.getProvisioningTimeline();
+  CHECK(timeline.station_joined_us > 0);
+  CHECK(timeline.dns_query_us >= timeline.station_joined_us);
+  CHECK(timeline.probe_redirected_us >= timeline.dns_query_us);
+  CHECK(timeline.page_served_us > 0);
+  CHECK(timeline.scan_served_us > 0);
+  CHECK(timeline.connected_us > timeline.submitted_us);
+  CHECK(timeline.dns_queries == 1);
+  CHECK(timeline.probe_redirects == 1);
+  CHECK(timeline.submits == 2);
+
+  // The Connector owns the connection now, and reconnects straight to the access point.
+  auto& connector = Connector::getInstance();
+  CHECK(connector.getLinkState() == Connector::LinkState::Up);
+  CHECK(connector.getIP() == "192.168.1.100");
+  configurator.stop();
+  connector.disconnect();
+  CHECK(connector.isStored());
+  CHECK(connector.connect(WIFI_AUTH_WPA2_PSK));
+  CHECK(connector.getLastResult().path == Connector::ConnectPath::Fast);
+  CHECK(connector.getIP() == "192.168.1.100");
+  connector.disconnect();
+}
+
+int main() {
+  ESP_ERROR_CHECK(esp_netif_init());
+  ESP_ERROR_CHECK(esp_event_loop_create_default());
+  addAccessPoints();
+  testProvisioning();
+  return 0;
+}
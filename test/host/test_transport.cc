@@ -0,0 +1,133 @@
+// The host backend of the transport: POSIX UDP sockets, std::thread tasks,
+// and the DNS server running on them end to end.
+
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "check.hh"
+#include "dns_server.hh"
+#include "transport.hh"
+
+using namespace wifi_connect;
+
+static void testUDPTransport() {
+  UDPTransport a;
+  UDPTransport b;
+  CHECK(a.open(0));
+  CHECK(b.open(0));
+  CHECK(a.isOpen());
+  CHECK(b.getLocalPort() != 0);
+
+  // Nothing pending yet.
+  CHECK(b.poll(10) == 0);
+  UDPEndpoint from;
+  uint8_t buffer[64];
+  CHECK(b.receive(buffer, sizeof(buffer), from, false) == 0);
+
+  const uint8_t data[] = "hello";
+  UDPEndpoint to = { inet_addr("127.0.0.1"), htons(b.getLocalPort()) };
+  CHECK(a.send(data, sizeof(data), to));
+  CHECK(b.poll(1000) == 1);
+  CHECK(b.receive(buffer, sizeof(buffer), from, false) == static_cast<int>(sizeof(data)));
+  CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+  CHECK(ntohs(from.port) == a.getLocalPort());
+
+  a.close();
+  CHECK(!a.isOpen());
+  CHECK(a.getLocalPort() == 0);
+}
+
+static void testTask() {
+  static std::atomic<bool> started(false);
+  static std::atomic<bool> quit(false);
+  Task task;
+  CHECK(!task.isRunning());
+  CHECK(task.start("test", 4096, 5, -1, [](void* arg) {
+    started = true;
+    while (!quit) {
+    }
+  }, nullptr));
+  CHECK(task.isRunning());
+  while (!started) {
+  }
+  // A task that does not return in time is left running, and cannot be started again.
+  CHECK(!task.stop(10));
+  CHECK(task.isRunning());
+  CHECK(!task.start("test", 4096, 5, -1, [](void* arg) {}, nullptr));
+  quit = true;
+  CHECK(task.stop(1000));
+  CHECK(!task.isRunning());
+}
+
+static const uint8_t query[] = {
+  0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0, 0x00, 0x01, 0x00, 0x01,
+};
+
+static void testDNSServer() {
+  UDPTransport client;
+  CHECK(client.open(0));
+  DNSServer server;
+  server.setPort(25353);
+  esp_ip4_addr_t gateway = { inet_addr("192.168.4.1") };
+
+  // The server must come back on the same port after every stop.
+  for (int cycle = 0; cycle < 3; ++cycle) {
+    server.start(gateway);
+    UDPEndpoint to = { inet_addr("127.0.0.1"), htons(25353) };
+    CHECK(client.send(query, sizeof(query), to));
+    CHECK(client.poll(1000) == 1);
+    uint8_t response[512];
+    UDPEndpoint from;
+    int len = client.receive(response, sizeof(response), from, false);
+    CHECK(len == static_cast<int>(sizeof(query)) + 16);
+    CHECK(response[0] == 0x12 && response[1] == 0x34);
+    CHECK(memcmp(response + len - 4, &gateway.addr, 4) == 0);
+    CHECK(server.getStats().a_queries == 1);
+    server.stop();
+  }
+}
+
+static void testDNSServerRate() {
+  UDPTransport client;
+  CHECK(client.open(0));
+  DNSServer server;
+  server.setPort(25359);
+  esp_ip4_addr_t gateway = { inet_addr("192.168.4.1") };
+  server.start(gateway);
+
+  UDPEndpoint to = { inet_addr("127.0.0.1"), htons(25359) };
+  for (int i = 0; i < 5; ++i) {
+    CHECK(client.send(query, sizeof(query), to));
+    CHECK(client.poll(1000) == 1);
+    uint8_t response[512];
+    UDPEndpoint from;
+    CHECK(client.receive(response, sizeof(response), from, false) > 0);
+  }
+
+  // The rate shows once the second of the queries is over, without a further query.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1500);
+  while (server.getStats().qps == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  auto stats = server.getStats();
+  CHECK(stats.queries == 5);
+  CHECK(stats.qps > 0 && stats.qps <= 5);
+
+  // And goes back to 0 once a whole second passed without any.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+  CHECK(server.getStats().qps == 0);
+  server.stop();
+}
+
+int main() {
+  testUDPTransport();
+  testTask();
+  testDNSServer();
+  testDNSServerRate();
+  return 0;
+}
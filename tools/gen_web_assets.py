@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Generate the web asset source embedded by the component.
+
+Every asset is stored both as is and gzip-compressed, together with its
+length and an ETag derived from each representation, so the web server can answer
+without compressing or hashing anything at run time.
+
+Usage: gen_web_assets.py OUTPUT ASSET...
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+}
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    return '  static const uint8_t %s[] = {\n%s\n  };\n' % (name, '\n'.join(lines))
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write(__doc__)
+        return 1
+
+    output = sys.argv[1]
+    body = []
+    for path in sys.argv[2:]:
+        with open(path, 'rb') as f:
+            data = f.read()
+        base = os.path.basename(path)
+        name = base.replace('.', '_').replace('-', '_')
+        content_type = CONTENT_TYPES.get(os.path.splitext(base)[1], 'application/octet-stream')
+        # A fixed mtime keeps the output reproducible.
+        compressed = gzip.compress(data, compresslevel=9, mtime=0)
+        etag = '"%s"' % hashlib.sha1(data).hexdigest()[:16]
+        gzip_etag = '"%s"' % hashlib.sha1(compressed).hexdigest()[:16]
+
+        body.append(c_array(name + '_data', data))
+        body.append(c_array(name + '_gzip', compressed))
+        body.append(
+            '  const WebAsset %s_asset = {\n'
+            '    .data = %s_data,\n'
+            '    .size = sizeof(%s_data),\n'
+            '    .gzip_data = %s_gzip,\n'
+            '    .gzip_size = sizeof(%s_gzip),\n'
+            '    .etag = "%s",\n'
+            '    .gzip_etag = "%s",\n'
+            '    .content_type = "%s",\n'
+            '  };\n' % (name, name, name, name, name, etag.replace('"', '\\"'), gzip_etag.replace('"', '\\"'),
+                        content_type))
+
+    source = (
+        '// Generated by gen_web_assets.py, do not edit.\n'
+        '#include "web_assets.hh"\n\n'
+        'namespace wifi_connect {\n\n'
+        + '\n'.join(body)
+        + '\n}\n'
+    )
+
+    # Only touch the output when it changes, to avoid needless rebuilds.
+    if os.path.exists(output):
+        with open(output) as f:
+            if f.read() == source:
+                return 0
+    with open(output, 'w') as f:
+        f.write(source)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
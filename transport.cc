@@ -0,0 +1,241 @@
+#include "transport.hh"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "platform.hh"
+
+#ifdef ESP_PLATFORM
+#include <lwip/sockets.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace wifi_connect {
+
+  #define TAG "wifi_connect::Transport"
+
+  ////////////////////////////////
+  // UDPTransport
+
+  UDPTransport::UDPTransport()
+    : fd(-1)
+  {}
+
+  UDPTransport::~UDPTransport() {
+    close();
+  }
+
+  bool UDPTransport::open(uint16_t port) {
+    this->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (this->fd < 0) {
+      ESP_LOGE(TAG, "Failed to create the UDP socket");
+      return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(this->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      ESP_LOGE(TAG, "Failed to bind the UDP socket to port %d", port);
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void UDPTransport::close() {
+    if (this->fd >= 0) {
+      ::close(this->fd);
+      this->fd = -1;
+    }
+  }
+
+  bool UDPTransport::isOpen() const {
+    return this->fd >= 0;
+  }
+
+  uint16_t UDPTransport::getLocalPort() const {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (this->fd < 0 || getsockname(this->fd, (struct sockaddr*)&addr, &addr_len) < 0) {
+      return 0;
+    }
+    return ntohs(addr.sin_port);
+  }
+
+  int UDPTransport::poll(uint32_t timeout_ms) {
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(this->fd, &read_fds);
+    struct timeval timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    int ret = select(this->fd + 1, &read_fds, nullptr, nullptr, &timeout);
+    if (ret < 0) {
+      return errno == EINTR ? 0 : -1;
+    }
+    return ret > 0 ? 1 : 0;
+  }
+
+  int UDPTransport::receive(uint8_t* buffer, size_t size, UDPEndpoint& from, bool wait) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int len = recvfrom(this->fd, buffer, size, wait ? 0 : MSG_DONTWAIT, (struct sockaddr*)&addr, &addr_len);
+    if (len < 0) {
+      return (errno == EAGAIN || errno == EWOULDBLOCK) && !wait ? 0 : -1;
+    }
+    from.address = addr.sin_addr.s_addr;
+    from.port = addr.sin_port;
+    return len;
+  }
+
+  bool UDPTransport::send(const uint8_t* data, size_t len, const UDPEndpoint& to) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = to.address;
+    addr.sin_port = to.port;
+    return sendto(this->fd, data, len, 0, (struct sockaddr*)&addr, sizeof(addr)) >= 0;
+  }
+
+  ////////////////////////////////
+  // Task
+
+#ifdef ESP_PLATFORM
+
+  Task::Task()
+    : handle(nullptr)
+    , tcb()
+    , done_buffer()
+    , entry(nullptr)
+    , arg(nullptr)
+  {
+    done = xSemaphoreCreateBinaryStatic(&done_buffer);
+  }
+
+  Task::~Task() {
+    if (!stop(DESTROY_TIMEOUT_MS)) {
+      ESP_LOGE(TAG, "Task outlives its owner");
+      abort();
+    }
+  }
+
+  bool Task::start(const char* name, uint32_t stack_size, unsigned priority, int core, Entry entry, void* arg, uint8_t* stack) {
+    if (this->handle != nullptr) {
+      ESP_LOGE(TAG, "The %s task is still running", name);
+      return false;
+    }
+    this->entry = entry;
+    this->arg = arg;
+    BaseType_t core_id = core < 0 ? tskNO_AFFINITY : core;
+    if (stack != nullptr) {
+      this->handle = xTaskCreateStaticPinnedToCore(trampoline, name, stack_size, this, priority,
+        reinterpret_cast<StackType_t*>(stack), &this->tcb, core_id);
+    } else if (xTaskCreatePinnedToCore(trampoline, name, stack_size, this, priority, &this->handle, core_id) != pdPASS) {
+      this->handle = nullptr;
+    }
+    if (this->handle == nullptr) {
+      ESP_LOGE(TAG, "Failed to create the %s task", name);
+      return false;
+    }
+    return true;
+  }
+
+  bool Task::stop(uint32_t timeout_ms) {
+    if (this->handle == nullptr) {
+      return true;
+    }
+    if (xSemaphoreTake(this->done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+      // Deleting it could leave a socket or a lock behind mid-call; keep it, a later stop() may still release it.
+      ESP_LOGE(TAG, "Task did not stop within %lu ms, leaving it running", static_cast<unsigned long>(timeout_ms));
+      return false;
+    }
+    // Deleting the suspended task from here releases a static stack at once, so it can be reused.
+    vTaskDelete(this->handle);
+    this->handle = nullptr;
+    return true;
+  }
+
+  bool Task::isRunning() const {
+    return this->handle != nullptr;
+  }
+
+  size_t Task::getStackHighWaterMark() const {
+    // The ESP-IDF stack type is a byte, so the mark is already in bytes.
+    return this->handle ? uxTaskGetStackHighWaterMark(this->handle) * sizeof(StackType_t) : 0;
+  }
+
+  void Task::trampoline(void* task) {
+    auto self = static_cast<Task*>(task);
+    self->entry(self->arg);
+    xSemaphoreGive(self->done);
+    vTaskSuspend(NULL);
+  }
+
+#else
+
+  Task::Task()
+    : done(false)
+  {}
+
+  Task::~Task() {
+    if (!stop(DESTROY_TIMEOUT_MS)) {
+      ESP_LOGE(TAG, "Task outlives its owner");
+      abort();
+    }
+  }
+
+  bool Task::start(const char* name, uint32_t stack_size, unsigned priority, int core, Entry entry, void* arg, uint8_t* stack) {
+    if (this->thread.joinable()) {
+      ESP_LOGE(TAG, "The %s task is still running", name);
+      return false;
+    }
+    this->done = false;
+    this->thread = std::thread(trampoline, this, entry, arg);
+    return true;
+  }
+
+  bool Task::stop(uint32_t timeout_ms) {
+    if (!this->thread.joinable()) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (!this->done_condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return this->done; })) {
+      // Like on the device, leave the thread running rather than block on it; a later stop() may still join it.
+      ESP_LOGE(TAG, "Task did not stop within %lu ms, leaving it running", static_cast<unsigned long>(timeout_ms));
+      return false;
+    }
+    lock.unlock();
+    this->thread.join();
+    return true;
+  }
+
+  void Task::trampoline(Task* task, Entry entry, void* arg) {
+    entry(arg);
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->done = true;
+    task->done_condition.notify_all();
+  }
+
+  bool Task::isRunning() const {
+    return this->thread.joinable();
+  }
+
+  size_t Task::getStackHighWaterMark() const {
+    return 0;
+  }
+
+#endif // ESP_PLATFORM
+
+}
\ No newline at end of file
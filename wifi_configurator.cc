@@ -1,25 +1,70 @@
 #include "wifi_configurator.hh"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include "form_parser.hh"
+#include "json_writer.hh"
+#include "web_assets.hh"
+#include "wifi_connector.hh"
 
 #include <esp_err.h>
+#include <esp_heap_caps.h>
 #include <esp_log.h>
 #include <esp_mac.h>
 #include <esp_netif.h>
 #include <esp_wifi.h>
 
 #include <lwip/ip_addr.h>
+#include <lwip/sockets.h>
 
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+#define CONNECT_TIMEOUT_MS   10000
+#define DISCONNECT_TIMEOUT_MS  500
+#define STATUS_LONG_POLL_MS  20000
+#define MAX_FORM_SIZE        512
 
-extern const char index_html_start[] asm("_binary_index_html_start");
-extern const char done_html_start[] asm("_binary_done_html_start");
+#define SCAN_RATE_BURST          4
+#define SCAN_RATE_INTERVAL_MS    2000
+#define SUBMIT_RATE_BURST        3
+#define SUBMIT_RATE_INTERVAL_MS  5000
+#define SESSION_IDLE_TIMEOUT_MS  30000
+#define SCAN_KEEPALIVE_MS        15000
 
 namespace wifi_connect {
 
   #define TAG "wifi_connect::Configurator"
 
+  /// @brief The common captive portal detection paths, sorted for a binary search.
+  static constexpr std::string_view captive_portal_paths[] = {
+    "/check_network_status.txt",  // Windows
+    "/connectivity-check.html",   // Firefox
+    "/fwlink/",                   // Microsoft
+    "/generate_204",              // Android
+    "/hotspot-detect.html",       // Apple
+    "/library/test/success.html", // Apple
+    "/mobile/status.php",         // Android
+    "/ncsi.txt",                  // Windows
+    "/portal.html",               // Various
+    "/success.txt",               // Various
+  };
+
+  static constexpr bool isSorted(const std::string_view* begin, const std::string_view* end) {
+    for (auto it = begin; it + 1 < end; ++it) {
+      if (!(*it < *(it + 1))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static_assert(isSorted(std::begin(captive_portal_paths), std::end(captive_portal_paths)),
+    "The captive portal paths must be sorted and unique");
+
   ////////////////////////////////
   // Public methods
 
@@ -51,7 +96,47 @@ namespace wifi_connect {
     return "http://" + ap_ip;
   }
 
+  void Configurator::setDNSAddress6(const uint8_t* address) {
+    dns_server.setAddress6(address);
+  }
+
+  void Configurator::setScanTTL(uint32_t ttl_ms) {
+    scan_manager.setTTL(ttl_ms);
+  }
+
+  void Configurator::setScanPeriod(uint32_t period_ms) {
+    scan_manager.setPeriod(period_ms);
+  }
+
+  void Configurator::setScanProgressive(bool progressive) {
+    scan_manager.setProgressive(progressive);
+  }
+
   void Configurator::start() {
+    start_time = esp_timer_get_time();
+    for (auto step : { &timeline.station_joined_us, &timeline.probe_redirected_us, &timeline.portal_api_us,
+      &timeline.page_served_us, &timeline.scan_served_us, &timeline.submitted_us, &timeline.connected_us }) {
+      *step = 0;
+    }
+    for (auto counter : { &timeline.http_requests, &timeline.scan_events, &timeline.probe_redirects,
+      &timeline.portal_api_requests, &timeline.submits,
+      &admission_counters.sessions_opened, &admission_counters.throttled, &admission_counters.evicted }) {
+      *counter = 0;
+    }
+    scan_limiter.reset();
+    submit_limiter.reset();
+    for (auto& session : sessions) {
+      session.fd = -1;
+    }
+    scan_feed.clear();
+    scan_keepalive = start_time;
+    worker_started = false;
+    handed_off = false;
+
+    // Measure the heap used by the configuration process from here on.
+    heap_free_at_start = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_start();
+
     ESP_ERROR_CHECK(
       esp_event_handler_instance_register(
         WIFI_EVENT,
@@ -72,17 +157,62 @@ namespace wifi_connect {
       )
     );
 
+    esp_timer_create_args_t job_timer_args = {
+      .callback = [](void* arg) {
+        auto self = static_cast<Configurator*>(arg);
+        // Got-IP may have completed the job meanwhile.
+        if (self->setConnectState(ConnectState::Failed, 0, PENDING_CONNECT_STATES)) {
+          ESP_LOGE(TAG, "Timed out connecting to WiFi");
+          esp_wifi_disconnect();
+        }
+      },
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "connect_job",
+      .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&job_timer_args, &job_timer));
+
+    esp_timer_create_args_t status_timer_args = {
+      .callback = [](void* arg) {
+        auto self = static_cast<Configurator*>(arg);
+        self->releaseStatusWaiters(false);
+        // The sessions belong to the web server task, check them from there.
+        if (self->web_server != nullptr) {
+          httpd_queue_work(self->web_server, [](void* arg) {
+            auto self = static_cast<Configurator*>(arg);
+            self->evictIdleSessions();
+            self->serviceScanSubscribers();
+          }, self);
+        }
+      },
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "connect_status",
+      .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&status_timer_args, &status_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(status_timer, 1000000));
+
     startAP();
+    scan_manager.start();
     startWebServer();
+    scan_manager.setSnapshotCallback(&Configurator::onScanSnapshot, this);
+  }
+
+  void Configurator::setHandOff(bool enable, HandOffCallback callback, void* ctx) {
+    hand_off = enable;
+    hand_off_callback = callback;
+    hand_off_ctx = ctx;
   }
 
   void Configurator::stop() {
-    if (web_server != nullptr) {
-      httpd_stop(web_server);
-      web_server = nullptr;
-    }
+    stopServices();
 
-    dns_server.stop();
+    // The Connector manages the station connection from a hand-off on, the access point is already gone.
+    if (handed_off) {
+      return;
+    }
 
     esp_wifi_stop();
 
@@ -93,6 +223,156 @@ namespace wifi_connect {
       esp_netif_destroy(netif);
     }
 
+    netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif != NULL) {
+      esp_netif_destroy(netif);
+    }
+  }
+
+  DNSServer::Stats Configurator::getDNSStats() const {
+    return dns_server.getStats();
+  }
+
+  const ConnectionStats& Configurator::getConnectionStats() const {
+    return stats;
+  }
+
+  Configurator::ProvisioningTimeline Configurator::getProvisioningTimeline() const {
+    ProvisioningTimeline result = {};
+    result.station_joined_us = timeline.station_joined_us;
+    result.probe_redirected_us = timeline.probe_redirected_us;
+    result.portal_api_us = timeline.portal_api_us;
+    result.page_served_us = timeline.page_served_us;
+    result.scan_served_us = timeline.scan_served_us;
+    result.submitted_us = timeline.submitted_us;
+    result.connected_us = timeline.connected_us;
+    result.http_requests = timeline.http_requests;
+    result.scan_events = timeline.scan_events;
+    result.probe_redirects = timeline.probe_redirects;
+    result.portal_api_requests = timeline.portal_api_requests;
+    result.submits = timeline.submits;
+    auto dns_stats = dns_server.getStats();
+    result.dns_queries = dns_stats.queries;
+    result.dns_query_us = dns_stats.queries > 0 ? dns_stats.first_query_time - start_time : 0;
+    return result;
+  }
+
+  Configurator::AdmissionStats Configurator::getAdmissionStats() const {
+    AdmissionStats result = {};
+    result.sessions_opened = admission_counters.sessions_opened;
+    result.throttled = admission_counters.throttled;
+    result.evicted = admission_counters.evicted;
+    return result;
+  }
+
+  Configurator::MemoryStats Configurator::getMemoryStats() const {
+    MemoryStats memory_stats = {};
+    memory_stats.heap_free_at_start = heap_free_at_start;
+    size_t heap_free_min = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    memory_stats.heap_peak_used = heap_free_at_start > heap_free_min ? heap_free_at_start - heap_free_min : 0;
+    memory_stats.dns_stack_free = dns_server.getStats().stack_free;
+    if (web_server != nullptr) {
+      TaskHandle_t httpd_task = xTaskGetHandle("httpd");
+      if (httpd_task != nullptr) {
+        memory_stats.httpd_stack_free = uxTaskGetStackHighWaterMark(httpd_task) * sizeof(StackType_t);
+      }
+    }
+    return memory_stats;
+  }
+
+  ////////////////////////////////
+  // Private methods
+
+  Configurator::Configurator()
+    : ap_ssid_prefix("ESP32-")
+    , redirect_location()
+    , portal_api_uri()
+    , any_id_handler(nullptr)
+    , got_ip_handler(nullptr)
+    , dns_server()
+    , scan_manager()
+    , web_server(nullptr)
+    , job_state(ConnectState::Idle)
+    , job_reason(0)
+    , job_seq(0)
+    , job_ip()
+    , job_timer(nullptr)
+    , job_aborting(false)
+    , status_timer(nullptr)
+    , status_waiters()
+    , scan_subscribers()
+    , scan_keepalive(0)
+    , scan_feed()
+    , sessions()
+    , scan_limiter(SCAN_RATE_BURST, SCAN_RATE_INTERVAL_MS)
+    , submit_limiter(SUBMIT_RATE_BURST, SUBMIT_RATE_INTERVAL_MS)
+    , admission_counters()
+    , start_time(0)
+    , timeline()
+    , hand_off(false)
+    , hand_off_callback(nullptr)
+    , hand_off_ctx(nullptr)
+    , handed_off(false)
+    , heap_free_at_start(0)
+    , worker_started(false)
+  {
+    job_mutex = xSemaphoreCreateMutex();
+    job_disconnected = xSemaphoreCreateBinary();
+    scan_mutex = xSemaphoreCreateMutex();
+    for (auto& session : sessions) {
+      session.fd = -1;
+    }
+  }
+
+  Configurator::~Configurator() {
+    stop();
+    vSemaphoreDelete(scan_mutex);
+    vSemaphoreDelete(job_disconnected);
+    vSemaphoreDelete(job_mutex);
+  }
+
+  void Configurator::stopServices() {
+    if (status_timer) {
+      esp_timer_stop(status_timer);
+      esp_timer_delete(status_timer);
+      status_timer = nullptr;
+    }
+
+    if (job_timer) {
+      esp_timer_stop(job_timer);
+      esp_timer_delete(job_timer);
+      job_timer = nullptr;
+    }
+
+    // Answer the detached status requests before their sockets go away.
+    releaseStatusWaiters(true);
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    job_state = ConnectState::Idle;
+    xSemaphoreGive(job_mutex);
+
+    // End the scan update streams, with no snapshot left to queue a new event.
+    scan_manager.setSnapshotCallback(nullptr, nullptr);
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    for (auto& subscriber : scan_subscribers) {
+      if (subscriber) {
+        httpd_resp_send_chunk(subscriber, NULL, 0);
+        httpd_req_async_handler_complete(subscriber);
+        subscriber = nullptr;
+      }
+    }
+    xSemaphoreGive(scan_mutex);
+
+    if (web_server != nullptr) {
+      httpd_stop(web_server);
+      web_server = nullptr;
+    }
+
+    dns_server.stop();
+
+    scan_manager.stop();
+
+    heap_caps_monitor_local_minimum_free_size_stop();
+
     if (any_id_handler) {
       esp_event_handler_instance_unregister(
         WIFI_EVENT,
@@ -112,30 +392,50 @@ namespace wifi_connect {
     }
   }
 
-  ////////////////////////////////
-  // Private methods
+  void Configurator::handOff() {
+    stopServices();
 
-  Configurator::Configurator()
-    : ap_ssid_prefix("ESP32-")
-    , any_id_handler(nullptr)
-    , got_ip_handler(nullptr)
-    , dns_server()
-    , web_server(nullptr)
-  {
-    event_group = xEventGroupCreate();
+    // Drop the access point only, the station keeps its association and address.
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    auto netif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    if (netif != NULL) {
+      esp_netif_destroy(netif);
+    }
+
+    if (!Connector::getInstance().adopt()) {
+      ESP_LOGE(TAG, "Lost the connection during the hand-off, restarting");
+      esp_restart();
+    }
+    handed_off = true;
+    if (hand_off_callback) {
+      hand_off_callback(hand_off_ctx);
+    }
   }
 
-  Configurator::~Configurator() {
-    stop();
-    vEventGroupDelete(event_group);
+  void Configurator::startWorker(void (*entry)(void*), const char* name) {
+    // A second success while the first one is handled must not reuse the running task.
+    if (worker_started) {
+      return;
+    }
+    worker_started = true;
+
+    BaseType_t core_id = CONFIG_WIFI_CONNECT_WORKER_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_WIFI_CONNECT_WORKER_TASK_CORE;
+#if CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+    xTaskCreateStaticPinnedToCore(entry, name, sizeof(worker_stack), this, CONFIG_WIFI_CONNECT_WORKER_TASK_PRIORITY,
+      worker_stack, &worker_tcb, core_id);
+#else
+    xTaskCreatePinnedToCore(entry, name, CONFIG_WIFI_CONNECT_WORKER_TASK_STACK_SIZE, this, CONFIG_WIFI_CONNECT_WORKER_TASK_PRIORITY,
+      NULL, core_id);
+#endif
   }
 
   void Configurator::startAP() {
     // Generate the SSID.
     std::string ssid = getAPSSID();
 
-    // Create the WiFi access point.
+    // Create the WiFi access point, and the station used to try the submitted network.
     auto netif = esp_netif_create_default_wifi_ap();
+    esp_netif_create_default_wifi_sta();
 
     // Set the router IP address.
     esp_netif_ip_info_t ip_info;
@@ -144,6 +444,13 @@ namespace wifi_connect {
     IP4_ADDR(&ip_info.netmask, 255, 255, 255, 0);
     esp_netif_dhcps_stop(netif);
     esp_netif_set_ip_info(netif, &ip_info);
+
+    // Advertise the captive portal API (RFC 8910), so that clients supporting it need no probes.
+    snprintf(portal_api_uri, sizeof(portal_api_uri), "http://%s/captive-portal/api", ap_ip.c_str());
+    if (esp_netif_dhcps_option(netif, ESP_NETIF_OP_SET, ESP_NETIF_CAPTIVEPORTAL_URI,
+        portal_api_uri, strlen(portal_api_uri)) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to set the captive portal URI DHCP option");
+    }
     esp_netif_dhcps_start(netif);
 
     // Start the DNS server
@@ -157,7 +464,7 @@ namespace wifi_connect {
     wifi_config_t wifi_config = {};
     strcpy((char *)wifi_config.ap.ssid, ssid.c_str());
     wifi_config.ap.ssid_len = ssid.length();
-    wifi_config.ap.max_connection = 4;
+    wifi_config.ap.max_connection = CONFIG_WIFI_CONNECT_AP_MAX_CONNECTIONS;
     wifi_config.ap.authmode = WIFI_AUTH_OPEN;
 
     // Start the WiFi Access Point
@@ -173,6 +480,15 @@ namespace wifi_connect {
   void Configurator::startWebServer() {
     // Start the web server.
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.stack_size = CONFIG_WIFI_CONNECT_HTTPD_STACK_SIZE;
+    config.task_priority = CONFIG_WIFI_CONNECT_HTTPD_PRIORITY;
+    config.core_id = CONFIG_WIFI_CONNECT_HTTPD_CORE < 0 ? tskNO_AFFINITY : CONFIG_WIFI_CONNECT_HTTPD_CORE;
+    static_assert(CONFIG_WIFI_CONNECT_HTTPD_MAX_SOCKETS <= CONFIG_LWIP_MAX_SOCKETS - 3,
+      "The web server needs 3 sockets besides its open sockets, raise LWIP_MAX_SOCKETS");
+    config.max_open_sockets = CONFIG_WIFI_CONNECT_HTTPD_MAX_SOCKETS;
+    config.lru_purge_enable = true;
+    config.open_fn = onSessionOpen;
+    config.close_fn = onSessionClose;
     config.max_uri_handlers = 16;
     config.uri_match_fn = httpd_uri_match_wildcard;
     ESP_ERROR_CHECK(httpd_start(&web_server, &config));
@@ -182,10 +498,12 @@ namespace wifi_connect {
       .uri = "/",
       .method = HTTP_GET,
       .handler = [](httpd_req_t *req) -> esp_err_t {
-        httpd_resp_send(req, index_html_start, strlen(index_html_start));
-        return ESP_OK;
+        auto *self = static_cast<Configurator *>(req->user_ctx);
+        self->admit(req, nullptr);
+        self->markStep(self->timeline.page_served_us);
+        return sendAsset(req, index_html_asset);
       },
-      .user_ctx = NULL
+      .user_ctx = this
     };
     ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &index_html));
 
@@ -194,188 +512,700 @@ namespace wifi_connect {
       .uri = "/scan",
       .method = HTTP_GET,
       .handler = [](httpd_req_t *req) -> esp_err_t {
-        esp_wifi_scan_start(nullptr, true);
-        uint16_t ap_num = 0;
-        esp_wifi_scan_get_ap_num(&ap_num);
-        wifi_ap_record_t *ap_records = (wifi_ap_record_t *)malloc(ap_num * sizeof(wifi_ap_record_t));
-        esp_wifi_scan_get_ap_records(&ap_num, ap_records);
+        auto *self = static_cast<Configurator *>(req->user_ctx);
+        if (!self->admit(req, &self->scan_limiter)) {
+          return ESP_OK;
+        }
+        self->markStep(self->timeline.scan_served_us);
+
+        // Serve the last snapshot at once, even an empty one; the page asks again soon while it is empty.
+        self->scan_manager.request();
 
         // Send the scan results as JSON.
-        char buffer[128];
         httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr_chunk(req, "[");
-        for (int i = 0; i < ap_num; i++) {
-          ESP_LOGI(TAG, "SSID: %s, RSSI: %d, Authmode: %d",
-            (char *)ap_records[i].ssid, ap_records[i].rssi, ap_records[i].authmode);
-          snprintf(buffer, sizeof(buffer), "{\"ssid\":\"%s\",\"rssi\":%d,\"authmode\":%d}",
-            (char *)ap_records[i].ssid, ap_records[i].rssi, ap_records[i].authmode);
-          httpd_resp_sendstr_chunk(req, buffer);
-          if (i < ap_num - 1) {
-            httpd_resp_sendstr_chunk(req, ",");
-          }
+        // Send from a copy, the snapshot must not stay locked while the socket blocks.
+        int64_t age_ms;
+        auto ap_records = self->scan_records;
+        size_t ap_num = self->scan_manager.copy(ap_records, ScanManager::MAX_RECORDS, age_ms);
+        char age[24];
+        snprintf(age, sizeof(age), "%lld", static_cast<long long>(age_ms));
+        httpd_resp_set_hdr(req, "X-Scan-Age", age);
+
+        char buffer[512];
+        JsonWriter writer(buffer, sizeof(buffer), [](void* ctx, const char* data, size_t len) {
+          return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len) == ESP_OK;
+        }, req);
+        writer.beginArray();
+        for (size_t i = 0; i < ap_num; i++) {
+          writer.beginObject();
+          writer.key("ssid");
+          writer.string(reinterpret_cast<const char*>(ap_records[i].ssid));
+          writer.key("rssi");
+          writer.number(ap_records[i].rssi);
+          writer.key("authmode");
+          writer.number(ap_records[i].authmode);
+          writer.endObject();
         }
-        httpd_resp_sendstr_chunk(req, "]");
-        httpd_resp_sendstr_chunk(req, NULL);
-        free(ap_records);
+        writer.endArray();
+        writer.finish();
+        httpd_resp_send_chunk(req, NULL, 0);
         return ESP_OK;
       },
-      .user_ctx = NULL
+      .user_ctx = this
     };
     ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &scan));
 
+    // Register the scan updates, pushed as server-sent events so one scan serves every open page.
+    httpd_uri_t scan_events = {
+      .uri = "/scan/events",
+      .method = HTTP_GET,
+      .handler = [](httpd_req_t *req) -> esp_err_t {
+        auto *self = static_cast<Configurator *>(req->user_ctx);
+        if (!self->admit(req, &self->scan_limiter)) {
+          return ESP_OK;
+        }
+        self->markStep(self->timeline.scan_served_us);
+        // Never wait for the first scan on the web server task, its results are pushed as they come.
+        self->scan_manager.request();
+
+        // Bring the list up to date first, so the new subscriber starts from what the others have.
+        self->publishScan();
+
+        xSemaphoreTake(self->scan_mutex, portMAX_DELAY);
+        auto slot = std::find(std::begin(self->scan_subscribers), std::end(self->scan_subscribers), nullptr);
+        if (slot != std::end(self->scan_subscribers)) {
+          httpd_resp_set_type(req, "text/event-stream");
+          httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+          // Detach the request, the stream is written from later scan snapshots.
+          if (httpd_req_async_handler_begin(req, slot) == ESP_OK) {
+            if (!self->sendScanEvent(*slot, true)) {
+              httpd_req_async_handler_complete(*slot);
+              *slot = nullptr;
+            }
+            xSemaphoreGive(self->scan_mutex);
+            return ESP_OK;
+          }
+          *slot = nullptr;
+        }
+        xSemaphoreGive(self->scan_mutex);
+
+        // The page falls back to polling /scan.
+        httpd_resp_set_type(req, "text/plain");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, NULL, 0);
+      },
+      .user_ctx = this
+    };
+    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &scan_events));
+
     // Register the form submission
     httpd_uri_t form_submit = {
       .uri = "/submit",
       .method = HTTP_POST,
       .handler = [](httpd_req_t *req) -> esp_err_t {
-        char buffer[128];
-        int ret = httpd_req_recv(req, buffer, sizeof(buffer));
-        if (ret <= 0) {
-          if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-            httpd_resp_send_408(req);
-          }
+        auto *self = static_cast<Configurator *>(req->user_ctx);
+        if (!self->admit(req, &self->submit_limiter)) {
+          return ESP_OK;
+        }
+        if (req->content_len > MAX_FORM_SIZE) {
+          httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Form too large");
           return ESP_FAIL;
         }
-        buffer[ret] = '\0';
-        ESP_LOGI(TAG, "Received form data: %s", buffer);
-
-        std::string decoded = urlDecode(buffer);
-        ESP_LOGI(TAG, "Decoded form data: %s", decoded.c_str());
 
-        // Parse the form data.
-        char ssid[32], password[64];
-        password[0] = '\0';  // Initialize password as empty.
-
-        // First extract SSID
-        if (sscanf(decoded.c_str(), "ssid=%32[^&]", ssid) != 1) {
+        // Parse the form data as it arrives, in any field order.
+        char ssid[33], password[65];
+        FormParser::Field fields[] = {
+          { "ssid", ssid, sizeof(ssid), 0, false },
+          { "password", password, sizeof(password), 0, false },
+        };
+        FormParser parser(fields, 2);
+        char buffer[64];
+        size_t remaining = req->content_len;
+        while (remaining > 0) {
+          int ret = httpd_req_recv(req, buffer, remaining < sizeof(buffer) ? remaining : sizeof(buffer));
+          if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+              httpd_resp_send_408(req);
+            }
+            return ESP_FAIL;
+          }
+          if (!parser.feed(buffer, ret)) {
+            break;
+          }
+          remaining -= ret;
+        }
+        if (remaining > 0 || !parser.finish() || fields[0].length == 0) {
           httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid SSID");
           return ESP_FAIL;
         }
+        ESP_LOGI(TAG, "Received SSID %s", ssid);
 
-        // Then look for password if present.
-        auto pwd_pos = decoded.find("&password=");
-        if (pwd_pos != std::string::npos) {
-          strncpy(password, decoded.c_str() + pwd_pos + 10, sizeof(password) - 1);
-          password[sizeof(password) - 1] = '\0';  // Ensure null termination.
-        }
+        // Connect in the background; the page follows the progress through /status.
+        ++self->timeline.submits;
+        self->timeline.submitted_us = esp_timer_get_time() - self->start_time;
+        uint32_t seq = self->startConnectJob(ssid, password);
 
-        // Get this object from the user context.
+        char body[32];
+        snprintf(body, sizeof(body), "{\"seq\":%lu}", static_cast<unsigned long>(seq));
+        httpd_resp_set_status(req, "202 Accepted");
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, body);
+        return ESP_OK;
+      },
+      .user_ctx = this
+    };
+    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &form_submit));
+
+    // Register the connection status, answered when the state differs from the given sequence number.
+    httpd_uri_t status = {
+      .uri = "/status",
+      .method = HTTP_GET,
+      .handler = [](httpd_req_t *req) -> esp_err_t {
         auto *self = static_cast<Configurator *>(req->user_ctx);
-        if (!self->connectToWifi(ssid, password)) {
-          char error[] = "Failed to connect to WiFi";
-          char location[128];
-          snprintf(location, sizeof(location), "/?error=%s&ssid=%s", error, ssid);
-
-          httpd_resp_set_status(req, "302 Found");
-          httpd_resp_set_hdr(req, "Location", location);
-          httpd_resp_send(req, NULL, 0);
-          return ESP_OK;
-        }
+        self->admit(req, nullptr);
 
-        // Set HTML response.
-        httpd_resp_set_status(req, "200 OK");
-        httpd_resp_set_type(req, "text/html");
-        httpd_resp_send(req, done_html_start, HTTPD_RESP_USE_STRLEN);
+        char query[32], value[12];
+        bool has_seq = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+          && httpd_query_key_value(query, "seq", value, sizeof(value)) == ESP_OK;
+        uint32_t seq = has_seq ? strtoul(value, nullptr, 10) : 0;
 
-        // Restart after 3 seconds.
-        xTaskCreate([](void *self) {
-          ESP_LOGI(TAG, "Restarting in 3 seconds...");
-          vTaskDelay(pdMS_TO_TICKS(3000));
-          esp_restart();
-        }, "restart_task", 4096, self, 5, NULL);
+        xSemaphoreTake(self->job_mutex, portMAX_DELAY);
+        if (has_seq && seq == self->job_seq) {
+          // Long poll without holding the httpd task: detach the request until the state changes.
+          auto waiter = std::find_if(std::begin(self->status_waiters), std::end(self->status_waiters),
+            [](const StatusWaiter& waiter) { return waiter.req == nullptr; });
+          if (waiter != std::end(self->status_waiters) && httpd_req_async_handler_begin(req, &waiter->req) == ESP_OK) {
+            waiter->deadline = esp_timer_get_time() + STATUS_LONG_POLL_MS * 1000ll;
+            xSemaphoreGive(self->job_mutex);
+            return ESP_OK;
+          }
+          if (waiter != std::end(self->status_waiters)) {
+            waiter->req = nullptr;
+          }
+          xSemaphoreGive(self->job_mutex);
+
+          // An unchanged state answered at once would only bring the request straight back.
+          httpd_resp_set_status(req, "503 Service Unavailable");
+          httpd_resp_set_hdr(req, "Retry-After", "1");
+          httpd_resp_set_type(req, "text/plain");
+          return httpd_resp_send(req, NULL, 0);
+        }
+        auto status = self->getConnectStatus();
+        xSemaphoreGive(self->job_mutex);
+        sendConnectStatus(req, status);
         return ESP_OK;
       },
       .user_ctx = this
     };
-    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &form_submit));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &status));
 
-    auto captive_portal_handler = [](httpd_req_t *req) -> esp_err_t {
-      auto *self = static_cast<Configurator *>(req->user_ctx);
-      std::string url = self->getWebServerUrl() + "/";
-      // Set content type to prevent browser warnings.
-      httpd_resp_set_type(req, "text/html");
-      httpd_resp_set_status(req, "302 Found");
-      httpd_resp_set_hdr(req, "Location", url.c_str());
-      httpd_resp_send(req, NULL, 0);
-      return ESP_OK;
+    // Register the page shown once connected.
+    httpd_uri_t done_html = {
+      .uri = "/done",
+      .method = HTTP_GET,
+      .handler = [](httpd_req_t *req) -> esp_err_t {
+        static_cast<Configurator *>(req->user_ctx)->admit(req, nullptr);
+        return sendAsset(req, done_html_asset);
+      },
+      .user_ctx = this
     };
+    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &done_html));
+
+    snprintf(redirect_location, sizeof(redirect_location), "http://%s/", ap_ip.c_str());
 
-    // Register all common captive portal detection endpoints.
-    const char* captive_portal_urls[] = {
-      "/hotspot-detect.html",     // Apple
-      "/generate_204",            // Android
-      "/mobile/status.php",       // Android
-      "/check_network_status.txt",// Windows
-      "/ncsi.txt",                // Windows
-      "/fwlink/",                 // Microsoft
-      "/connectivity-check.html", // Firefox
-      "/success.txt",             // Various
-      "/portal.html",             // Various
-      "/library/test/success.html"// Apple
+    // Register the captive portal API (RFC 8908) advertised by DHCP.
+    httpd_uri_t portal_api = {
+      .uri = "/captive-portal/api",
+      .method = HTTP_GET,
+      .handler = [](httpd_req_t *req) -> esp_err_t {
+        auto *self = static_cast<Configurator *>(req->user_ctx);
+        self->admit(req, nullptr);
+        ++self->timeline.portal_api_requests;
+        self->markStep(self->timeline.portal_api_us);
+
+        // The client stays captive until the provisioning is done and the access point goes away.
+        char body[80];
+        snprintf(body, sizeof(body), "{\"captive\":true,\"user-portal-url\":\"%s\"}", self->redirect_location);
+        httpd_resp_set_type(req, "application/captive+json");
+        httpd_resp_set_hdr(req, "Cache-Control", "private");
+        return httpd_resp_sendstr(req, body);
+      },
+      .user_ctx = this
     };
+    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &portal_api));
 
-    for (const auto& url : captive_portal_urls) {
-      httpd_uri_t redirect_uri = {
-        .uri = url,
-        .method = HTTP_GET,
-        .handler = captive_portal_handler,
-        .user_ctx = this
-      };
-      ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &redirect_uri));
-    }
+    // Redirect the captive portal detection requests to the provisioning page.
+    // Registered last, so that it only sees the URIs no other handler matched.
+    httpd_uri_t captive_portal = {
+      .uri = "/*",
+      .method = HTTP_GET,
+      .handler = [](httpd_req_t *req) -> esp_err_t {
+        auto *self = static_cast<Configurator *>(req->user_ctx);
+        self->admit(req, nullptr);
+        std::string_view path(req->uri, strcspn(req->uri, "?"));
+        if (!std::binary_search(std::begin(captive_portal_paths), std::end(captive_portal_paths), path)) {
+          return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+        }
+        ++self->timeline.probe_redirects;
+        self->markStep(self->timeline.probe_redirected_us);
+        // Set content type to prevent browser warnings.
+        httpd_resp_set_type(req, "text/html");
+        httpd_resp_set_status(req, "302 Found");
+        httpd_resp_set_hdr(req, "Location", self->redirect_location);
+        return httpd_resp_send(req, NULL, 0);
+      },
+      .user_ctx = this
+    };
+    ESP_ERROR_CHECK(httpd_register_uri_handler(web_server, &captive_portal));
 
     ESP_LOGI(TAG, "Web server started");
   }
 
-  /// @brief Connect to the WiFi.
-  /// @param ssid The SSID.
-  /// @param password The password.
-  /// @return True if the connection was successful, false otherwise.
-  bool Configurator::connectToWifi(const char* ssid, const char* password) {
+  uint32_t Configurator::startConnectJob(const char* ssid, const char* password) {
+    // Keep the radio on the AP channel and out of scans while connecting.
+    scan_manager.pause();
+    esp_timer_stop(job_timer);
+
+    // The disconnect event of an attempt in progress or connected comes asynchronously, and must not fail the new one.
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    job_aborting = (job_state == ConnectState::Connecting || job_state == ConnectState::ObtainingIP
+      || job_state == ConnectState::Connected);
+    bool aborting = job_aborting;
+    xSemaphoreGive(job_mutex);
+    xSemaphoreTake(job_disconnected, 0);
+    esp_wifi_disconnect();
+    if (aborting && xSemaphoreTake(job_disconnected, pdMS_TO_TICKS(DISCONNECT_TIMEOUT_MS)) != pdTRUE) {
+      ESP_LOGW(TAG, "No disconnect event from the previous attempt");
+    }
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    job_aborting = false;
+    xSemaphoreGive(job_mutex);
+
     wifi_config_t wifi_config;
     bzero(&wifi_config, sizeof(wifi_config));
-    strcpy((char *)wifi_config.sta.ssid, ssid);
-    strcpy((char *)wifi_config.sta.password, password);
+    // A 32-byte SSID or 64-byte key fills its field without a terminator.
+    memcpy(wifi_config.sta.ssid, ssid, strnlen(ssid, sizeof(wifi_config.sta.ssid)));
+    memcpy(wifi_config.sta.password, password, strnlen(password, sizeof(wifi_config.sta.password)));
     wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
     wifi_config.sta.failure_retry_cnt = 1;
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
 
+    setConnectState(ConnectState::Connecting, 0);
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    uint32_t seq = job_seq;
+    xSemaphoreGive(job_mutex);
+
+    stats.beginAttempt();
     auto ret = esp_wifi_connect();
     if (ret != ESP_OK) {
       ESP_LOGE(TAG, "Failed to connect to WiFi, error: %d", ret);
-      return false;
+      setConnectState(ConnectState::Failed, 0);
+      return seq;
     }
     ESP_LOGI(TAG, "Connecting to WiFi %s", ssid);
+    esp_timer_start_once(job_timer, CONNECT_TIMEOUT_MS * 1000ull);
+    return seq;
+  }
+
+  bool Configurator::setConnectState(ConnectState state, uint16_t reason, uint32_t from, const char* ip) {
+    httpd_req_t* reqs[MAX_STATUS_WAITERS] = {};
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    if ((from & (1u << static_cast<int>(job_state))) == 0) {
+      xSemaphoreGive(job_mutex);
+      return false;
+    }
+    job_state = state;
+    job_reason = reason;
+    if (ip != nullptr) {
+      snprintf(job_ip, sizeof(job_ip), "%s", ip);
+    }
+    ++job_seq;
+    for (size_t i = 0; i < MAX_STATUS_WAITERS; ++i) {
+      reqs[i] = status_waiters[i].req;
+      status_waiters[i].req = nullptr;
+    }
+    auto status = getConnectStatus();
+    xSemaphoreGive(job_mutex);
+    completeStatusWaiters(reqs, MAX_STATUS_WAITERS, status);
 
-    // Wait for the connection to complete for 10 seconds.
-    EventBits_t bits = xEventGroupWaitBits(event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
-    if (bits & WIFI_CONNECTED_BIT) {
-      ESP_LOGI(TAG, "Connected to WiFi %s", ssid);
+    if (state == ConnectState::Connected || state == ConnectState::Failed) {
+      stats.endAttempt(state == ConnectState::Connected);
+    }
+    if (state == ConnectState::Failed) {
+      scan_manager.resume();
+    }
+    return true;
+  }
+
+  void Configurator::releaseStatusWaiters(bool all) {
+    httpd_req_t* reqs[MAX_STATUS_WAITERS] = {};
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_STATUS_WAITERS; ++i) {
+      if (status_waiters[i].req && (all || now >= status_waiters[i].deadline)) {
+        reqs[i] = status_waiters[i].req;
+        status_waiters[i].req = nullptr;
+      }
+    }
+    auto status = getConnectStatus();
+    xSemaphoreGive(job_mutex);
+    completeStatusWaiters(reqs, MAX_STATUS_WAITERS, status);
+  }
+
+  Configurator::ConnectStatus Configurator::getConnectStatus() const {
+    ConnectStatus status;
+    status.seq = job_seq;
+    status.state = job_state;
+    status.reason = job_reason;
+    memcpy(status.ip, job_ip, sizeof(status.ip));
+    return status;
+  }
+
+  void Configurator::sendConnectStatus(httpd_req_t *req, const ConnectStatus& status) {
+    char buffer[128];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    JsonWriter writer(buffer, sizeof(buffer), [](void* ctx, const char* data, size_t len) {
+      return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len) == ESP_OK;
+    }, req);
+    writer.beginObject();
+    writer.key("seq");
+    writer.number(status.seq);
+    writer.key("state");
+    writer.string(getConnectStateName(status.state));
+    if (status.state == ConnectState::Failed) {
+      writer.key("reason");
+      writer.number(status.reason);
+    } else if (status.state == ConnectState::Connected) {
+      writer.key("ip");
+      writer.string(status.ip);
+    }
+    writer.endObject();
+    writer.finish();
+    httpd_resp_send_chunk(req, NULL, 0);
+  }
+
+  void Configurator::completeStatusWaiters(httpd_req_t** reqs, size_t count, const ConnectStatus& status) {
+    for (size_t i = 0; i < count; ++i) {
+      if (reqs[i]) {
+        sendConnectStatus(reqs[i], status);
+        httpd_req_async_handler_complete(reqs[i]);
+      }
+    }
+  }
+
+  bool Configurator::admit(httpd_req_t *req, RateLimiter* limiter) {
+    ++timeline.http_requests;
+    int fd = httpd_req_to_sockfd(req);
+    int64_t now = esp_timer_get_time();
+    uint32_t client = 0;
+    for (auto& session : sessions) {
+      if (session.fd == fd) {
+        session.last_active = now;
+        client = session.client;
+        break;
+      }
+    }
+
+    // The page and the captive portal probes are never limited, only the endpoints that cost radio time.
+    if (limiter == nullptr) {
       return true;
+    }
+    int64_t wait = limiter->acquire(client != 0 ? client : getClient(fd), now);
+    if (wait == 0) {
+      return true;
+    }
+    ++admission_counters.throttled;
+    char retry_after[12];
+    snprintf(retry_after, sizeof(retry_after), "%lu", static_cast<unsigned long>((wait + 999999) / 1000000));
+    httpd_resp_set_status(req, "429 Too Many Requests");
+    httpd_resp_set_hdr(req, "Retry-After", retry_after);
+    httpd_resp_send(req, NULL, 0);
+    return false;
+  }
+
+  void Configurator::evictIdleSessions() {
+    // Keep the sockets of the detached status and scan requests, they are only quiet until there is news.
+    int waiting[MAX_STATUS_WAITERS + MAX_SCAN_SUBSCRIBERS];
+    xSemaphoreTake(job_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_STATUS_WAITERS; ++i) {
+      waiting[i] = status_waiters[i].req ? httpd_req_to_sockfd(status_waiters[i].req) : -1;
+    }
+    xSemaphoreGive(job_mutex);
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_SCAN_SUBSCRIBERS; ++i) {
+      waiting[MAX_STATUS_WAITERS + i] = scan_subscribers[i] ? httpd_req_to_sockfd(scan_subscribers[i]) : -1;
+    }
+    xSemaphoreGive(scan_mutex);
+
+    int64_t now = esp_timer_get_time();
+    for (auto& session : sessions) {
+      if (session.fd < 0 || now - session.last_active < SESSION_IDLE_TIMEOUT_MS * 1000ll
+        || std::find(std::begin(waiting), std::end(waiting), session.fd) != std::end(waiting)) {
+        continue;
+      }
+      if (httpd_sess_trigger_close(web_server, session.fd) == ESP_OK) {
+        ++admission_counters.evicted;
+        // Do not count it twice before the close callback runs.
+        session.last_active = now;
+      }
+    }
+  }
+
+  void Configurator::publishScan() {
+    bool changed = false;
+    scan_manager.read([this, &changed](const wifi_ap_record_t* ap_records, size_t ap_num, int64_t age_ms) {
+      changed = scan_feed.update(ap_records, ap_num);
+    });
+    if (!changed) {
+      return;
+    }
+
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    for (auto& subscriber : scan_subscribers) {
+      if (subscriber && !sendScanEvent(subscriber, false)) {
+        httpd_req_async_handler_complete(subscriber);
+        subscriber = nullptr;
+      }
+    }
+    xSemaphoreGive(scan_mutex);
+  }
+
+  void Configurator::serviceScanSubscribers() {
+    int64_t now = esp_timer_get_time();
+    bool keepalive = now - scan_keepalive >= SCAN_KEEPALIVE_MS * 1000ll;
+    bool subscribed = false;
+
+    // A comment line keeps the stream open through idle periods and finds the pages that went away.
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    for (auto& subscriber : scan_subscribers) {
+      if (subscriber == nullptr) {
+        continue;
+      }
+      if (keepalive && httpd_resp_send_chunk(subscriber, ":\n\n", 3) != ESP_OK) {
+        httpd_req_async_handler_complete(subscriber);
+        subscriber = nullptr;
+        continue;
+      }
+      subscribed = true;
+    }
+    xSemaphoreGive(scan_mutex);
+    if (keepalive) {
+      scan_keepalive = now;
+    }
+
+    // The snapshot time to live sets the pace of the scans, whatever the number of pages.
+    if (subscribed) {
+      scan_manager.request();
+    }
+  }
+
+  bool Configurator::sendScanEvent(httpd_req_t *req, bool full) {
+    if (httpd_resp_send_chunk(req, "data: ", 6) != ESP_OK) {
+      return false;
+    }
+    char buffer[256];
+    JsonWriter writer(buffer, sizeof(buffer), [](void* ctx, const char* data, size_t len) {
+      return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len) == ESP_OK;
+    }, req);
+    if (full) {
+      scan_feed.writeFull(writer);
     } else {
-      ESP_LOGE(TAG, "Failed to connect to WiFi %s", ssid);
+      scan_feed.writeDelta(writer);
+    }
+    if (!writer.finish() || httpd_resp_send_chunk(req, "\n\n", 2) != ESP_OK) {
       return false;
     }
+    ++timeline.scan_events;
+    return true;
+  }
+
+  void Configurator::onScanSnapshot(void* ctx) {
+    auto self = static_cast<Configurator*>(ctx);
+    if (self->web_server != nullptr) {
+      httpd_queue_work(self->web_server, [](void* arg) {
+        static_cast<Configurator*>(arg)->publishScan();
+      }, self);
+    }
+  }
+
+  esp_err_t Configurator::onSessionOpen(httpd_handle_t handle, int fd) {
+    auto& self = getInstance();
+    ++self.admission_counters.sessions_opened;
+
+    uint32_t client = getClient(fd);
+    for (auto& session : self.sessions) {
+      if (session.fd < 0) {
+        session = { fd, client, esp_timer_get_time() };
+        break;
+      }
+    }
+    return ESP_OK;
   }
 
-  std::string Configurator::urlDecode(const std::string &url) {
-    std::string decoded;
-    for (size_t i = 0; i < url.length(); ++i) {
-      if (url[i] == '%') {
-        char hex[3];
-        hex[0] = url[i + 1];
-        hex[1] = url[i + 2];
-        hex[2] = '\0';
-        char ch = static_cast<char>(std::stoi(hex, nullptr, 16));
-        decoded += ch;
-        i += 2;
-      } else if (url[i] == '+') {
-        decoded += ' ';
-      } else {
-        decoded += url[i];
+  uint32_t Configurator::getClient(int fd) {
+    // Clients are identified by address, the IPv4 one even on an IPv6 socket.
+    sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    uint32_t client = 0;
+    if (getpeername(fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) == 0) {
+      if (addr.ss_family == AF_INET) {
+        client = reinterpret_cast<sockaddr_in*>(&addr)->sin_addr.s_addr;
+      } else if (addr.ss_family == AF_INET6) {
+        memcpy(&client, reinterpret_cast<sockaddr_in6*>(&addr)->sin6_addr.s6_addr + 12, sizeof(client));
       }
     }
-    return decoded;
+    // The limiter keeps its free slots as client 0, which must not be handed out.
+    return client != 0 ? client : UNKNOWN_CLIENT;
+  }
+
+  void Configurator::onSessionClose(httpd_handle_t handle, int fd) {
+    for (auto& session : getInstance().sessions) {
+      if (session.fd == fd) {
+        session.fd = -1;
+      }
+    }
+    // A close callback owns the socket.
+    close(fd);
+  }
+
+  void Configurator::markStep(std::atomic<int64_t>& step) {
+    // Only the first of the tasks racing for a milestone sets it.
+    int64_t unset = 0;
+    step.compare_exchange_strong(unset, esp_timer_get_time() - start_time);
+  }
+
+  void Configurator::logProvisioningReport() {
+    auto report = getProvisioningTimeline();
+    int64_t total_us = report.connected_us - report.station_joined_us;
+
+    // One line with a fixed prefix, easy to extract from a serial log for trend tracking.
+    // The whole report is collected before it is logged, a line per buffer flush would not parse;
+    // the buffer holds it even with every number at its widest.
+    char buffer[512];
+    size_t report_len = 0;
+    JsonWriter writer(buffer, sizeof(buffer), [](void* ctx, const char* data, size_t len) {
+      // Only the final flush may come, a flush of a full buffer means the report does not fit.
+      auto report_len = static_cast<size_t*>(ctx);
+      if (*report_len != 0) {
+        return false;
+      }
+      *report_len = len;
+      return true;
+    }, &report_len);
+    writer.beginObject();
+    writer.key("total_ms");
+    writer.number(total_us / 1000);
+    writer.key("steps_ms");
+    writer.beginObject();
+    const std::pair<const char*, int64_t> steps[] = {
+      { "station_joined", report.station_joined_us },
+      { "dns_query", report.dns_query_us },
+      { "probe_redirected", report.probe_redirected_us },
+      { "portal_api", report.portal_api_us },
+      { "page_served", report.page_served_us },
+      { "scan_served", report.scan_served_us },
+      { "submitted", report.submitted_us },
+      { "connected", report.connected_us },
+    };
+    for (const auto& step : steps) {
+      writer.key(step.first);
+      writer.number(step.second > 0 ? step.second / 1000 : -1);
+    }
+    writer.endObject();
+    writer.key("dns_queries");
+    writer.number(report.dns_queries);
+    writer.key("http_requests");
+    writer.number(report.http_requests);
+    writer.key("scan_events");
+    writer.number(report.scan_events);
+    writer.key("probe_redirects");
+    writer.number(report.probe_redirects);
+    writer.key("portal_api_requests");
+    writer.number(report.portal_api_requests);
+    writer.key("submits");
+    writer.number(report.submits);
+    writer.endObject();
+    if (!writer.finish()) {
+      ESP_LOGW(TAG, "Provisioning report too long");
+      return;
+    }
+    ESP_LOGI(TAG, "Provisioning report: %.*s", static_cast<int>(report_len), buffer);
+  }
+
+  const char* Configurator::getConnectStateName(ConnectState state) {
+    switch (state) {
+      case ConnectState::Idle:
+        return "idle";
+      case ConnectState::Connecting:
+        return "connecting";
+      case ConnectState::ObtainingIP:
+        return "obtaining_ip";
+      case ConnectState::Connected:
+        return "connected";
+      case ConnectState::Failed:
+        return "failed";
+    }
+    return "unknown";
+  }
+
+  esp_err_t Configurator::sendAsset(httpd_req_t *req, const WebAsset& asset) {
+    char value[128];
+
+    // Each encoding is a representation of its own, with its own entity tag.
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept-Encoding", value, sizeof(value));
+    bool gzip = (err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC) && isGzipAccepted(value);
+    const char* etag = gzip ? asset.gzip_etag : asset.etag;
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    // The assets only change with the firmware, so a matching ETag needs no body.
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) == ESP_OK
+      && strstr(value, etag) != nullptr) {
+      httpd_resp_set_status(req, "304 Not Modified");
+      return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset.content_type);
+    if (gzip) {
+      httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+      return httpd_resp_send(req, reinterpret_cast<const char*>(asset.gzip_data), asset.gzip_size);
+    }
+    return httpd_resp_send(req, reinterpret_cast<const char*>(asset.data), asset.size);
+  }
+
+  bool Configurator::isGzipAccepted(const char* accept_encoding) {
+    // A list of codings with optional parameters, e.g. "gzip;q=0.5, br, *;q=0".
+    int wildcard = -1;
+    const char* p = accept_encoding;
+    while (*p != '\0') {
+      while (*p == ' ' || *p == '\t' || *p == ',') {
+        ++p;
+      }
+      const char* name = p;
+      while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+        ++p;
+      }
+      size_t name_len = p - name;
+
+      // Only the quality matters, and 0 means not acceptable.
+      bool accepted = true;
+      while (*p != '\0' && *p != ',') {
+        if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=' && (p[-1] == ';' || p[-1] == ' ')) {
+          accepted = strtod(p + 2, nullptr) > 0;
+        }
+        ++p;
+      }
+
+      if ((name_len == 4 && strncasecmp(name, "gzip", 4) == 0) || (name_len == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+        return accepted;
+      }
+      if (name_len == 1 && name[0] == '*') {
+        wildcard = accepted;
+      }
+    }
+    return wildcard == 1;
   }
 
   void Configurator::wifiEventHandler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
@@ -384,13 +1214,29 @@ namespace wifi_connect {
     if (event_id == WIFI_EVENT_AP_STACONNECTED) {
       wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data;
       ESP_LOGI(TAG, "Station " MACSTR " joined, AID=%d", MAC2STR(event->mac), event->aid);
+      self->markStep(self->timeline.station_joined_us);
     } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
       wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data;
       ESP_LOGI(TAG, "Station " MACSTR " left, AID=%d", MAC2STR(event->mac), event->aid);
     } else if (event_id == WIFI_EVENT_STA_CONNECTED) {
-      xEventGroupSetBits(self->event_group, WIFI_CONNECTED_BIT);
+      self->stats.onAssociated();
+      self->setConnectState(ConnectState::ObtainingIP, 0, 1u << static_cast<int>(ConnectState::Connecting));
     } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
-      xEventGroupSetBits(self->event_group, WIFI_FAIL_BIT);
+      wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+      self->stats.onDisconnected(event->reason);
+      xSemaphoreTake(self->job_mutex, portMAX_DELAY);
+      bool aborted = self->job_aborting;
+      self->job_aborting = false;
+      xSemaphoreGive(self->job_mutex);
+      if (aborted) {
+        // The end of the previous attempt, asked for by startConnectJob().
+        xSemaphoreGive(self->job_disconnected);
+        return;
+      }
+      if (self->setConnectState(ConnectState::Failed, event->reason, PENDING_CONNECT_STATES)) {
+        ESP_LOGE(TAG, "Failed to connect to WiFi, reason: %d", event->reason);
+        esp_timer_stop(self->job_timer);
+      }
     }
   }
 
@@ -400,7 +1246,41 @@ namespace wifi_connect {
     if (event_id == IP_EVENT_STA_GOT_IP) {
       ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
       ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-      xEventGroupSetBits(self->event_group, WIFI_CONNECTED_BIT);
+      // Only complete a job still in progress, the timeout may have failed it meanwhile.
+      char ip[16];
+      esp_ip4addr_ntoa(&event->ip_info.ip, ip, sizeof(ip));
+      self->stats.onGotIP();
+      if (!self->setConnectState(ConnectState::Connected, 0, PENDING_CONNECT_STATES, ip)) {
+        return;
+      }
+      esp_timer_stop(self->job_timer);
+      self->markStep(self->timeline.connected_us);
+      self->logProvisioningReport();
+
+      // Leave the page 3 seconds to show the result and load the done page.
+      if (self->hand_off) {
+        self->startWorker([](void *arg) {
+          ESP_LOGI(TAG, "Handing off the connection in 3 seconds...");
+          vTaskDelay(pdMS_TO_TICKS(3000));
+          static_cast<Configurator*>(arg)->handOff();
+          vTaskDelete(NULL);
+        }, "hand_off_task");
+        return;
+      }
+
+      // Remember the network, then restart.
+      self->startWorker([](void *self) {
+        // Keep the security of the network joined as the minimum, so it cannot be downgraded later.
+        wifi_config_t wifi_config;
+        wifi_ap_record_t ap_info;
+        if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK && esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+          Connector::getInstance().addNetwork(reinterpret_cast<const char*>(wifi_config.sta.ssid),
+            reinterpret_cast<const char*>(wifi_config.sta.password), Connector::getThresholdAuthMode(ap_info.authmode), 0);
+        }
+        ESP_LOGI(TAG, "Restarting in 3 seconds...");
+        vTaskDelay(pdMS_TO_TICKS(3000));
+        esp_restart();
+      }, "restart_task");
     }
   }
 
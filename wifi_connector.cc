@@ -1,6 +1,8 @@
 #include "wifi_connector.hh"
 
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
 
 #include <freertos/FreeRTOS.h>
 
@@ -9,17 +11,64 @@
 #include <esp_event.h>
 #include <esp_mac.h>
 #include <esp_netif.h>
+#include <esp_random.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 
+#include <nvs.h>
+
+#include <esp_netif_net_stack.h>
+
+#include <lwip/dhcp.h>
+#include <lwip/etharp.h>
 #include <lwip/inet.h>
+#include <lwip/tcpip.h>
+#if __has_include(<lwip/acd.h>)
+#include <lwip/acd.h>
+#endif
+
+// Probe the cached lease the RFC 5227 way when lwIP has address conflict detection.
+#if defined(LWIP_ACD) && LWIP_ACD
+#define LEASE_PROBE_ACD 1
+#else
+#define LEASE_PROBE_ACD 0
+#endif
 
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
+#define NVS_NAMESPACE            "wifi_connect"
+#define NVS_KEY_FAST_CONNECT     "fast_connect"
+#define NVS_KEY_LEASE            "lease"
+// The namespace the driver persists its configuration in, created on its first write.
+#define NVS_NAMESPACE_DRIVER     "nvs.net80211"
+
+#define FAST_CONNECT_TIMEOUT_MS  3000
+#define FULL_CONNECT_TIMEOUT_MS  10000
+#define DISCONNECT_TIMEOUT_MS    500
+#define LEASE_PROBE_WAIT_MS      1000
+#define GOT_IP_TIMEOUT_MS        10000
+
+// Earlier system times mean the clock was never set, and cannot date a lease.
+#define MIN_SYNCED_TIME          1704067200 // 2024-01-01
+
 namespace wifi_connect {
 
   #define TAG "wifi_connect::Connector"
 
+  /// @brief The probe of the cached lease address, handed to the TCP/IP task.
+  struct LeaseProbe {
+    struct tcpip_api_call_data call;
+    struct netif* netif;
+    ip4_addr_t ip;
+#if LEASE_PROBE_ACD
+    struct acd acd;
+    esp_timer_handle_t timer;
+#endif
+    volatile bool conflict;
+  };
+  static LeaseProbe lease_probe;
+
   ////////////////////////////////
   // Public methods
 
@@ -29,45 +78,41 @@ namespace wifi_connect {
   }
 
   bool Connector::isStored() {
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    wifi_config_t wifi_config;
-    esp_err_t err = esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
-
-    ESP_ERROR_CHECK(esp_wifi_deinit());
+    int64_t start_time = esp_timer_get_time();
 
+    // A device that was never provisioned has no driver namespace, no need to bring the driver up for it.
+    nvs_handle_t handle;
+    bool stored = false;
+    esp_err_t err = nvs_open(NVS_NAMESPACE_DRIVER, NVS_READONLY, &handle);
     if (err == ESP_OK) {
-      return strlen(reinterpret_cast<const char*>(wifi_config.sta.ssid)) > 0;
+      nvs_close(handle);
     }
-    return false;
+    if (err != ESP_ERR_NVS_NOT_FOUND) {
+      // Keep the driver initialised when a network is stored, connect() follows.
+      bool initialised = driver_initialised;
+      initDriver();
+      wifi_config_t wifi_config;
+      stored = esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK && wifi_config.sta.ssid[0] != 0;
+      if (!stored && !initialised) {
+        ESP_ERROR_CHECK(esp_wifi_deinit());
+        driver_initialised = false;
+      }
+    }
+
+    startup_timing.is_stored_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "isStored took %lld us, driver initialised %lu times, last in %lld us",
+      static_cast<long long>(startup_timing.is_stored_us), static_cast<unsigned long>(startup_timing.driver_inits),
+      static_cast<long long>(startup_timing.driver_init_us));
+    return stored;
   }
 
   bool Connector::connect(wifi_auth_mode_t auth_mode, const char* ssid, const char* password) {
-    ESP_ERROR_CHECK(
-      esp_event_handler_instance_register(
-        WIFI_EVENT,
-        ESP_EVENT_ANY_ID,
-        &Connector::wifiEventHandler,
-        this,
-        &any_id_handler
-      )
-    );
-
-    ESP_ERROR_CHECK(
-      esp_event_handler_instance_register(
-        IP_EVENT,
-        IP_EVENT_STA_GOT_IP,
-        &Connector::gotIPEventHandler,
-        this,
-        &got_ip_handler
-      )
-    );
+    registerEventHandlers();
 
     esp_netif_create_default_wifi_sta();
 
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // isStored() may have initialised the driver already.
+    initDriver();
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
@@ -80,34 +125,235 @@ namespace wifi_connect {
       return true;
     }
 
+    // The attempts below handle their own failures, keep the reconnection logic out of them.
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    auto_reconnect = false;
+    if (reconnect_timer) {
+      esp_timer_stop(reconnect_timer);
+    }
+    if (got_ip_timer) {
+      esp_timer_stop(got_ip_timer);
+    }
+    connecting = true;
+    xSemaphoreGive(reconnect_mutex);
+
+    int64_t start_time = esp_timer_get_time();
+    last_result = { false, ConnectPath::None, 0 };
+    profiles.load();
+
+    wifi_config_t wifi_config;
     if (ssid != nullptr && password != nullptr) {
-      wifi_config_t wifi_config;
       bzero(&wifi_config, sizeof(wifi_config));
       wifi_config.sta.threshold.authmode = auth_mode;
       wifi_config.sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
-      memset(wifi_config.sta.ssid, 0, sizeof(wifi_config.sta.ssid));
-      memcpy(wifi_config.sta.ssid, ssid, strlen(ssid));
-      memset(wifi_config.sta.password, 0, sizeof(wifi_config.sta.password));
-      memcpy(wifi_config.sta.password, password, strlen(password));
+      memcpy(wifi_config.sta.ssid, ssid, strnlen(ssid, sizeof(wifi_config.sta.ssid)));
+      memcpy(wifi_config.sta.password, password, strnlen(password, sizeof(wifi_config.sta.password)));
+      ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+      profiles.add(ssid, password, auth_mode, 0);
+    } else {
+      ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
     }
-    ESP_ERROR_CHECK(esp_wifi_connect());
 
-    // Wait for the connection to complete for 10 seconds.
-    bits = xEventGroupWaitBits(
-      event_group,
-      WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-      pdFALSE,
-      pdFALSE,
-      pdMS_TO_TICKS(10000)
-    );
-    if (bits & WIFI_CONNECTED_BIT) {
-      return true;
+    // The per-attempt tweaks below must not be persisted over the stored configuration.
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+
+    // Stick to the network given, or to the stored one when it changed since the cache was written.
+    FastConnectInfo info;
+    bool cached = loadFastConnectInfo(info);
+    memcpy(stored_ssid, wifi_config.sta.ssid, sizeof(stored_ssid));
+    const uint8_t* only_ssid = nullptr;
+    if ((ssid != nullptr && password != nullptr)
+      || (stored_ssid[0] != 0 && (!cached || memcmp(info.stored_ssid, stored_ssid, sizeof(stored_ssid)) != 0))) {
+      only_ssid = stored_ssid;
     }
 
-    return false;
+    // First try the access point of the last successful connection on its channel only.
+    wifi_config_t fast_config;
+    if (cached && (only_ssid == nullptr || memcmp(info.ssid, only_ssid, sizeof(info.ssid)) == 0)
+      && getNetworkConfig(info.ssid, wifi_config, fast_config)) {
+      if (lease_reuse) {
+        applyLease(info.ssid);
+      }
+      fast_config.sta.scan_method = WIFI_FAST_SCAN;
+      fast_config.sta.bssid_set = true;
+      memcpy(fast_config.sta.bssid, info.bssid, sizeof(info.bssid));
+      fast_config.sta.channel = info.channel;
+      // The same access point must not come back with a weaker security.
+      auto authmode = getThresholdAuthMode(static_cast<wifi_auth_mode_t>(info.authmode));
+      if (authmode > fast_config.sta.threshold.authmode) {
+        fast_config.sta.threshold.authmode = authmode;
+      }
+      if (tryConnect(fast_config, FAST_CONNECT_TIMEOUT_MS)) {
+        last_result = { true, ConnectPath::Fast, esp_timer_get_time() - start_time };
+        ESP_LOGI(TAG, "Fast reconnect took %lld ms", static_cast<long long>(last_result.duration_us / 1000));
+        onConnected(fast_config.sta.ssid);
+        return finishConnect(true);
+      }
+      ESP_LOGW(TAG, "Fast reconnect failed, falling back to a scan");
+      abortAttempt();
+      revertLease();
+    }
+
+    // Then scan once and try every known network found, best first.
+    if (profiles.getCount() > 0 && connectRanked(only_ssid)) {
+      last_result = { true, ConnectPath::Ranked, esp_timer_get_time() - start_time };
+      ESP_LOGI(TAG, "Ranked connect took %lld ms", static_cast<long long>(last_result.duration_us / 1000));
+      return finishConnect(true);
+    }
+
+    // Finally let the driver scan all channels for the stored network, which also finds hidden ones.
+    if (wifi_config.sta.ssid[0] != 0) {
+      wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+      wifi_config.sta.bssid_set = false;
+      wifi_config.sta.channel = 0;
+      if (lease_reuse) {
+        applyLease(wifi_config.sta.ssid);
+      }
+      if (tryConnect(wifi_config, FULL_CONNECT_TIMEOUT_MS)) {
+        last_result = { true, ConnectPath::Full, esp_timer_get_time() - start_time };
+        ESP_LOGI(TAG, "Full connect took %lld ms", static_cast<long long>(last_result.duration_us / 1000));
+        onConnected(wifi_config.sta.ssid);
+        return finishConnect(true);
+      }
+      revertLease();
+    }
+
+    profiles.save();
+    last_result.duration_us = esp_timer_get_time() - start_time;
+    return finishConnect(false);
+  }
+
+  bool Connector::adopt() {
+    wifi_ap_record_t ap_info;
+    auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+    wifi_config_t wifi_config;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK || netif == NULL
+      || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0
+      || esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+      ESP_LOGW(TAG, "No station connection to adopt");
+      return false;
+    }
+
+    registerEventHandlers();
+    driver_initialised = true;
+    char ip_str[16];
+    esp_ip4addr_ntoa(&ip_info.ip, ip_str, sizeof(ip_str));
+    ip = ip_str;
+    xEventGroupSetBits(event_group, WIFI_CONNECTED_BIT);
+
+    // Cache everything a real connect() would have, so the next boot reconnects fast.
+    memcpy(lease_ssid, wifi_config.sta.ssid, sizeof(lease_ssid));
+    memcpy(stored_ssid, wifi_config.sta.ssid, sizeof(stored_ssid));
+    if (lease_reuse) {
+      saveLease(ip_info);
+    }
+    profiles.load();
+    profiles.add(reinterpret_cast<const char*>(wifi_config.sta.ssid), reinterpret_cast<const char*>(wifi_config.sta.password),
+      getThresholdAuthMode(ap_info.authmode), 0);
+    onConnected(wifi_config.sta.ssid);
+
+    ESP_LOGI(TAG, "Adopted the connection to %.32s, IP %s", reinterpret_cast<const char*>(wifi_config.sta.ssid), ip_str);
+    finishConnect(true);
+    setLinkState(LinkState::Up);
+    return true;
+  }
+
+  void Connector::addNetwork(const char* ssid, const char* password, wifi_auth_mode_t auth_mode, int8_t priority) {
+    profiles.load();
+    profiles.add(ssid, password, auth_mode, priority);
+    profiles.save();
+    clearFastConnectInfo();
+  }
+
+  bool Connector::removeNetwork(const char* ssid) {
+    profiles.load();
+    bool removed = profiles.remove(ssid);
+    profiles.save();
+    return removed;
+  }
+
+  void Connector::setLeaseReuse(bool enable, uint32_t lease_time_s) {
+    this->lease_reuse = enable;
+    this->lease_time_s = lease_time_s;
+  }
+
+  void Connector::setReconnectPolicy(const ReconnectPolicy& policy) {
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    reconnect_policy = policy;
+    if (!policy.enabled) {
+      auto_reconnect = false;
+      if (reconnect_timer) {
+        esp_timer_stop(reconnect_timer);
+      }
+      if (got_ip_timer) {
+        esp_timer_stop(got_ip_timer);
+      }
+    }
+    xSemaphoreGive(reconnect_mutex);
+  }
+
+  bool Connector::subscribe(LinkStateCallback callback, void* ctx) {
+    bool subscribed = false;
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (auto& subscriber : subscribers) {
+      if (subscriber.callback == nullptr) {
+        subscriber = { callback, ctx };
+        subscribed = true;
+        break;
+      }
+    }
+    xSemaphoreGive(subscribers_mutex);
+    return subscribed;
+  }
+
+  void Connector::unsubscribe(LinkStateCallback callback, void* ctx) {
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (auto& subscriber : subscribers) {
+      if (subscriber.callback == callback && subscriber.ctx == ctx) {
+        subscriber = { nullptr, nullptr };
+      }
+    }
+    xSemaphoreGive(subscribers_mutex);
+  }
+
+  Connector::LinkState Connector::getLinkState() const {
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    LinkState state = link_state;
+    xSemaphoreGive(reconnect_mutex);
+    return state;
   }
 
   void Connector::disconnect() {
+    // Stop reconnecting before the link goes down on purpose.
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    auto_reconnect = false;
+    reconnect_attempts = 0;
+    if (reconnect_timer) {
+      esp_timer_stop(reconnect_timer);
+      esp_timer_delete(reconnect_timer);
+      reconnect_timer = nullptr;
+    }
+    if (got_ip_timer) {
+      esp_timer_stop(got_ip_timer);
+      esp_timer_delete(got_ip_timer);
+      got_ip_timer = nullptr;
+    }
+    xSemaphoreGive(reconnect_mutex);
+
+    stopLeaseProbe();
+    if (probe_timer) {
+      esp_timer_stop(probe_timer);
+      esp_timer_delete(probe_timer);
+      probe_timer = nullptr;
+    }
+    if (renew_timer) {
+      esp_timer_stop(renew_timer);
+      esp_timer_delete(renew_timer);
+      renew_timer = nullptr;
+    }
+    lease_applied = false;
+
     // Check whether the WiFi is already connected.
     EventBits_t bits = xEventGroupGetBits(event_group);
     if (bits & WIFI_CONNECTED_BIT) {
@@ -119,6 +365,7 @@ namespace wifi_connect {
     esp_wifi_stop();
 
     esp_wifi_deinit();
+    driver_initialised = false;
 
     auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
     if (netif != NULL) {
@@ -148,29 +395,689 @@ namespace wifi_connect {
     return ip;
   }
 
+  const Connector::ConnectResult& Connector::getLastResult() const {
+    return last_result;
+  }
+
+  const ConnectionStats& Connector::getConnectionStats() const {
+    return stats;
+  }
+
+  const Connector::StartupTiming& Connector::getStartupTiming() const {
+    return startup_timing;
+  }
+
   ////////////////////////////////
   // Private methods
 
   Connector::Connector()
     : any_id_handler(nullptr)
     , got_ip_handler(nullptr)
+    , last_result({ false, ConnectPath::None, 0 })
+    , startup_timing({ 0, 0, 0 })
+    , lease_reuse(false)
+    , lease_time_s(3600)
+    , lease_applied(false)
+    , lease_ssid()
+    , renew_timer(nullptr)
+    , probe_timer(nullptr)
+    , reconnect_policy({ true, 200, 2, 1000, 60000, 0 })
+    , reconnect_timer(nullptr)
+    , got_ip_timer(nullptr)
+    , reconnect_attempts(0)
+    , connecting(false)
+    , auto_reconnect(false)
+    , link_state(LinkState::Down)
+    , got_ip_timed_out(false)
+    , driver_initialised(false)
+    , stored_ssid()
+    , subscribers()
   {
     event_group = xEventGroupCreate();
+    reconnect_mutex = xSemaphoreCreateMutex();
+    subscribers_mutex = xSemaphoreCreateMutex();
   }
 
   Connector::~Connector() {
     disconnect();
+    vSemaphoreDelete(subscribers_mutex);
+    vSemaphoreDelete(reconnect_mutex);
     vEventGroupDelete(event_group);
   }
 
+  bool Connector::connectRanked(const uint8_t* only_ssid) {
+    if (esp_wifi_scan_start(nullptr, true) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to scan for the known networks");
+      return false;
+    }
+    uint16_t ap_num = CONFIG_WIFI_CONNECT_SCAN_MAX_RECORDS;
+#if CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+    auto ap_records = scan_records;
+#else
+    auto ap_records = static_cast<wifi_ap_record_t*>(malloc(ap_num * sizeof(wifi_ap_record_t)));
+#endif
+    if (ap_records == nullptr || esp_wifi_scan_get_ap_records(&ap_num, ap_records) != ESP_OK) {
+      esp_wifi_clear_ap_list();
+#if !CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+      free(ap_records);
+#endif
+      return false;
+    }
+
+    // Pick the strongest access point of every known network and rank the networks.
+    struct Candidate {
+      size_t profile;
+      int score;
+      uint8_t bssid[6];
+      uint8_t channel;
+    };
+    Candidate candidates[CredentialStore::MAX_PROFILES];
+    size_t candidate_count = 0;
+    for (size_t i = 0; i < profiles.getCount(); ++i) {
+      const auto& profile = profiles.get(i);
+      if (only_ssid != nullptr && memcmp(profile.ssid, only_ssid, sizeof(profile.ssid)) != 0) {
+        continue;
+      }
+      const wifi_ap_record_t* best = nullptr;
+      for (uint16_t j = 0; j < ap_num; ++j) {
+        if (strncmp(reinterpret_cast<const char*>(ap_records[j].ssid), reinterpret_cast<const char*>(profile.ssid), sizeof(profile.ssid)) == 0
+          && (best == nullptr || ap_records[j].rssi > best->rssi)) {
+          best = &ap_records[j];
+        }
+      }
+      if (best == nullptr) {
+        continue;
+      }
+
+      Candidate candidate = { i, profiles.score(i, best->rssi), {}, best->primary };
+      memcpy(candidate.bssid, best->bssid, sizeof(candidate.bssid));
+      size_t k = candidate_count++;
+      while (k > 0 && candidates[k - 1].score < candidate.score) {
+        candidates[k] = candidates[k - 1];
+        --k;
+      }
+      candidates[k] = candidate;
+    }
+#if !CONFIG_WIFI_CONNECT_STATIC_ALLOCATION
+    free(ap_records);
+#endif
+
+    // Try them in order, pinned to the access point found, without scanning again.
+    for (size_t i = 0; i < candidate_count; ++i) {
+      const auto& candidate = candidates[i];
+      wifi_config_t wifi_config;
+      getProfileConfig(profiles.get(candidate.profile), wifi_config);
+      wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+      wifi_config.sta.bssid_set = true;
+      memcpy(wifi_config.sta.bssid, candidate.bssid, sizeof(candidate.bssid));
+      wifi_config.sta.channel = candidate.channel;
+      ESP_LOGI(TAG, "Trying %.32s (score %d)", reinterpret_cast<const char*>(wifi_config.sta.ssid), candidate.score);
+      if (lease_reuse) {
+        applyLease(wifi_config.sta.ssid);
+      }
+      if (tryConnect(wifi_config, FULL_CONNECT_TIMEOUT_MS)) {
+        onConnected(wifi_config.sta.ssid);
+        return true;
+      }
+      abortAttempt();
+      revertLease();
+      profiles.recordFailure(candidate.profile);
+    }
+    return false;
+  }
+
+  bool Connector::getNetworkConfig(const uint8_t* ssid, const wifi_config_t& stored_config, wifi_config_t& wifi_config) {
+    if (memcmp(ssid, stored_config.sta.ssid, sizeof(stored_config.sta.ssid)) == 0) {
+      wifi_config = stored_config;
+      return true;
+    }
+    auto profile = profiles.find(ssid);
+    if (profile == nullptr) {
+      return false;
+    }
+    getProfileConfig(*profile, wifi_config);
+    return true;
+  }
+
+  void Connector::getProfileConfig(const CredentialStore::Profile& profile, wifi_config_t& wifi_config) {
+    bzero(&wifi_config, sizeof(wifi_config));
+    memcpy(wifi_config.sta.ssid, profile.ssid, sizeof(profile.ssid));
+    memcpy(wifi_config.sta.password, profile.password, sizeof(profile.password));
+    wifi_config.sta.threshold.authmode = static_cast<wifi_auth_mode_t>(profile.authmode);
+    wifi_config.sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
+  }
+
+  void Connector::onConnected(const uint8_t* ssid) {
+    saveFastConnectInfo(ssid, stored_ssid);
+    for (size_t i = 0; i < profiles.getCount(); ++i) {
+      if (memcmp(profiles.get(i).ssid, ssid, sizeof(profiles.get(i).ssid)) == 0) {
+        profiles.recordSuccess(i);
+        break;
+      }
+    }
+    profiles.save();
+  }
+
+  void Connector::revertLease() {
+    // Do not keep a possibly stale address on the next attempt.
+    if (lease_applied) {
+      lease_applied = false;
+      if (renew_timer) {
+        esp_timer_stop(renew_timer);
+      }
+      if (probe_timer) {
+        esp_timer_stop(probe_timer);
+      }
+      stopLeaseProbe();
+      auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+      if (netif != NULL) {
+        esp_netif_dhcpc_start(netif);
+      }
+    }
+  }
+
+  void Connector::registerEventHandlers() {
+    if (any_id_handler == nullptr) {
+      ESP_ERROR_CHECK(
+        esp_event_handler_instance_register(
+          WIFI_EVENT,
+          ESP_EVENT_ANY_ID,
+          &Connector::wifiEventHandler,
+          this,
+          &any_id_handler
+        )
+      );
+    }
+
+    if (got_ip_handler == nullptr) {
+      ESP_ERROR_CHECK(
+        esp_event_handler_instance_register(
+          IP_EVENT,
+          IP_EVENT_STA_GOT_IP,
+          &Connector::gotIPEventHandler,
+          this,
+          &got_ip_handler
+        )
+      );
+    }
+  }
+
+  void Connector::initDriver() {
+    if (driver_initialised) {
+      return;
+    }
+    int64_t start_time = esp_timer_get_time();
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    driver_initialised = true;
+    startup_timing.driver_init_us = esp_timer_get_time() - start_time;
+    ++startup_timing.driver_inits;
+  }
+
+  bool Connector::finishConnect(bool success) {
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    connecting = false;
+    reconnect_attempts = 0;
+    auto_reconnect = success && reconnect_policy.enabled;
+    xSemaphoreGive(reconnect_mutex);
+    return success;
+  }
+
+  void Connector::scheduleReconnect(uint16_t reason) {
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    const auto& policy = reconnect_policy;
+    if (!auto_reconnect || (policy.max_attempts != 0 && reconnect_attempts >= policy.max_attempts)) {
+      if (auto_reconnect) {
+        ESP_LOGW(TAG, "Giving up reconnecting after %lu attempts", static_cast<unsigned long>(reconnect_attempts));
+        auto_reconnect = false;
+      }
+      bool changed = link_state != LinkState::Down;
+      link_state = LinkState::Down;
+      xSemaphoreGive(reconnect_mutex);
+      if (changed) {
+        notifyLinkState(LinkState::Down);
+      }
+      return;
+    }
+
+    // Retry quickly after a loss that usually clears up by itself, back off exponentially otherwise.
+    uint64_t delay_ms;
+    if (isTransientReason(reason) && reconnect_attempts < policy.fast_attempts) {
+      delay_ms = policy.fast_delay_ms;
+    } else {
+      uint32_t exponent = reconnect_attempts < 16 ? reconnect_attempts : 16;
+      delay_ms = static_cast<uint64_t>(policy.initial_delay_ms) << exponent;
+      if (delay_ms > policy.max_delay_ms) {
+        delay_ms = policy.max_delay_ms;
+      }
+    }
+    // Spread the retries of devices that lost the same access point over the upper half of the delay.
+    delay_ms = delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+    uint32_t attempts = ++reconnect_attempts;
+
+    if (reconnect_timer == nullptr) {
+      esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+          auto self = static_cast<Connector*>(arg);
+          xSemaphoreTake(self->reconnect_mutex, portMAX_DELAY);
+          bool reconnect = self->auto_reconnect;
+          bool full_scan = self->reconnect_attempts > self->reconnect_policy.fast_attempts;
+          xSemaphoreGive(self->reconnect_mutex);
+          if (!reconnect) {
+            return;
+          }
+          // Past the fast attempts the access point may have moved, let the driver scan all channels.
+          wifi_config_t wifi_config;
+          if (full_scan && esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK && wifi_config.sta.bssid_set) {
+            wifi_config.sta.bssid_set = false;
+            wifi_config.sta.channel = 0;
+            wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+          }
+          self->stats.beginAttempt();
+          esp_err_t err = esp_wifi_connect();
+          if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to reconnect, error: %d", err);
+            self->stats.endAttempt(false);
+            self->scheduleReconnect(0);
+          }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "reconnect",
+        .skip_unhandled_events = true,
+      };
+      ESP_ERROR_CHECK(esp_timer_create(&timer_args, &reconnect_timer));
+    }
+    esp_timer_stop(reconnect_timer);
+    esp_timer_start_once(reconnect_timer, delay_ms * 1000);
+    bool changed = link_state != LinkState::Reconnecting;
+    link_state = LinkState::Reconnecting;
+    xSemaphoreGive(reconnect_mutex);
+
+    ESP_LOGI(TAG, "Reconnecting in %llu ms, attempt %lu, reason %u", static_cast<unsigned long long>(delay_ms),
+      static_cast<unsigned long>(attempts), reason);
+    if (changed) {
+      notifyLinkState(LinkState::Reconnecting);
+    }
+  }
+
+  void Connector::armGotIPTimeout() {
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    // Only the reconnections are bounded here, connect() bounds its own attempts.
+    if (!auto_reconnect || connecting || link_state != LinkState::Reconnecting) {
+      xSemaphoreGive(reconnect_mutex);
+      return;
+    }
+    if (got_ip_timer == nullptr) {
+      esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+          auto self = static_cast<Connector*>(arg);
+          xSemaphoreTake(self->reconnect_mutex, portMAX_DELAY);
+          bool timed_out = self->auto_reconnect && self->link_state == LinkState::Reconnecting;
+          self->got_ip_timed_out = timed_out;
+          xSemaphoreGive(self->reconnect_mutex);
+          // Associated without an address, e.g. the DHCP server is down: drop the link and back off.
+          if (timed_out) {
+            ESP_LOGW(TAG, "No IP address %d ms after associating", GOT_IP_TIMEOUT_MS);
+            esp_wifi_disconnect();
+          }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "got_ip_timeout",
+        .skip_unhandled_events = true,
+      };
+      ESP_ERROR_CHECK(esp_timer_create(&timer_args, &got_ip_timer));
+    }
+    esp_timer_stop(got_ip_timer);
+    esp_timer_start_once(got_ip_timer, GOT_IP_TIMEOUT_MS * 1000ull);
+    xSemaphoreGive(reconnect_mutex);
+  }
+
+  void Connector::setLinkState(LinkState state) {
+    xSemaphoreTake(reconnect_mutex, portMAX_DELAY);
+    bool changed = link_state != state;
+    link_state = state;
+    xSemaphoreGive(reconnect_mutex);
+    if (changed) {
+      notifyLinkState(state);
+    }
+  }
+
+  void Connector::notifyLinkState(LinkState state) {
+    // Call the subscribers without holding the mutex, so they may unsubscribe.
+    Subscriber current[MAX_SUBSCRIBERS];
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    memcpy(current, subscribers, sizeof(current));
+    xSemaphoreGive(subscribers_mutex);
+    for (const auto& subscriber : current) {
+      if (subscriber.callback) {
+        subscriber.callback(subscriber.ctx, state);
+      }
+    }
+  }
+
+  wifi_auth_mode_t Connector::getThresholdAuthMode(wifi_auth_mode_t joined) {
+    switch (joined) {
+      case WIFI_AUTH_WPA_WPA2_PSK:
+        return WIFI_AUTH_WPA_PSK;
+      case WIFI_AUTH_WPA2_WPA3_PSK:
+        return WIFI_AUTH_WPA2_PSK;
+      default:
+        return joined;
+    }
+  }
+
+  bool Connector::isTransientReason(uint16_t reason) {
+    switch (reason) {
+      case WIFI_REASON_BEACON_TIMEOUT:
+      case WIFI_REASON_ASSOC_LEAVE:
+      case WIFI_REASON_AUTH_EXPIRE:
+      case WIFI_REASON_ASSOC_EXPIRE:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool Connector::tryConnect(wifi_config_t& wifi_config, uint32_t timeout_ms) {
+    xEventGroupClearBits(event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    memcpy(lease_ssid, wifi_config.sta.ssid, sizeof(lease_ssid));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    stats.beginAttempt();
+    ESP_ERROR_CHECK(esp_wifi_connect());
+
+    EventBits_t bits = xEventGroupWaitBits(
+      event_group,
+      WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+      pdFALSE,
+      pdFALSE,
+      pdMS_TO_TICKS(timeout_ms)
+    );
+    bool success = (bits & WIFI_CONNECTED_BIT) != 0;
+    stats.endAttempt(success);
+    return success;
+  }
+
+  void Connector::abortAttempt() {
+    xEventGroupClearBits(event_group, WIFI_FAIL_BIT);
+    esp_wifi_disconnect();
+    xEventGroupWaitBits(event_group, WIFI_FAIL_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(DISCONNECT_TIMEOUT_MS));
+    xEventGroupClearBits(event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+  }
+
+  bool Connector::loadFastConnectInfo(FastConnectInfo& info) {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+      return false;
+    }
+    size_t size = sizeof(info);
+    esp_err_t err = nvs_get_blob(handle, NVS_KEY_FAST_CONNECT, &info, &size);
+    nvs_close(handle);
+    return err == ESP_OK && size == sizeof(info);
+  }
+
+  void Connector::saveFastConnectInfo(const uint8_t* ssid, const uint8_t* stored_ssid) {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+      return;
+    }
+
+    FastConnectInfo info;
+    memset(&info, 0, sizeof(info));
+    memcpy(info.ssid, ssid, sizeof(info.ssid));
+    memcpy(info.stored_ssid, stored_ssid, sizeof(info.stored_ssid));
+    memcpy(info.bssid, ap_info.bssid, sizeof(info.bssid));
+    info.channel = ap_info.primary;
+    info.authmode = ap_info.authmode;
+
+    // Skip the flash write when nothing changed.
+    FastConnectInfo stored;
+    if (loadFastConnectInfo(stored) && memcmp(&stored, &info, sizeof(info)) == 0) {
+      return;
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to open NVS to cache the access point");
+      return;
+    }
+    if (nvs_set_blob(handle, NVS_KEY_FAST_CONNECT, &info, sizeof(info)) == ESP_OK) {
+      nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+
+  void Connector::clearFastConnectInfo() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+      return;
+    }
+    if (nvs_erase_key(handle, NVS_KEY_FAST_CONNECT) == ESP_OK) {
+      nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+
+  void Connector::applyLease(const uint8_t* ssid) {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+      return;
+    }
+    LeaseInfo lease;
+    size_t size = sizeof(lease);
+    esp_err_t err = nvs_get_blob(handle, NVS_KEY_LEASE, &lease, &size);
+    nvs_close(handle);
+    if (err != ESP_OK || size != sizeof(lease) || memcmp(lease.ssid, ssid, sizeof(lease.ssid)) != 0) {
+      return;
+    }
+
+    // Keep a margin so the lease cannot expire while the link comes up.
+    int64_t now = time(nullptr);
+    if (now < MIN_SYNCED_TIME) {
+      ESP_LOGI(TAG, "System time not set, not reusing the cached DHCP lease");
+      return;
+    }
+    if (now < lease.obtained_at || now + 10 >= lease.obtained_at + lease.lease_time) {
+      ESP_LOGI(TAG, "Cached DHCP lease expired");
+      return;
+    }
+
+    auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif == NULL) {
+      return;
+    }
+    esp_netif_ip_info_t ip_info;
+    ip_info.ip.addr = lease.ip;
+    ip_info.netmask.addr = lease.netmask;
+    ip_info.gw.addr = lease.gw;
+    esp_netif_dns_info_t dns_info = {};
+    dns_info.ip.u_addr.ip4.addr = lease.dns;
+    dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+    esp_netif_dhcpc_stop(netif);
+    if (esp_netif_set_ip_info(netif, &ip_info) != ESP_OK) {
+      esp_netif_dhcpc_start(netif);
+      return;
+    }
+    if (lease.dns != 0) {
+      esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns_info);
+    }
+    lease_applied = true;
+
+    // Renew like a DHCP client would, once half of the lease has passed.
+    int64_t renew_at = lease.obtained_at + lease.lease_time / 2;
+    uint64_t renew_in_us = renew_at > now ? static_cast<uint64_t>(renew_at - now) * 1000000 : 0;
+    if (renew_timer == nullptr) {
+      esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+          auto self = static_cast<Connector*>(arg);
+          auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+          if (netif != NULL && self->lease_applied) {
+            ESP_LOGI(TAG, "Renewing the cached DHCP lease");
+            self->lease_applied = false;
+            self->stopLeaseProbe();
+            esp_netif_dhcpc_start(netif);
+          }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lease_renew",
+        .skip_unhandled_events = true,
+      };
+      ESP_ERROR_CHECK(esp_timer_create(&timer_args, &renew_timer));
+    }
+    esp_timer_stop(renew_timer);
+    esp_timer_start_once(renew_timer, renew_in_us);
+    ESP_LOGI(TAG, "Reusing cached DHCP lease " IPSTR, IP2STR(&ip_info.ip));
+  }
+
+  void Connector::probeLease(uint32_t ip) {
+    auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif == NULL) {
+      return;
+    }
+
+    if (probe_timer == nullptr) {
+      esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+          auto self = static_cast<Connector*>(arg);
+          if (!self->lease_applied) {
+            return;
+          }
+#if !LEASE_PROBE_ACD
+          // An answer leaves an ARP entry for the address with the hardware address of its holder.
+          tcpip_api_call([](struct tcpip_api_call_data* call) -> err_t {
+            auto probe = reinterpret_cast<LeaseProbe*>(call);
+            struct eth_addr* eth = nullptr;
+            const ip4_addr_t* found = nullptr;
+            probe->conflict = etharp_find_addr(probe->netif, &probe->ip, &eth, &found) >= 0
+              && memcmp(eth->addr, probe->netif->hwaddr, sizeof(eth->addr)) != 0;
+            return ERR_OK;
+          }, &lease_probe.call);
+#endif
+          if (!lease_probe.conflict) {
+            return;
+          }
+          ESP_LOGW(TAG, "Cached DHCP lease address in use, falling back to DHCP");
+          nvs_handle_t handle;
+          if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+            nvs_erase_key(handle, NVS_KEY_LEASE);
+            nvs_commit(handle);
+            nvs_close(handle);
+          }
+          self->revertLease();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lease_probe",
+        .skip_unhandled_events = true,
+      };
+      ESP_ERROR_CHECK(esp_timer_create(&timer_args, &probe_timer));
+    }
+    esp_timer_stop(probe_timer);
+
+    lease_probe.netif = static_cast<struct netif*>(esp_netif_get_netif_impl(netif));
+    lease_probe.ip.addr = ip;
+    lease_probe.conflict = false;
+#if LEASE_PROBE_ACD
+    // Probes from 0.0.0.0 and keeps defending the address; a conflict is handled in the timer task.
+    lease_probe.timer = probe_timer;
+    tcpip_api_call([](struct tcpip_api_call_data* call) -> err_t {
+      auto probe = reinterpret_cast<LeaseProbe*>(call);
+      acd_add(probe->netif, &probe->acd, [](struct netif*, acd_callback_enum_t state) {
+        if (state != ACD_IP_OK) {
+          lease_probe.conflict = true;
+          esp_timer_start_once(lease_probe.timer, 0);
+        }
+      });
+      return acd_start(probe->netif, &probe->acd, probe->ip);
+    }, &lease_probe.call);
+#else
+    // Without conflict detection, ask who has the address from the address itself; only another
+    // host holding it answers. This is best-effort: the request also announces the address.
+    tcpip_api_call([](struct tcpip_api_call_data* call) -> err_t {
+      auto probe = reinterpret_cast<LeaseProbe*>(call);
+      return etharp_request(probe->netif, &probe->ip);
+    }, &lease_probe.call);
+    esp_timer_start_once(probe_timer, LEASE_PROBE_WAIT_MS * 1000ull);
+#endif
+  }
+
+  void Connector::stopLeaseProbe() {
+#if LEASE_PROBE_ACD
+    if (lease_probe.netif == nullptr) {
+      return;
+    }
+    tcpip_api_call([](struct tcpip_api_call_data* call) -> err_t {
+      auto probe = reinterpret_cast<LeaseProbe*>(call);
+      acd_stop(&probe->acd);
+      acd_remove(probe->netif, &probe->acd);
+      probe->netif = nullptr;
+      return ERR_OK;
+    }, &lease_probe.call);
+#endif
+  }
+
+  void Connector::saveLease(const esp_netif_ip_info_t& ip_info) {
+    LeaseInfo lease;
+    memset(&lease, 0, sizeof(lease));
+    memcpy(lease.ssid, lease_ssid, sizeof(lease.ssid));
+    lease.ip = ip_info.ip.addr;
+    lease.netmask = ip_info.netmask.addr;
+    lease.gw = ip_info.gw.addr;
+    lease.obtained_at = time(nullptr);
+    if (lease.obtained_at < MIN_SYNCED_TIME) {
+      ESP_LOGI(TAG, "System time not set, not caching the DHCP lease");
+      return;
+    }
+
+    esp_netif_dns_info_t dns_info;
+    auto netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif != NULL && esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns_info) == ESP_OK) {
+      lease.dns = dns_info.ip.u_addr.ip4.addr;
+    }
+    // The DHCP client keeps the lease time of the last ACK until the next exchange.
+    auto lwip_netif = netif != NULL ? static_cast<struct netif*>(esp_netif_get_netif_impl(netif)) : nullptr;
+    auto dhcp = lwip_netif != nullptr ? netif_dhcp_data(lwip_netif) : nullptr;
+    lease.lease_time = dhcp != nullptr && dhcp->offered_t0_lease != 0 ? dhcp->offered_t0_lease : lease_time_s;
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to open NVS to cache the DHCP lease");
+      return;
+    }
+    if (nvs_set_blob(handle, NVS_KEY_LEASE, &lease, sizeof(lease)) == ESP_OK) {
+      nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+
   void Connector::wifiEventHandler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     auto self = static_cast<Connector*>(arg);
 
     if (event_id == WIFI_EVENT_STA_CONNECTED) {
       // Set the WiFi connected bit only when the IP is obtained.
-      // xEventGroupSetBits(self->event_group, WIFI_CONNECTED_BIT);
+      self->stats.onAssociated();
+      self->armGotIPTimeout();
     } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
+      wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+      self->stats.onDisconnected(event->reason);
       xEventGroupSetBits(self->event_group, WIFI_FAIL_BIT);
+      xSemaphoreTake(self->reconnect_mutex, portMAX_DELAY);
+      if (self->got_ip_timer) {
+        esp_timer_stop(self->got_ip_timer);
+      }
+      bool connecting = self->connecting;
+      // A disconnect forced by the IP address timeout takes the next backoff step, whatever its reason code.
+      uint16_t reason = self->got_ip_timed_out ? 0 : event->reason;
+      self->got_ip_timed_out = false;
+      xSemaphoreGive(self->reconnect_mutex);
+      if (connecting) {
+        return;
+      }
+      self->stats.endAttempt(false);
+      self->scheduleReconnect(reason);
     }
   }
 
@@ -183,7 +1090,28 @@ namespace wifi_connect {
       esp_ip4addr_ntoa(&event->ip_info.ip, ip_str, sizeof(ip_str));
       self->ip = ip_str;
       ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
+      if (self->lease_reuse && !self->lease_applied) {
+        // A lease from a real DHCP exchange, either the first one or a renewal.
+        self->saveLease(event->ip_info);
+      } else if (self->lease_applied) {
+        self->probeLease(event->ip_info.ip.addr);
+      }
+      self->stats.onGotIP();
       xEventGroupSetBits(self->event_group, WIFI_CONNECTED_BIT);
+      xSemaphoreTake(self->reconnect_mutex, portMAX_DELAY);
+      if (self->got_ip_timer) {
+        esp_timer_stop(self->got_ip_timer);
+      }
+      uint32_t attempts = self->connecting ? 0 : self->reconnect_attempts;
+      if (attempts > 0) {
+        self->reconnect_attempts = 0;
+      }
+      xSemaphoreGive(self->reconnect_mutex);
+      if (attempts > 0) {
+        ESP_LOGI(TAG, "Reconnected after %lu attempts", static_cast<unsigned long>(attempts));
+        self->stats.endAttempt(true);
+      }
+      self->setLinkState(LinkState::Up);
     }
   }
 } // namespace wifi_connect
\ No newline at end of file